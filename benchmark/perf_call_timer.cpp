@@ -0,0 +1,141 @@
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <Client/CallTimer.h>
+
+using namespace tzrpc_client;
+
+//
+// 客户端请求超时的开销
+// 每个请求添加一个超时，请求在超时之前完成并取消超时，比较每个请求单独
+// 创建steady_timer和共享CallTimer两种方式，按照指定的速率发起请求
+//
+
+extern char * program_invocation_short_name;
+static void usage() {
+    std::stringstream ss;
+
+    ss << program_invocation_short_name << " [calls_per_sec] [seconds] " << std::endl;
+    ss << std::endl;
+
+    std::cerr << ss.str();
+}
+
+static int64_t thread_cpu_us(clockid_t clock_id) {
+    struct timespec ts {};
+    ::clock_gettime(clock_id, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 按照速率发起请求，每个请求设置20ms超时，1ms之后完成
+// 统计调用线程花在添加和取消超时上的时间，以及io_service线程的CPU时间
+template<typename Add, typename Cancel>
+static void paced_run(const std::string& name, int calls_per_sec, int seconds, clockid_t io_clock,
+                      const Add& add, const Cancel& cancel) {
+
+    typedef decltype(add()) handle_t;
+    std::vector<std::pair<std::chrono::steady_clock::time_point, handle_t>> inflight;
+
+    int64_t total = static_cast<int64_t>(calls_per_sec) * seconds;
+    auto interval = std::chrono::nanoseconds(1000000000LL / calls_per_sec);
+
+    int64_t io_cpu_start = thread_cpu_us(io_clock);
+    std::chrono::nanoseconds caller_cost(0);
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    size_t done = 0;
+
+    for (int64_t i = 0; i < total; ++i) {
+
+        while (std::chrono::steady_clock::now() < next)
+            ;
+        next += interval;
+
+        auto now = std::chrono::steady_clock::now();
+        inflight.emplace_back(now + std::chrono::milliseconds(1), add());
+
+        while (done < inflight.size() && inflight[done].first <= now) {
+            cancel(inflight[done].second);
+            ++done;
+        }
+
+        caller_cost += std::chrono::steady_clock::now() - now;
+    }
+
+    for (; done < inflight.size(); ++done) {
+        cancel(inflight[done].second);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    int64_t io_cpu = thread_cpu_us(io_clock) - io_cpu_start;
+    int64_t caller_us = std::chrono::duration_cast<std::chrono::microseconds>(caller_cost).count();
+
+    fprintf(stderr, "%-14s calls %ld, caller %.0f ns/call, io thread %.0f ns/call, total %.2f%% of one core\n",
+            name.c_str(), static_cast<long>(total),
+            caller_us * 1000.0 / total, io_cpu * 1000.0 / total,
+            (caller_us + io_cpu) * 100.0 / elapsed.count());
+}
+
+int main(int argc, char* argv[]) {
+
+    int calls_per_sec = 100000;
+    int seconds = 3;
+    if (argc >= 2 && (calls_per_sec = ::atoi(argv[1])) <= 0) {
+        usage();
+        return 0;
+    }
+    if (argc >= 3 && (seconds = ::atoi(argv[2])) <= 0) {
+        usage();
+        return 0;
+    }
+
+    boost::asio::io_service io_service;
+    std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(io_service));
+    std::thread io_thread([&io_service]() { io_service.run(); });
+
+    clockid_t io_clock;
+    ::pthread_getcpuclockid(io_thread.native_handle(), &io_clock);
+
+    // 每个请求一个steady_timer
+    paced_run("steady_timer", calls_per_sec, seconds, io_clock,
+              [&io_service]() {
+                  std::shared_ptr<boost::asio::steady_timer> timer
+                      = std::make_shared<boost::asio::steady_timer>(io_service);
+                  timer->expires_from_now(std::chrono::milliseconds(20));
+                  timer->async_wait([timer](const boost::system::error_code&) {});
+                  return timer;
+              },
+              [](std::shared_ptr<boost::asio::steady_timer>& timer) {
+                  boost::system::error_code ignore_ec;
+                  timer->cancel(ignore_ec);
+              });
+
+    // 共享的CallTimer
+    std::shared_ptr<CallTimer> call_timer = std::make_shared<CallTimer>(io_service);
+    paced_run("call_timer", calls_per_sec, seconds, io_clock,
+              [&call_timer]() {
+                  return call_timer->add(std::chrono::milliseconds(20), []() {});
+              },
+              [&call_timer](CallTimer::handle_t& handle) {
+                  call_timer->cancel(handle);
+              });
+
+    call_timer->shutdown();
+    work.reset();
+    io_service.stop();
+    io_thread.join();
+
+    std::cerr << "done" << std::endl;
+    return 0;
+}
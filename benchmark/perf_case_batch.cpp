@@ -0,0 +1,182 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+
+
+#include <Client/include/RpcClient.h>
+
+#include <Client/Common.h>
+#include <message/ProtoBuf.h>
+#include <Client/XtraTask.pb.h>
+
+using namespace tzrpc_client;
+
+
+//
+// 大量小请求的吞吐：逐个同步调用、call_RPC_batch批量调用、自动批量发送的异步调用
+//
+
+extern char * program_invocation_short_name;
+static void usage() {
+    std::stringstream ss;
+
+    ss << program_invocation_short_name << " [sync|batch|auto] [batch_size] [seconds] " << std::endl;
+    ss << std::endl;
+
+    std::cerr << ss.str();
+}
+
+static std::string generate_random_str() {
+
+    std::stringstream ss;
+    ss << "message with random [" << ::random() << "] include";
+    return ss.str();
+}
+
+static bool build_request(std::string& echo_str, std::string& mar_str) {
+
+    echo_str = generate_random_str();
+    tzrpc::XtraTask::XtraReadOps::Request request;
+    request.mutable_echo()->set_msg(echo_str);
+
+    if(!roo::ProtoBuf::marshalling_to_string(request, &mar_str)) {
+        std::cerr << "marshalling message failed." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+static bool check_response(const std::string& echo_str, const std::string& resp_str) {
+
+    tzrpc::XtraTask::XtraReadOps::Response response;
+    if(!roo::ProtoBuf::unmarshalling_from_string(resp_str, &response)) {
+        std::cerr << "unmarshalling message failed." << std::endl;
+        return false;
+    }
+
+    if(!response.has_code() || response.code() != 0 ) {
+        std::cerr << "response code check error" << std::endl;
+        return false;
+    }
+
+    if (response.echo().msg() != "echo:" + echo_str) {
+        std::cerr << "content check failed, expect: echo:" << echo_str << ", but recv: " << response.echo().msg() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// 完成一轮batch_size个请求，返回false表示出错
+static bool run_round(RpcClient& client, const std::string& mode, int batch_size) {
+
+    std::vector<std::string> echo_strs(batch_size);
+    std::vector<RpcBatchRequest> requests;
+    for (int i = 0; i < batch_size; ++i) {
+        std::string mar_str;
+        if (!build_request(echo_strs[i], mar_str)) {
+            return false;
+        }
+        requests.emplace_back(tzrpc::ServiceID::XTRA_TASK_SERVICE, tzrpc::XtraTask::OpCode::CMD_READ, mar_str);
+    }
+
+    std::vector<RpcCallResult> results;
+
+    if (mode == "sync") {
+        for (size_t i = 0; i < requests.size(); ++i) {
+            std::string resp_str;
+            RpcClientStatus status = client.call_RPC(requests[i].service_id_, requests[i].opcode_,
+                                                     requests[i].payload_, resp_str);
+            results.emplace_back(status, resp_str);
+        }
+    } else if (mode == "batch") {
+        if (client.call_RPC_batch(requests, results) != RpcClientStatus::OK) {
+            std::cerr << "call_RPC_batch failed." << std::endl;
+            return false;
+        }
+    } else {
+        std::vector<std::future<RpcCallResult>> futures;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            futures.push_back(client.call_RPC_future(requests[i].service_id_, requests[i].opcode_,
+                                                     requests[i].payload_));
+        }
+        for (size_t i = 0; i < futures.size(); ++i) {
+            results.push_back(futures[i].get());
+        }
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].status_ != RpcClientStatus::OK) {
+            std::cerr << "call failed, return code [" << static_cast<int>(results[i].status_) << "]" << std::endl;
+            return false;
+        }
+        if (!check_response(echo_strs[i], results[i].respload_)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc < 2) {
+        usage();
+        return 0;
+    }
+
+    std::string mode = argv[1];
+    if (mode != "sync" && mode != "batch" && mode != "auto") {
+        usage();
+        return 0;
+    }
+
+    int batch_size = 100;
+    int seconds = 10;
+    if (argc >= 3 && (batch_size = ::atoi(argv[2])) <= 0) {
+        usage();
+        return 0;
+    }
+    if (argc >= 4 && (seconds = ::atoi(argv[3])) <= 0) {
+        usage();
+        return 0;
+    }
+
+    struct RpcClientSetting setting {};
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = 8434;
+
+    // 自动批量发送：一轮请求在一个窗口之内发起，积累到batch_size个立即发送
+    if (mode == "auto") {
+        setting.batch_window_us_ = 200;
+        setting.batch_max_calls_ = batch_size;
+    }
+
+    RpcClient client(setting);
+
+    uint64_t count = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto stop  = start + std::chrono::seconds(seconds);
+
+    while (std::chrono::steady_clock::now() < stop) {
+        if (!run_round(client, mode, batch_size)) {
+            break;
+        }
+        count += batch_size;
+    }
+
+    double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start).count() / 1000.0;
+    fprintf(stderr, "mode %s, batch_size %d, total count %ld, time: %.1f, perf: %.0f tps\n",
+            mode.c_str(), batch_size, static_cast<long>(count), elapsed, count / elapsed);
+
+    std::cerr << "done" << std::endl;
+
+    return 0;
+}
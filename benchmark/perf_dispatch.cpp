@@ -0,0 +1,108 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <RPC/Service.h>
+#include <RPC/ServiceTable.h>
+
+using namespace tzrpc;
+
+//
+// Dispatcher路由开销: std::map + shared_ptr拷贝 vs ServiceTable
+//
+
+class DummyService : public Service {
+public:
+    explicit DummyService(uint64_t& counter) :
+        counter_(counter) {
+    }
+
+    void handle_RPC(std::shared_ptr<RpcInstance> rpc_instance)override {
+        ++ counter_;
+    }
+
+    std::string instance_name()override { return "DummyService"; }
+    bool init()override { return true; }
+    ExecutorConf get_executor_conf()override { return ExecutorConf(); }
+    int module_runtime(const libconfig::Config& conf)override { return 0; }
+    int module_status(std::string& module, std::string& name, std::string& val)override { return 0; }
+
+private:
+    uint64_t& counter_;
+};
+
+extern char * program_invocation_short_name;
+static void usage() {
+    std::stringstream ss;
+
+    ss << program_invocation_short_name << " [loop_count] " << std::endl;
+    ss << std::endl;
+
+    std::cerr << ss.str();
+}
+
+static void perf_case(size_t service_count, uint64_t loop_count) {
+
+    uint64_t counter = 0;
+    std::map<uint16_t, std::shared_ptr<Service>> services;
+    for (size_t i = 1; i <= service_count; ++i) {
+        services[static_cast<uint16_t>(i)] = std::make_shared<DummyService>(counter);
+    }
+    ServiceTable table(services);
+
+    // 预先生成请求的service_id序列，避免随机数开销计入测试结果
+    std::vector<uint16_t> ids(4096);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ids[i] = static_cast<uint16_t>(::random() % service_count + 1);
+    }
+
+    std::shared_ptr<RpcInstance> dummy_instance;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < loop_count; ++i) {
+        std::shared_ptr<Service> service;
+        auto it = services.find(ids[i & 4095]);
+        if (it != services.end())
+            service = it->second;
+        if (service)
+            service->handle_RPC(dummy_instance);
+    }
+    auto map_cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < loop_count; ++i) {
+        Service* service = table.find(ids[i & 4095]);
+        if (service)
+            service->handle_RPC(dummy_instance);
+    }
+    auto table_cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "services %2lu: map+shared_ptr %.2f ns/op, service_table %.2f ns/op (%lu calls)\n",
+            service_count,
+            static_cast<double>(map_cost) / loop_count,
+            static_cast<double>(table_cost) / loop_count,
+            counter);
+}
+
+int main(int argc, char* argv[]) {
+
+    uint64_t loop_count = 0;
+    if (argc < 2 || (loop_count = ::atoll(argv[1])) <= 0) {
+        usage();
+        return 0;
+    }
+
+    perf_case(1,  loop_count);
+    perf_case(64, loop_count);
+
+    std::cerr << "done" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <container/EQueue.h>
+
+#include <RPC/ExecutorPool.h>
+#include <RPC/WorkStealingPool.h>
+#include <RPC/FairSharePool.h>
+
+using namespace tzrpc;
+
+//
+// 负载倾斜的多服务场景: 每个服务独立线程池 vs 共享工作窃取线程池 vs 共享公平调度线程池
+// 第一个服务承担大部分的请求，其余服务的请求很少
+//
+
+static const size_t kServiceCount = 8;
+static const size_t kThreadPerService = 2;
+
+// 模拟请求处理的计算开销
+static void handle_request(uint64_t n) {
+    volatile uint64_t sum = 0;
+    for (uint64_t i = 0; i < 2000; ++i)
+        sum += i ^ n;
+}
+
+struct PerfService : public Schedulable {
+
+    PerfService(std::shared_ptr<ExecutorPool> pool, int cap, std::atomic<uint64_t>& done) :
+        pool_(pool), cap_(cap), done_(done) {
+    }
+
+    void submit(uint64_t n) {
+        queue_.PUSH(n);
+        if (pool_ && slots_.acquire(cap_))
+            pool_->schedule(this);
+    }
+
+    // 和Executor::run_scheduled的逻辑一致
+    void run_scheduled(int64_t budget_us)override {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; budget_us > 0 || i < 16; ++i) {
+            uint64_t n = 0;
+            if (!queue_.POP(n, 0))
+                break;
+            handle_request(n);
+            ++done_;
+            if (budget_us > 0 &&
+                std::chrono::steady_clock::now() - start >= std::chrono::microseconds(budget_us))
+                break;
+        }
+
+        if (queue_.SIZE() > 0) {
+            pool_->schedule(this);
+            return;
+        }
+
+        slots_.release();
+        if (queue_.SIZE() > 0 && slots_.acquire(cap_))
+            pool_->schedule(this);
+    }
+
+    std::string instance_name()override {
+        return "PerfService";
+    }
+
+    // 独立线程池模式下的工作线程
+    void thread_run(const std::atomic<bool>& stop) {
+        while (!stop) {
+            uint64_t n = 0;
+            if (!queue_.POP(n, 100))
+                continue;
+            handle_request(n);
+            ++done_;
+        }
+    }
+
+    std::shared_ptr<ExecutorPool> pool_;
+    int cap_;
+    std::atomic<uint64_t>& done_;
+    roo::EQueue<uint64_t> queue_;
+    ScheduleSlots slots_;
+};
+
+extern char * program_invocation_short_name;
+static void usage() {
+    std::stringstream ss;
+
+    ss << program_invocation_short_name << " [request_count] " << std::endl;
+    ss << std::endl;
+
+    std::cerr << ss.str();
+}
+
+static void dispatch(std::vector<std::unique_ptr<PerfService>>& services, uint64_t request_count) {
+    for (uint64_t i = 0; i < request_count; ++i) {
+        // 80%的请求落到第一个服务
+        size_t index = (::random() % 10 < 8) ? 0 : (::random() % (kServiceCount - 1) + 1);
+        services[index]->submit(i);
+    }
+}
+
+static void wait_done(const std::atomic<uint64_t>& done, uint64_t request_count) {
+    while (done.load() < request_count)
+        ::usleep(100);
+}
+
+static double perf_dedicated(uint64_t request_count) {
+
+    std::atomic<uint64_t> done(0);
+    std::atomic<bool> stop(false);
+
+    std::vector<std::unique_ptr<PerfService>> services;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kServiceCount; ++i) {
+        services.emplace_back(new PerfService(nullptr, 0, done));
+        for (size_t j = 0; j < kThreadPerService; ++j)
+            threads.emplace_back(&PerfService::thread_run, services[i].get(), std::cref(stop));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    dispatch(services, request_count);
+    wait_done(done, request_count);
+    auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+
+    return static_cast<double>(cost);
+}
+
+static double perf_shared(std::shared_ptr<ExecutorPool> pool, uint64_t request_count) {
+
+    std::atomic<uint64_t> done(0);
+
+    // 线程总数和独立线程池模式相同，单个服务最多占用一半的线程
+    pool->init(kServiceCount * kThreadPerService);
+    pool->pool_start();
+
+    std::vector<std::unique_ptr<PerfService>> services;
+    for (size_t i = 0; i < kServiceCount; ++i)
+        services.emplace_back(new PerfService(pool, kServiceCount * kThreadPerService / 2, done));
+
+    auto start = std::chrono::steady_clock::now();
+    dispatch(services, request_count);
+    wait_done(done, request_count);
+    auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    pool->pool_stop_graceful();
+    pool->pool_join();
+
+    return static_cast<double>(cost);
+}
+
+int main(int argc, char* argv[]) {
+
+    uint64_t request_count = 0;
+    if (argc < 2 || (request_count = ::atoll(argv[1])) <= 0) {
+        usage();
+        return 0;
+    }
+
+    fprintf(stderr, "dedicated pools (%lu x %lu threads): %.0f ms\n",
+            kServiceCount, kThreadPerService, perf_dedicated(request_count));
+    fprintf(stderr, "shared work stealing pool (%lu threads): %.0f ms\n",
+            kServiceCount * kThreadPerService,
+            perf_shared(std::make_shared<WorkStealingPool>("perf"), request_count));
+    fprintf(stderr, "shared fair pool (%lu threads): %.0f ms\n",
+            kServiceCount * kThreadPerService,
+            perf_shared(std::make_shared<FairSharePool>("perf", 2000), request_count));
+
+    std::cerr << "done" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+#include <RPC/RpcQueue.h>
+#include <RPC/MPMCQueue.h>
+
+using namespace tzrpc;
+
+//
+// Executor请求队列的竞争测试: 8个io线程PUSH，8个执行线程POP
+// 队列元素使用shared_ptr，和实际的RpcInstance传递方式一致
+//
+
+static const size_t kProducerCount = 8;
+static const size_t kConsumerCount = 8;
+
+typedef std::shared_ptr<uint64_t> item_t;
+
+extern char * program_invocation_short_name;
+static void usage() {
+    std::stringstream ss;
+
+    ss << program_invocation_short_name << " [count_per_producer] " << std::endl;
+    ss << std::endl;
+
+    std::cerr << ss.str();
+}
+
+static void perf_case(RpcQueue<item_t>& queue, uint64_t count_per_producer) {
+
+    const uint64_t total = count_per_producer * kProducerCount;
+    std::atomic<uint64_t> consumed(0);
+    std::atomic<uint64_t> full_count(0);
+
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < kConsumerCount; ++i) {
+        threads.emplace_back([&]() {
+            item_t item;
+            while (consumed.load(std::memory_order_relaxed) < total) {
+                if (queue.POP(item, 10))
+                    ++consumed;
+            }
+        });
+    }
+
+    for (size_t i = 0; i < kProducerCount; ++i) {
+        threads.emplace_back([&]() {
+            item_t item = std::make_shared<uint64_t>(0);
+            for (uint64_t j = 0; j < count_per_producer; ++j) {
+                while (!queue.PUSH(item)) {
+                    ++full_count;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "%-5s queue: %lu items, %.2f ns/item, %.2f Mops/s, push full %lu\n",
+            queue.queue_type().c_str(), total,
+            static_cast<double>(cost) / total,
+            static_cast<double>(total) * 1000 / cost,
+            full_count.load());
+}
+
+int main(int argc, char* argv[]) {
+
+    uint64_t count_per_producer = 0;
+    if (argc < 2 || (count_per_producer = ::atoll(argv[1])) <= 0) {
+        usage();
+        return 0;
+    }
+
+    {
+        MutexRpcQueue<item_t> queue;
+        perf_case(queue, count_per_producer);
+    }
+
+    {
+        MPMCQueue<item_t> queue(4096);
+        perf_case(queue, count_per_producer);
+    }
+
+    std::cerr << "done" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <vector>
+
+#include <Client/CallTimer.h>
+
+namespace tzrpc_client {
+
+CallTimer::CallTimer(boost::asio::io_service& io_service) :
+    lock_(),
+    timer_(io_service),
+    armed_(std::chrono::steady_clock::time_point::max()),
+    deadlines_(),
+    next_id_(0) {
+}
+
+CallTimer::handle_t CallTimer::add(std::chrono::microseconds timeout, const timeout_handler_t& handler) {
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    handle_t handle(deadline, ++next_id_);
+    deadlines_[handle] = handler;
+
+    if (deadline < armed_) {
+        arm(deadline);
+    }
+
+    return handle;
+}
+
+bool CallTimer::cancel(const handle_t& handle) {
+
+    // 底层定时器不需要调整，提前醒来的时候没有到期的超时就重新等待
+    std::lock_guard<std::mutex> lock(lock_);
+    return deadlines_.erase(handle) != 0;
+}
+
+void CallTimer::shutdown() {
+
+    std::lock_guard<std::mutex> lock(lock_);
+    deadlines_.clear();
+
+    boost::system::error_code ignore_ec;
+    timer_.cancel(ignore_ec);
+    armed_ = std::chrono::steady_clock::time_point::max();
+}
+
+void CallTimer::arm(std::chrono::steady_clock::time_point deadline) {
+
+    // 重新设置到期时间会取消之前的等待，之前的handler以operation_aborted返回
+    armed_ = deadline;
+    timer_.expires_at(deadline);
+    timer_.async_wait(std::bind(&CallTimer::timeout_handler, shared_from_this(), std::placeholders::_1));
+}
+
+void CallTimer::timeout_handler(const boost::system::error_code& ec) {
+
+    if (ec == boost::asio::error::operation_aborted) {
+        return;
+    }
+
+    std::vector<timeout_handler_t> expired;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        auto now = std::chrono::steady_clock::now();
+        auto iter = deadlines_.begin();
+        while (iter != deadlines_.end() && iter->first.first <= now) {
+            expired.push_back(std::move(iter->second));
+            iter = deadlines_.erase(iter);
+        }
+
+        armed_ = std::chrono::steady_clock::time_point::max();
+        if (!deadlines_.empty()) {
+            arm(deadlines_.begin()->first.first);
+        }
+    }
+
+    // 在锁外面调用，handler中可以再添加或者取消超时
+    for (auto iter = expired.begin(); iter != expired.end(); ++iter) {
+        (*iter)();
+    }
+}
+
+} // end namespace tzrpc_client
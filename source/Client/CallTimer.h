@@ -0,0 +1,72 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __CLIENT_CALL_TIMER_H__
+#define __CLIENT_CALL_TIMER_H__
+
+#include <xtra_rhel.h>
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace tzrpc_client {
+
+// 客户端所有调用共享的超时定时器
+// 到期时间按照顺序保存在有序表中，底层只使用一个steady_timer等待最早的
+// 到期时间，添加和取消超时只需要操作有序表，不需要每个请求都创建定时器
+// 并且向io_service提交等待操作。同样超时时间的请求按照发起的顺序到期，
+// 新添加的超时一般不会早于已有的，所以很少需要重新设置底层的定时器
+class CallTimer : public std::enable_shared_from_this<CallTimer> {
+
+    __noncopyable__(CallTimer)
+
+public:
+    typedef std::function<void()> timeout_handler_t;
+    typedef std::pair<std::chrono::steady_clock::time_point, uint64_t> handle_t;
+
+    explicit CallTimer(boost::asio::io_service& io_service);
+    ~CallTimer() = default;
+
+    // 到期的时候在io_service的线程中调用handler
+    handle_t add(std::chrono::microseconds timeout, const timeout_handler_t& handler);
+
+    // 返回true表示取消成功，handler不会被调用；返回false表示已经到期，
+    // handler已经或者正在被调用
+    bool cancel(const handle_t& handle);
+
+    // 丢弃所有还没有到期的超时，handler不会被调用
+    void shutdown();
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(lock_);
+        return deadlines_.size();
+    }
+
+private:
+    // 调用者持有lock_
+    void arm(std::chrono::steady_clock::time_point deadline);
+    void timeout_handler(const boost::system::error_code& ec);
+
+    std::mutex lock_;
+    boost::asio::steady_timer timer_;
+
+    // 底层定时器当前等待的到期时间，没有等待的时候为time_point::max()
+    std::chrono::steady_clock::time_point armed_;
+
+    std::map<handle_t, timeout_handler_t> deadlines_;
+    uint64_t next_id_;
+};
+
+} // end namespace tzrpc_client
+
+#endif // __CLIENT_CALL_TIMER_H__
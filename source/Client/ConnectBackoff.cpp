@@ -0,0 +1,71 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <ctime>
+
+#include <Client/ConnectBackoff.h>
+
+namespace tzrpc_client {
+
+ConnectBackoff::ConnectBackoff(uint32_t initial_ms, uint32_t max_ms) :
+    initial_ms_(initial_ms),
+    max_ms_(max_ms < initial_ms ? initial_ms : max_ms),
+    lock_(),
+    failures_(0),
+    retry_at_(),
+    random_(static_cast<uint32_t>(::time(NULL)) ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this))) {
+}
+
+bool ConnectBackoff::is_down() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return failures_ > 0 && std::chrono::steady_clock::now() < retry_at_;
+}
+
+std::chrono::milliseconds ConnectBackoff::retry_after() {
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (failures_ == 0) {
+        return std::chrono::milliseconds(0);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= retry_at_) {
+        return std::chrono::milliseconds(0);
+    }
+
+    // 向上取整，到期之前不会提前重试
+    auto remain = std::chrono::duration_cast<std::chrono::microseconds>(retry_at_ - now);
+    return std::chrono::milliseconds((remain.count() + 999) / 1000);
+}
+
+std::chrono::milliseconds ConnectBackoff::failed() {
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    ++failures_;
+
+    uint64_t interval = initial_ms_;
+    for (uint32_t i = 1; i < failures_ && interval < max_ms_; ++i) {
+        interval *= 2;
+    }
+    if (interval > max_ms_) {
+        interval = max_ms_;
+    }
+
+    uint64_t half = interval / 2;
+    uint64_t delay = interval - half + (half > 0 ? random_() % (half + 1) : 0);
+
+    retry_at_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+    return std::chrono::milliseconds(delay);
+}
+
+void ConnectBackoff::succeeded() {
+    std::lock_guard<std::mutex> lock(lock_);
+    failures_ = 0;
+}
+
+} // end namespace tzrpc_client
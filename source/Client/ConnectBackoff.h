@@ -0,0 +1,57 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __CLIENT_CONNECT_BACKOFF_H__
+#define __CLIENT_CONNECT_BACKOFF_H__
+
+#include <xtra_rhel.h>
+
+#include <chrono>
+#include <mutex>
+#include <random>
+
+namespace tzrpc_client {
+
+// 一个服务端实例建立连接的退避状态
+// 连续失败的时候重连间隔从initial_ms开始翻倍，最大为max_ms，实际等待时间在
+// [间隔/2, 间隔]之间随机，避免大量客户端在同一时刻重连。等待期间认为实例
+// 不可用，调用直接失败，不再每次都尝试建立连接
+class ConnectBackoff {
+
+    __noncopyable__(ConnectBackoff)
+
+public:
+    ConnectBackoff(uint32_t initial_ms, uint32_t max_ms);
+    ~ConnectBackoff() = default;
+
+    bool is_down();
+
+    // 还需要等待多久才可以重试，不在退避期间返回0
+    std::chrono::milliseconds retry_after();
+
+    // 记录一次连接失败，返回这次退避的时间
+    std::chrono::milliseconds failed();
+    void succeeded();
+
+    uint32_t failures() {
+        std::lock_guard<std::mutex> lock(lock_);
+        return failures_;
+    }
+
+private:
+    const uint32_t initial_ms_;
+    const uint32_t max_ms_;
+
+    std::mutex lock_;
+    uint32_t failures_;         // 连续失败的次数
+    std::chrono::steady_clock::time_point retry_at_;
+    std::minstd_rand random_;
+};
+
+} // end namespace tzrpc_client
+
+#endif // __CLIENT_CONNECT_BACKOFF_H__
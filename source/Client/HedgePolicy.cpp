@@ -0,0 +1,125 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <algorithm>
+
+#include <Client/HedgePolicy.h>
+
+namespace tzrpc_client {
+
+// 每个opcode保留的最近延迟样本数
+static const size_t kWindowSize = 512;
+
+// 样本达到这个数目之后才开始发送副本
+static const uint64_t kMinSamples = 32;
+
+static const uint64_t kRecomputeInterval = 32;
+
+// 令牌最多积累10个副本，避免长时间平稳之后集中发送大量副本
+static const int64_t kMaxBudgetTokens = 10 * 100;
+
+HedgePolicy::HedgePolicy(uint32_t percentile, uint32_t budget_percent, uint32_t min_delay_us,
+                         const std::vector<std::pair<uint16_t, uint16_t>>& opcodes) :
+    percentile_(std::min<uint32_t>(percentile, 100)),
+    budget_percent_(budget_percent),
+    min_delay_us_(min_delay_us),
+    windows_(),
+    budget_tokens_(0),
+    request_count_(0),
+    hedge_count_(0),
+    hedge_win_count_(0),
+    budget_denied_count_(0) {
+
+    for (auto iter = opcodes.begin(); iter != opcodes.end(); ++iter) {
+        std::unique_ptr<LatencyWindow> window(new LatencyWindow());
+        window->samples_.reserve(kWindowSize);
+        window->next_ = 0;
+        window->count_ = 0;
+        window->delay_us_ = 0;
+        windows_[key(iter->first, iter->second)] = std::move(window);
+    }
+}
+
+std::chrono::microseconds HedgePolicy::hedge_delay(uint16_t service_id, uint16_t opcode) {
+
+    auto iter = windows_.find(key(service_id, opcode));
+    if (iter == windows_.end()) {
+        return std::chrono::microseconds(0);
+    }
+
+    return std::chrono::microseconds(iter->second->delay_us_.load());
+}
+
+void HedgePolicy::record_latency(uint16_t service_id, uint16_t opcode, std::chrono::microseconds latency) {
+
+    auto iter = windows_.find(key(service_id, opcode));
+    if (iter == windows_.end()) {
+        return;
+    }
+
+    LatencyWindow& window = *iter->second;
+    std::lock_guard<std::mutex> lock(window.lock_);
+
+    if (window.samples_.size() < kWindowSize) {
+        window.samples_.push_back(latency.count());
+    } else {
+        window.samples_[window.next_] = latency.count();
+        window.next_ = (window.next_ + 1) % kWindowSize;
+    }
+
+    ++window.count_;
+    if (window.count_ < kMinSamples || window.count_ % kRecomputeInterval != 0) {
+        return;
+    }
+
+    std::vector<int64_t> sorted(window.samples_);
+    size_t index = sorted.size() * percentile_ / 100;
+    if (index >= sorted.size()) {
+        index = sorted.size() - 1;
+    }
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+
+    window.delay_us_ = std::max(sorted[index], min_delay_us_);
+}
+
+void HedgePolicy::record_request() {
+
+    ++request_count_;
+
+    int64_t tokens = budget_tokens_.load();
+    int64_t next = 0;
+    do {
+        next = std::min(tokens + static_cast<int64_t>(budget_percent_), kMaxBudgetTokens);
+    } while (!budget_tokens_.compare_exchange_weak(tokens, next));
+}
+
+bool HedgePolicy::try_acquire_budget() {
+
+    int64_t tokens = budget_tokens_.load();
+    do {
+        if (tokens < 100) {
+            ++budget_denied_count_;
+            return false;
+        }
+    } while (!budget_tokens_.compare_exchange_weak(tokens, tokens - 100));
+
+    ++hedge_count_;
+    return true;
+}
+
+void HedgePolicy::refund_budget() {
+
+    int64_t tokens = budget_tokens_.load();
+    int64_t next = 0;
+    do {
+        next = std::min(tokens + 100, kMaxBudgetTokens);
+    } while (!budget_tokens_.compare_exchange_weak(tokens, next));
+
+    --hedge_count_;
+}
+
+} // end namespace tzrpc_client
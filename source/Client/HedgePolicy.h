@@ -0,0 +1,96 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __CLIENT_HEDGE_POLICY_H__
+#define __CLIENT_HEDGE_POLICY_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace tzrpc_client {
+
+// 对冲请求的策略
+// 幂等的请求在超过最近延迟的分位数之后还没有答复，就向另一个实例发送一个副本，
+// 使用先到达的答复。每个opcode保存最近的延迟样本计算分位数，样本不足的时候
+// 不发送副本。副本的数目受预算限制：每个请求积累budget_percent%个令牌，发送
+// 一个副本消耗一个，所以副本不超过请求总数的budget_percent%
+class HedgePolicy {
+
+    __noncopyable__(HedgePolicy)
+
+public:
+    HedgePolicy(uint32_t percentile, uint32_t budget_percent, uint32_t min_delay_us,
+                const std::vector<std::pair<uint16_t, uint16_t>>& opcodes);
+    ~HedgePolicy() = default;
+
+    bool is_hedged(uint16_t service_id, uint16_t opcode) const {
+        return windows_.find(key(service_id, opcode)) != windows_.end();
+    }
+
+    // 返回0表示样本不足，这个请求不发送副本
+    std::chrono::microseconds hedge_delay(uint16_t service_id, uint16_t opcode);
+
+    // 请求的耗时，包括超时和被副本取消的请求，这些请求的真实延迟至少是这么长
+    void record_latency(uint16_t service_id, uint16_t opcode, std::chrono::microseconds latency);
+
+    // 每个请求调用一次积累预算，发送副本之前调用try_acquire_budget
+    void record_request();
+    bool try_acquire_budget();
+
+    // 取得预算之后副本没有发送出去，归还消耗的令牌
+    void refund_budget();
+
+    void record_hedge_win() {
+        ++hedge_win_count_;
+    }
+
+    uint64_t request_count() const { return request_count_; }
+    uint64_t hedge_count() const { return hedge_count_; }
+    uint64_t hedge_win_count() const { return hedge_win_count_; }
+    uint64_t budget_denied_count() const { return budget_denied_count_; }
+
+private:
+
+    // 最近的延迟样本，每记录kRecomputeInterval个样本重新计算一次分位数
+    struct LatencyWindow {
+        std::mutex lock_;
+        std::vector<int64_t> samples_;
+        size_t next_;
+        uint64_t count_;
+        std::atomic<int64_t> delay_us_;     // 0表示样本不足
+    };
+
+    static uint32_t key(uint16_t service_id, uint16_t opcode) {
+        return (static_cast<uint32_t>(service_id) << 16) | opcode;
+    }
+
+    const uint32_t percentile_;
+    const uint32_t budget_percent_;
+    const int64_t  min_delay_us_;
+
+    // 构造之后不再增删，查找不需要加锁
+    std::map<uint32_t, std::unique_ptr<LatencyWindow>> windows_;
+
+    // 以1/100个副本为单位的令牌
+    std::atomic<int64_t> budget_tokens_;
+
+    std::atomic<uint64_t> request_count_;
+    std::atomic<uint64_t> hedge_count_;
+    std::atomic<uint64_t> hedge_win_count_;
+    std::atomic<uint64_t> budget_denied_count_;
+};
+
+} // end namespace tzrpc_client
+
+#endif // __CLIENT_HEDGE_POLICY_H__
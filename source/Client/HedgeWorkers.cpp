@@ -0,0 +1,108 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <other/Log.h>
+
+#include <Client/HedgeWorkers.h>
+
+namespace tzrpc_client {
+
+HedgeWorkers::HedgeWorkers(uint32_t thread_num) :
+    thread_num_(thread_num),
+    lock_(),
+    notify_(),
+    tasks_(),
+    stop_(false),
+    threads_() {
+}
+
+HedgeWorkers::~HedgeWorkers() {
+    shutdown();
+}
+
+bool HedgeWorkers::init() {
+
+    if (thread_num_ == 0) {
+        roo::log_err("hedge workers need at least one thread.");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < thread_num_; ++i) {
+        threads_.emplace_back(std::bind(&HedgeWorkers::run, this));
+    }
+
+    return true;
+}
+
+bool HedgeWorkers::submit(const std::function<void()>& task, const std::function<void()>& discard) {
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (stop_) {
+            return false;
+        }
+
+        tasks_.push_back(Task { task, discard });
+    }
+
+    notify_.notify_one();
+    return true;
+}
+
+void HedgeWorkers::shutdown() {
+
+    std::deque<Task> discarded;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (stop_) {
+            return;
+        }
+
+        stop_ = true;
+        discarded.swap(tasks_);
+    }
+
+    // 丢弃的任务在锁外通知，回调可能需要获取所有者的锁
+    for (auto iter = discarded.begin(); iter != discarded.end(); ++iter) {
+        if (iter->discard_) {
+            iter->discard_();
+        }
+    }
+
+    notify_.notify_all();
+    for (auto iter = threads_.begin(); iter != threads_.end(); ++iter) {
+        iter->join();
+    }
+    threads_.clear();
+}
+
+void HedgeWorkers::run() {
+
+    while (true) {
+
+        Task task;
+
+        {
+            std::unique_lock<std::mutex> lock(lock_);
+            while (!stop_ && tasks_.empty()) {
+                notify_.wait(lock);
+            }
+
+            if (stop_) {
+                return;
+            }
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task.run_();
+    }
+}
+
+} // end namespace tzrpc_client
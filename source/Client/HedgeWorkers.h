@@ -0,0 +1,63 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __CLIENT_HEDGE_WORKERS_H__
+#define __CLIENT_HEDGE_WORKERS_H__
+
+#include <xtra_rhel.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tzrpc_client {
+
+// 执行对冲副本的固定线程
+// 副本是阻塞的同步调用，不能占用io_service线程，预算已经限制了副本的数目，
+// 这里再限制同时进行的副本数，线程都忙的时候副本排队等待。
+// 所有者析构的时候调用shutdown，丢弃还没有开始的副本并等待进行中的副本结束，
+// 所以任务可以直接使用所有者的this指针。进行中的副本可能没有超时，所有者需要
+// 在shutdown之前中止它们的连接
+class HedgeWorkers {
+
+    __noncopyable__(HedgeWorkers)
+
+public:
+    explicit HedgeWorkers(uint32_t thread_num);
+    ~HedgeWorkers();
+
+    bool init();
+
+    // 已经shutdown的时候返回false，任务不会执行
+    // 排队的任务被shutdown丢弃的时候在shutdown的线程中调用discard
+    bool submit(const std::function<void()>& task, const std::function<void()>& discard);
+    void shutdown();
+
+private:
+    void run();
+
+    const uint32_t thread_num_;
+
+    std::mutex lock_;
+    std::condition_variable notify_;
+    struct Task {
+        std::function<void()> run_;
+        std::function<void()> discard_;
+    };
+
+    std::deque<Task> tasks_;
+    bool stop_;
+
+    std::vector<std::thread> threads_;
+};
+
+} // end namespace tzrpc_client
+
+#endif // __CLIENT_HEDGE_WORKERS_H__
@@ -0,0 +1,175 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+
+#include <Client/LoadBalancer.h>
+
+namespace tzrpc_client {
+
+// 新样本的权重，大约最近十次调用决定了平均值
+static const int64_t kEwmaWeightPercent = 20;
+
+// 失败的调用按照至少1秒的延迟计入
+static const int64_t kFailPenaltyUs = 1000 * 1000;
+
+void Endpoint::call_finish(int64_t latency_us, bool success) {
+
+    --inflight_;
+
+    if (!success) {
+        ++fail_count_;
+        if (latency_us < kFailPenaltyUs)
+            latency_us = kFailPenaltyUs;
+    }
+
+    if (latency_us <= 0)
+        latency_us = 1;
+
+    int64_t ewma = ewma_us_.load();
+    int64_t next = 0;
+    do {
+        next = ewma == 0 ? latency_us : ewma + (latency_us - ewma) * kEwmaWeightPercent / 100;
+        if (next <= 0)
+            next = 1;
+    } while (!ewma_us_.compare_exchange_weak(ewma, next));
+}
+
+bool Endpoint::parse(const std::string& str, std::string& addr, uint16_t& port) {
+
+    std::string::size_type pos = str.rfind(':');
+    if (pos == std::string::npos || pos == 0 || pos + 1 == str.size()) {
+        return false;
+    }
+
+    char* end = NULL;
+    long value = ::strtol(str.c_str() + pos + 1, &end, 10);
+    if (*end != '\0' || value <= 0 || value > std::numeric_limits<uint16_t>::max()) {
+        return false;
+    }
+
+    addr = str.substr(0, pos);
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+
+class RoundRobinBalancer : public LoadBalancer {
+public:
+    RoundRobinBalancer() :
+        next_(0) {
+    }
+
+    std::shared_ptr<Endpoint> pick(const EndpointList& endpoints)override {
+        if (endpoints.empty())
+            return std::shared_ptr<Endpoint>();
+
+        return endpoints[next_++ % endpoints.size()];
+    }
+
+    std::string policy() const override {
+        return "round_robin";
+    }
+
+private:
+    std::atomic<size_t> next_;
+};
+
+
+class LeastOutstandingBalancer : public LoadBalancer {
+public:
+    LeastOutstandingBalancer() :
+        next_(0) {
+    }
+
+    // 从轮转的位置开始查找，并发数相同的时候请求不会都落到第一个实例上
+    std::shared_ptr<Endpoint> pick(const EndpointList& endpoints)override {
+        if (endpoints.empty())
+            return std::shared_ptr<Endpoint>();
+
+        size_t start = next_++;
+        size_t best = start % endpoints.size();
+        int64_t best_inflight = endpoints[best]->inflight_.load();
+
+        for (size_t i = 1; i < endpoints.size() && best_inflight > 0; ++i) {
+            size_t index = (start + i) % endpoints.size();
+            int64_t inflight = endpoints[index]->inflight_.load();
+            if (inflight < best_inflight) {
+                best = index;
+                best_inflight = inflight;
+            }
+        }
+
+        return endpoints[best];
+    }
+
+    std::string policy() const override {
+        return "least_outstanding";
+    }
+
+private:
+    std::atomic<size_t> next_;
+};
+
+
+class P2CBalancer : public LoadBalancer {
+public:
+
+    std::shared_ptr<Endpoint> pick(const EndpointList& endpoints)override {
+        if (endpoints.empty())
+            return std::shared_ptr<Endpoint>();
+
+        if (endpoints.size() == 1)
+            return endpoints[0];
+
+        size_t first = fast_random() % endpoints.size();
+        size_t second = fast_random() % (endpoints.size() - 1);
+        if (second >= first)
+            ++second;
+
+        return cost(*endpoints[first]) <= cost(*endpoints[second]) ? endpoints[first] : endpoints[second];
+    }
+
+    std::string policy() const override {
+        return "p2c";
+    }
+
+private:
+
+    // 还没有延迟样本的实例代价最低，这样新加入的实例可以尽快得到探测
+    static int64_t cost(const Endpoint& endpoint) {
+        return (endpoint.inflight_.load() + 1) * endpoint.ewma_us_.load();
+    }
+
+    static size_t fast_random() {
+        static thread_local uint64_t seed = reinterpret_cast<uint64_t>(&seed) ^ static_cast<uint64_t>(::time(NULL));
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return static_cast<size_t>(seed);
+    }
+};
+
+
+std::unique_ptr<LoadBalancer> LoadBalancer::create(const std::string& policy) {
+
+    std::unique_ptr<LoadBalancer> balancer;
+
+    if (policy == "round_robin") {
+        balancer.reset(new RoundRobinBalancer());
+    } else if (policy == "least_outstanding") {
+        balancer.reset(new LeastOutstandingBalancer());
+    } else if (policy == "p2c") {
+        balancer.reset(new P2CBalancer());
+    }
+
+    return balancer;
+}
+
+} // end namespace tzrpc_client
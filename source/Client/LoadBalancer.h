@@ -0,0 +1,99 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __CLIENT_LOAD_BALANCER_H__
+#define __CLIENT_LOAD_BALANCER_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Client/ConnectBackoff.h>
+
+namespace tzrpc_client {
+
+class TcpConnSyncPool;
+
+// 客户端可以访问的一个服务端实例
+// inflight_和ewma_us_由调用路径实时更新，负载均衡策略据此选择实例
+struct Endpoint {
+
+    Endpoint(const std::string& addr, uint16_t port) :
+        addr_(addr),
+        port_(port),
+        inflight_(0),
+        ewma_us_(0),
+        pick_count_(0),
+        fail_count_(0),
+        backoff_(),
+        pool_() {
+    }
+
+    std::string key() const {
+        return addr_ + ":" + std::to_string(static_cast<unsigned int>(port_));
+    }
+
+    void call_start() {
+        ++inflight_;
+        ++pick_count_;
+    }
+
+    // 建立连接失败之后的退避期间不可用
+    bool is_down() const {
+        return backoff_ && backoff_->is_down();
+    }
+
+    // 失败的调用按照惩罚延迟计入，让出错的实例暂时少分配请求
+    void call_finish(int64_t latency_us, bool success);
+
+    // 解析"ip:port"格式的地址
+    static bool parse(const std::string& str, std::string& addr, uint16_t& port);
+
+    const std::string addr_;
+    const uint16_t    port_;
+
+    std::atomic<int64_t>  inflight_;     // 正在等待答复的请求数
+    std::atomic<int64_t>  ewma_us_;      // 延迟的指数加权平均，0表示还没有样本
+    std::atomic<uint64_t> pick_count_;
+    std::atomic<uint64_t> fail_count_;
+
+    // 同步连接池和异步连接共享的建立连接的退避状态
+    std::shared_ptr<ConnectBackoff> backoff_;
+
+    // 这个实例的同步连接池，实例从列表中移除的时候关闭
+    std::shared_ptr<TcpConnSyncPool> pool_;
+};
+
+typedef std::vector<std::shared_ptr<Endpoint>> EndpointList;
+
+
+// 负载均衡策略
+// round_robin:       依次轮转
+// least_outstanding: 选择正在等待答复的请求最少的实例
+// p2c:               随机选择两个实例，比较(inflight + 1) * ewma_us的代价，选择代价小的
+class LoadBalancer {
+
+    __noncopyable__(LoadBalancer)
+
+public:
+    LoadBalancer() = default;
+    virtual ~LoadBalancer() = default;
+
+    // 不支持的策略返回空
+    static std::unique_ptr<LoadBalancer> create(const std::string& policy);
+
+    // endpoints为空的时候返回空
+    virtual std::shared_ptr<Endpoint> pick(const EndpointList& endpoints) = 0;
+    virtual std::string policy() const = 0;
+};
+
+} // end namespace tzrpc_client
+
+#endif // __CLIENT_LOAD_BALANCER_H__
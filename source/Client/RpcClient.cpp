@@ -8,6 +8,7 @@
 #include <other/Log.h>
 
 #include <Client/RpcClientImpl.h>
+#include <Client/LoadBalancer.h>
 #include <Client/include/RpcClient.h>
 
 #include <system/ConstructException.h>
@@ -105,15 +106,41 @@ bool RpcClient::init(const std::string& cfgFile) {
 
 bool RpcClient::init(const libconfig::Setting& setting) {
 
-    if (!setting.lookupValue("serv_addr", client_setting_.serv_addr_) ||
-        !setting.lookupValue("serv_port", client_setting_.serv_port_) ||
-        client_setting_.serv_addr_.empty() ||
-        client_setting_.serv_port_ <= 0) {
+    client_setting_.endpoints_.clear();
+    if (setting.exists("endpoints")) {
+        const libconfig::Setting& endpoints = setting["endpoints"];
+        for (int i = 0; i < endpoints.getLength(); ++i) {
+            std::string endpoint = endpoints[i];
+            std::string addr;
+            uint16_t port = 0;
+            if (!Endpoint::parse(endpoint, addr, port)) {
+                roo::log_err("invalid endpoint: %s", endpoint.c_str());
+                return false;
+            }
+            client_setting_.endpoints_.push_back(endpoint);
+
+            // 没有单独配置serv_addr的时候，使用第一个实例
+            if (i == 0) {
+                client_setting_.serv_addr_ = addr;
+                client_setting_.serv_port_ = port;
+            }
+        }
+    }
+
+    setting.lookupValue("serv_addr", client_setting_.serv_addr_);
+    setting.lookupValue("serv_port", client_setting_.serv_port_);
+    if (client_setting_.serv_addr_.empty() || client_setting_.serv_port_ <= 0) {
         roo::log_err("invalid serv_addr and serv_port: %s, %d.", 
                       client_setting_.serv_addr_.c_str(), client_setting_.serv_port_);
         return false;
     }
 
+    setting.lookupValue("balance_policy", client_setting_.balance_policy_);
+    if (!LoadBalancer::create(client_setting_.balance_policy_)) {
+        roo::log_err("invalid balance_policy: %s", client_setting_.balance_policy_.c_str());
+        return false;
+    }
+
     if (setting.lookupValue("send_max_msg_size", client_setting_.send_max_msg_size_) &&
         client_setting_.send_max_msg_size_ < 0) {
         roo::log_err("invalid send_max_msg_size: %d", client_setting_.send_max_msg_size_);
@@ -132,24 +159,111 @@ bool RpcClient::init(const libconfig::Setting& setting) {
         return false;
     }
 
+    if (setting.lookupValue("priority", client_setting_.priority_) &&
+        client_setting_.priority_ > 3) {
+        roo::log_err("invalid priority: %u", client_setting_.priority_);
+        return false;
+    }
+
+    setting.lookupValue("pool_min_conns", client_setting_.pool_min_conns_);
+    setting.lookupValue("pool_max_conns", client_setting_.pool_max_conns_);
+    setting.lookupValue("pool_wait_ms", client_setting_.pool_wait_ms_);
+    if (client_setting_.pool_max_conns_ == 0 ||
+        client_setting_.pool_min_conns_ > client_setting_.pool_max_conns_) {
+        roo::log_err("invalid pool_min_conns %u and pool_max_conns %u.",
+                     client_setting_.pool_min_conns_, client_setting_.pool_max_conns_);
+        return false;
+    }
+
+    setting.lookupValue("connect_timeout_ms", client_setting_.connect_timeout_ms_);
+    setting.lookupValue("reconnect_initial_ms", client_setting_.reconnect_initial_ms_);
+    setting.lookupValue("reconnect_max_ms", client_setting_.reconnect_max_ms_);
+    setting.lookupValue("reconnect_queue_size", client_setting_.reconnect_queue_size_);
+    if (client_setting_.reconnect_initial_ms_ == 0 ||
+        client_setting_.reconnect_max_ms_ < client_setting_.reconnect_initial_ms_) {
+        roo::log_err("invalid reconnect_initial_ms %u and reconnect_max_ms %u.",
+                     client_setting_.reconnect_initial_ms_, client_setting_.reconnect_max_ms_);
+        return false;
+    }
+
+    setting.lookupValue("batch_window_us", client_setting_.batch_window_us_);
+    setting.lookupValue("batch_max_calls", client_setting_.batch_max_calls_);
+    if (client_setting_.batch_window_us_ > 0 && client_setting_.batch_max_calls_ == 0) {
+        roo::log_err("invalid batch_max_calls %u with batch_window_us %u.",
+                     client_setting_.batch_max_calls_, client_setting_.batch_window_us_);
+        return false;
+    }
+
+    setting.lookupValue("hedge_percentile", client_setting_.hedge_percentile_);
+    setting.lookupValue("hedge_min_delay_us", client_setting_.hedge_min_delay_us_);
+    setting.lookupValue("hedge_budget_percent", client_setting_.hedge_budget_percent_);
+    setting.lookupValue("hedge_threads", client_setting_.hedge_threads_);
+    if (client_setting_.hedge_percentile_ > 100 || client_setting_.hedge_budget_percent_ > 100) {
+        roo::log_err("invalid hedge_percentile %u or hedge_budget_percent %u.",
+                     client_setting_.hedge_percentile_, client_setting_.hedge_budget_percent_);
+        return false;
+    }
+
+    if (client_setting_.hedge_percentile_ > 0 && client_setting_.hedge_threads_ == 0) {
+        roo::log_err("invalid hedge_threads %u.", client_setting_.hedge_threads_);
+        return false;
+    }
+
+    client_setting_.hedge_opcodes_.clear();
+    if (setting.exists("hedge_opcodes")) {
+        const libconfig::Setting& opcodes = setting["hedge_opcodes"];
+        for (int i = 0; i < opcodes.getLength(); ++i) {
+            int service_id = 0;
+            int opcode = 0;
+            if (!opcodes[i].lookupValue("service_id", service_id) || !opcodes[i].lookupValue("opcode", opcode) ||
+                service_id < 0 || service_id > 0xFFFF || opcode < 0 || opcode > 0xFFFF) {
+                roo::log_err("invalid hedge_opcodes item at %d.", i);
+                return false;
+            }
+            client_setting_.hedge_opcodes_.emplace_back(static_cast<uint16_t>(service_id),
+                                                        static_cast<uint16_t>(opcode));
+        }
+    }
+
     return init(client_setting_.serv_addr_,  client_setting_.serv_port_);
 }
 
 
+bool RpcClient::update_endpoints(const std::vector<std::string>& endpoints) {
+    if (!initialized_ || !impl_) {
+        roo::log_err("RpcClientImpl not initialized, please check.");
+        return false;
+    }
+
+    return impl_->update_endpoints(endpoints);
+}
+
 RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
                                     const std::string& payload, std::string& respload,
                                     uint32_t timeout_sec) {
+    return call_RPC(service_id, opcode, payload, respload, std::chrono::seconds(timeout_sec));
+}
+
+RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
+                                    const std::string& payload, std::string& respload,
+                                    std::chrono::microseconds timeout) {
     if (!initialized_ || !impl_) {
         roo::log_err("RpcClientImpl not initialized, please check.");
         return RpcClientStatus::NETWORK_BEFORE_ERROR;
     }
 
-    return impl_->call_RPC(service_id, opcode, payload, respload, timeout_sec);
+    return impl_->call_RPC(service_id, opcode, payload, respload, timeout);
 }
 
 RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
                                     const std::string& payload,
                                     uint32_t timeout_sec) {
+    return call_RPC(service_id, opcode, payload, std::chrono::seconds(timeout_sec));
+}
+
+RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
+                                    const std::string& payload,
+                                    std::chrono::microseconds timeout) {
     if (!initialized_ || !impl_) {
         roo::log_err("RpcClientImpl not initialized, please check.");
         return RpcClientStatus::NETWORK_BEFORE_ERROR;
@@ -160,7 +274,74 @@ RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
         return RpcClientStatus::NETWORK_BEFORE_ERROR;
     }
 
-    return impl_->call_RPC(service_id, opcode, payload, timeout_sec);
+    return impl_->call_RPC(service_id, opcode, payload, timeout);
+}
+
+RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
+                                    const std::string& payload,
+                                    const rpc_callback_t& callback,
+                                    uint32_t timeout_sec) {
+    return call_RPC(service_id, opcode, payload, callback, std::chrono::seconds(timeout_sec));
+}
+
+RpcClientStatus RpcClient::call_RPC(uint16_t service_id, uint16_t opcode,
+                                    const std::string& payload,
+                                    const rpc_callback_t& callback,
+                                    std::chrono::microseconds timeout) {
+    if (!initialized_ || !impl_) {
+        roo::log_err("RpcClientImpl not initialized, please check.");
+        return RpcClientStatus::NETWORK_BEFORE_ERROR;
+    }
+
+    if (!callback) {
+        roo::log_err("using async interface, but mandatory rpc_callback_t not provide.");
+        return RpcClientStatus::NETWORK_BEFORE_ERROR;
+    }
+
+    return impl_->call_RPC(service_id, opcode, payload, callback, timeout);
+}
+
+RpcClientStatus RpcClient::call_RPC_batch(const std::vector<RpcBatchRequest>& requests,
+                                          std::vector<RpcCallResult>& results,
+                                          uint32_t timeout_sec) {
+    return call_RPC_batch(requests, results, std::chrono::seconds(timeout_sec));
+}
+
+RpcClientStatus RpcClient::call_RPC_batch(const std::vector<RpcBatchRequest>& requests,
+                                          std::vector<RpcCallResult>& results,
+                                          std::chrono::microseconds timeout) {
+    if (!initialized_ || !impl_) {
+        roo::log_err("RpcClientImpl not initialized, please check.");
+        results.assign(requests.size(), RpcCallResult(RpcClientStatus::NETWORK_BEFORE_ERROR, ""));
+        return RpcClientStatus::NETWORK_BEFORE_ERROR;
+    }
+
+    return impl_->call_RPC_batch(requests, results, timeout);
+}
+
+std::future<RpcCallResult> RpcClient::call_RPC_future(uint16_t service_id, uint16_t opcode,
+                                                      const std::string& payload,
+                                                      uint32_t timeout_sec) {
+    return call_RPC_future(service_id, opcode, payload, std::chrono::seconds(timeout_sec));
+}
+
+std::future<RpcCallResult> RpcClient::call_RPC_future(uint16_t service_id, uint16_t opcode,
+                                                      const std::string& payload,
+                                                      std::chrono::microseconds timeout) {
+
+    auto promise = std::make_shared<std::promise<RpcCallResult>>();
+    std::future<RpcCallResult> future = promise->get_future();
+
+    RpcClientStatus status = call_RPC(service_id, opcode, payload,
+                                      [promise](const RpcClientStatus status, const std::string& rsp) {
+                                          promise->set_value(RpcCallResult(status, rsp));
+                                      },
+                                      timeout);
+    if (status != RpcClientStatus::OK) {
+        promise->set_value(RpcCallResult(status, ""));
+    }
+
+    return future;
 }
 
 } // end namespace tzrpc_client
@@ -7,6 +7,8 @@
 
 #include <xtra_rhel.h>
 
+#include <condition_variable>
+
 #include <Core/Message.h>
 
 #include <RPC/RpcRequestMessage.h>
@@ -15,6 +17,7 @@
 
 #include <Client/RpcClientImpl.h>
 #include <Client/TcpConnSync.h>
+#include <Client/TcpConnSyncPool.h>
 #include <Client/TcpConnAsync.h>
 
 using tzrpc::Message;
@@ -27,6 +30,20 @@ using tzrpc::kRpcHeaderMagic;
 
 namespace tzrpc_client {
 
+// 请求头中的超时时间精度为毫秒，不足1毫秒的按照1毫秒传递，0表示没有超时
+static uint32_t header_timeout_ms(std::chrono::microseconds timeout) {
+
+    if (timeout.count() <= 0) {
+        return 0;
+    }
+
+    int64_t msec = (timeout.count() + 999) / 1000;
+    if (msec > std::numeric_limits<uint32_t>::max()) {
+        msec = std::numeric_limits<uint32_t>::max();
+    }
+
+    return static_cast<uint32_t>(msec);
+}
 
 bool RpcClientImpl::init() {
 
@@ -34,17 +51,175 @@ bool RpcClientImpl::init() {
 
     if(client_setting_.io_service_) {
         roo::log_info("RpcClientImpl using provided boost::asio::io_service instance.");
+    } else {
+        roo::log_info("Create new IoService instance.");
+        roo_io_service_ = make_unique<roo::IoService>();
+        if (!roo_io_service_ || !roo_io_service_->init()) {
+            roo::log_err("Create and initialized IoService failed.");
+            return false;
+        }
+
+        client_setting_.io_service_ = roo_io_service_->io_service_ptr();
+    }
+
+    call_timer_ = std::make_shared<CallTimer>(*client_setting_.io_service_);
+
+    balancer_ = LoadBalancer::create(client_setting_.balance_policy_);
+    if (!balancer_) {
+        roo::log_err("Create LoadBalancer with policy %s failed.", client_setting_.balance_policy_.c_str());
+        return false;
+    }
+
+    if (client_setting_.hedge_percentile_ > 0 && !client_setting_.hedge_opcodes_.empty()) {
+        hedge_.reset(new HedgePolicy(client_setting_.hedge_percentile_,
+                                     client_setting_.hedge_budget_percent_,
+                                     client_setting_.hedge_min_delay_us_,
+                                     client_setting_.hedge_opcodes_));
+        hedge_workers_.reset(new HedgeWorkers(client_setting_.hedge_threads_));
+        if (!hedge_workers_->init()) {
+            roo::log_err("Create hedge workers with %u threads failed.", client_setting_.hedge_threads_);
+            return false;
+        }
+        roo::log_info("hedge %lu opcodes after p%u latency, budget %u%%.",
+                      client_setting_.hedge_opcodes_.size(), client_setting_.hedge_percentile_,
+                      client_setting_.hedge_budget_percent_);
+    }
+
+    if (client_setting_.endpoints_.empty()) {
+        std::shared_ptr<Endpoint> endpoint = create_endpoint(client_setting_.serv_addr_, client_setting_.serv_port_);
+        if (!endpoint) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(endpoints_lock_);
+        endpoints_ = std::make_shared<const EndpointList>(1, endpoint);
         return true;
     }
 
-    roo::log_info("Create new IoService instance.");
-    roo_io_service_ = make_unique<roo::IoService>();
-    if (!roo_io_service_ || !roo_io_service_->init()) {
-        roo::log_err("Create and initialized IoService failed.");
+    return update_endpoints(client_setting_.endpoints_);
+}
+
+std::shared_ptr<Endpoint> RpcClientImpl::create_endpoint(const std::string& addr, uint16_t port) {
+
+    std::shared_ptr<Endpoint> endpoint = std::make_shared<Endpoint>(addr, port);
+
+    // 每个实例的连接池使用自己的地址
+    RpcClientSetting setting = client_setting_;
+    setting.serv_addr_ = addr;
+    setting.serv_port_ = port;
+
+    endpoint->backoff_ = std::make_shared<ConnectBackoff>(client_setting_.reconnect_initial_ms_,
+                                                          client_setting_.reconnect_max_ms_);
+    endpoint->pool_ = std::make_shared<TcpConnSyncPool>(setting, call_timer_, endpoint->backoff_);
+    if (!endpoint->pool_ || !endpoint->pool_->init()) {
+        roo::log_err("Create and initialized TcpConnSyncPool for %s failed.", endpoint->key().c_str());
+        return std::shared_ptr<Endpoint>();
+    }
+
+    return endpoint;
+}
+
+std::shared_ptr<Endpoint> RpcClientImpl::pick_endpoint() {
+
+    std::shared_ptr<const EndpointList> endpoints;
+    {
+        std::lock_guard<std::mutex> lock(endpoints_lock_);
+        endpoints = endpoints_;
+    }
+
+    if (!endpoints) {
+        return std::shared_ptr<Endpoint>();
+    }
+
+    std::shared_ptr<Endpoint> endpoint = balancer_->pick(*endpoints);
+    if (!endpoint || !endpoint->is_down()) {
+        return endpoint;
+    }
+
+    // 选中的实例在退避期间，在其他可用的实例中重新选择，全部不可用的时候
+    // 返回原来的选择，由调用者直接失败
+    EndpointList healthy;
+    for (auto iter = endpoints->begin(); iter != endpoints->end(); ++iter) {
+        if (!(*iter)->is_down()) {
+            healthy.push_back(*iter);
+        }
+    }
+
+    if (!healthy.empty()) {
+        endpoint = balancer_->pick(healthy);
+    }
+
+    return endpoint;
+}
+
+bool RpcClientImpl::update_endpoints(const std::vector<std::string>& endpoint_strs) {
+
+    if (endpoint_strs.empty()) {
+        roo::log_err("endpoint list can not be empty.");
         return false;
     }
 
-    client_setting_.io_service_ = roo_io_service_->io_service_ptr();
+    std::shared_ptr<const EndpointList> old_endpoints;
+    {
+        std::lock_guard<std::mutex> lock(endpoints_lock_);
+        old_endpoints = endpoints_;
+    }
+
+    std::map<std::string, std::shared_ptr<Endpoint>> old_index;
+    if (old_endpoints) {
+        for (auto iter = old_endpoints->begin(); iter != old_endpoints->end(); ++iter) {
+            old_index[(*iter)->key()] = *iter;
+        }
+    }
+
+    std::shared_ptr<EndpointList> new_endpoints = std::make_shared<EndpointList>();
+    for (auto iter = endpoint_strs.begin(); iter != endpoint_strs.end(); ++iter) {
+
+        std::string addr;
+        uint16_t port = 0;
+        if (!Endpoint::parse(*iter, addr, port)) {
+            roo::log_err("invalid endpoint: %s", iter->c_str());
+            return false;
+        }
+
+        std::string key = addr + ":" + std::to_string(static_cast<unsigned int>(port));
+        auto old = old_index.find(key);
+        if (old != old_index.end()) {
+            // 保留的实例继续使用原来的连接池和统计
+            new_endpoints->push_back(old->second);
+            old_index.erase(old);
+            continue;
+        }
+
+        std::shared_ptr<Endpoint> endpoint = create_endpoint(addr, port);
+        if (!endpoint) {
+            return false;
+        }
+        new_endpoints->push_back(endpoint);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(endpoints_lock_);
+        endpoints_ = new_endpoints;
+    }
+
+    // 剩下的是被移除的实例，正在使用的连接归还的时候关闭
+    std::vector<std::shared_ptr<PendingCall>> broken_calls;
+    for (auto iter = old_index.begin(); iter != old_index.end(); ++iter) {
+
+        roo::log_warning("endpoint %s removed.", iter->first.c_str());
+        iter->second->pool_->shutdown();
+
+        std::lock_guard<std::mutex> lock(call_mutex_);
+        if (async_stat_ == AsyncConnStat::kConnected && async_endpoint_ == iter->second) {
+            close_conn_async(broken_calls);
+        }
+    }
+
+    fail_pending_calls(broken_calls, RpcClientStatus::NETWORK_RECV_ERROR);
+
+    roo::log_warning("update endpoints to %d instances with policy %s.",
+                     static_cast<int>(new_endpoints->size()), balancer_->policy().c_str());
     return true;
 }
 
@@ -55,106 +230,344 @@ RpcClientImpl::~RpcClientImpl() {
     // 和关闭操作，否则因为shared_from_this()导致客户端析钩之后
     // 对应的socket还没有释放，从而体现的状况就是在客户端和服务端
     // 之间建立了大量的socket连接
-    if (conn_sync_) {
-        conn_sync_->shutdown_and_close_socket();
+    std::shared_ptr<const EndpointList> endpoints;
+    {
+        std::lock_guard<std::mutex> lock(endpoints_lock_);
+        endpoints = endpoints_;
     }
 
-    if (conn_async_) {
-        conn_async_->shutdown_and_close_socket();
+    if (endpoints) {
+        for (auto iter = endpoints->begin(); iter != endpoints->end(); ++iter) {
+            (*iter)->pool_->shutdown();
+        }
+    }
+
+    // 进行中的副本使用this，在其他成员释放之前结束。副本可能没有设置超时，
+    // 先关闭它们借出的连接，否则会一直等待服务端的答复
+    if (hedge_workers_) {
+        std::vector<std::shared_ptr<HedgedCall>> inflight;
+        {
+            std::lock_guard<std::mutex> lock(hedge_lock_);
+            inflight.assign(hedge_inflight_.begin(), hedge_inflight_.end());
+        }
+
+        for (auto iter = inflight.begin(); iter != inflight.end(); ++iter) {
+            std::lock_guard<std::mutex> lock((*iter)->lock_);
+            (*iter)->aborted_ = true;
+            if ((*iter)->hedge_conn_) {
+                (*iter)->hedge_conn_->abort();
+            }
+        }
+
+        hedge_workers_->shutdown();
+    }
+
+    // 回调只持有弱引用，析构的时候还没有完成的请求需要通知调用者
+    std::vector<std::shared_ptr<PendingCall>> broken_calls;
+    {
+        std::lock_guard<std::mutex> lock(call_mutex_);
+
+        if (conn_async_) {
+            conn_async_->shutdown_and_close_socket();
+            conn_async_.reset();
+        }
+
+        if (connect_socket_) {
+            boost::system::error_code ignore_ec;
+            connect_socket_->close(ignore_ec);
+            connect_socket_.reset();
+        }
+
+        reconnect_queue_.clear();
+        take_pending_calls(broken_calls);
+    }
+
+    if (call_timer_) {
+        call_timer_->shutdown();
+    }
+
+    fail_pending_calls(broken_calls, RpcClientStatus::NETWORK_RECV_ERROR);
+
+    std::vector<AsyncCall> batch_calls;
+    {
+        std::lock_guard<std::mutex> lock(batch_lock_);
+        batch_calls.swap(batch_queue_);
+    }
+
+    for (auto iter = batch_calls.begin(); iter != batch_calls.end(); ++iter) {
+        iter->callback_(RpcClientStatus::NETWORK_BEFORE_ERROR, "");
     }
 }
 
-bool RpcClientImpl::send_rpc_message(const RpcRequestMessage& rpc_request_message) {
-    Message net_msg(rpc_request_message.net_str());
-    return conn_sync_->send_net_message(net_msg);
+// 服务端给出了答复，包括业务错误，这时候不需要再等待副本
+static bool is_answered(RpcClientStatus status) {
+    return status < RpcClientStatus::NETWORK_BEFORE_ERROR;
 }
 
-bool RpcClientImpl::recv_rpc_message(Message& net_message) {
-    return conn_sync_->recv_net_message(net_message);
+RpcClientStatus RpcClientImpl::call_RPC(uint16_t service_id, uint16_t opcode,
+                                        const std::string& payload, std::string& respload,
+                                        std::chrono::microseconds timeout) {
+
+    if (hedge_ && hedge_->is_hedged(service_id, opcode)) {
+        return call_RPC_hedged(service_id, opcode, payload, respload, timeout);
+    }
+
+    std::shared_ptr<Endpoint> endpoint = pick_endpoint();
+    if (!endpoint) {
+        roo::log_err("no endpoint available.");
+        return RpcClientStatus::NETWORK_BEFORE_ERROR;
+    }
+
+    return call_RPC_tracked(endpoint, service_id, opcode, payload, respload, timeout, nullptr, false);
 }
 
-void RpcClientImpl::set_rpc_call_timeout(uint32_t sec, bool sync) {
+RpcClientStatus RpcClientImpl::call_RPC_tracked(const std::shared_ptr<Endpoint>& endpoint,
+                                                uint16_t service_id, uint16_t opcode,
+                                                const std::string& payload, std::string& respload,
+                                                std::chrono::microseconds timeout,
+                                                HedgedCall* hedged, bool is_hedge) {
+
+    auto start = std::chrono::steady_clock::now();
+    endpoint->call_start();
+
+    RpcClientStatus status = call_RPC_endpoint(*endpoint, service_id, opcode, payload, respload, timeout,
+                                               hedged, is_hedge);
+
+    // 服务端正常处理的业务错误不影响实例的选择
+    // 被副本取消的主请求按照失败计算，慢的实例在负载均衡中也会被避开
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    bool success = status != RpcClientStatus::OVERLOADED &&
+                   status != RpcClientStatus::DEADLINE_EXCEEDED &&
+                   status < RpcClientStatus::NETWORK_BEFORE_ERROR;
+    endpoint->call_finish(latency.count(), success);
+
+    // 超时、失败以及被副本取消的请求也计入延迟样本，否则慢的请求越多，
+    // 分位数反而越偏向快的请求。没有发送出去的请求不代表服务端的延迟
+    if (hedge_ && status != RpcClientStatus::NETWORK_BEFORE_ERROR &&
+        status != RpcClientStatus::NETWORK_CONNECT_ERROR) {
+        hedge_->record_latency(service_id, opcode, latency);
+    }
+
+    return status;
+}
 
-    if (sec == 0) {
-        return;
+RpcClientStatus RpcClientImpl::call_RPC_hedged(uint16_t service_id, uint16_t opcode,
+                                               const std::string& payload, std::string& respload,
+                                               std::chrono::microseconds timeout) {
+
+    std::shared_ptr<Endpoint> endpoint = pick_endpoint();
+    if (!endpoint) {
+        roo::log_err("no endpoint available.");
+        return RpcClientStatus::NETWORK_BEFORE_ERROR;
     }
 
-    boost::system::error_code ignore_ec;
-    if (rpc_call_timer_) {
-        rpc_call_timer_->cancel(ignore_ec);
-    } else {
-        rpc_call_timer_.reset(new steady_timer(*client_setting_.io_service_));
+    hedge_->record_request();
+
+    // 延迟样本不足，或者超时比对冲延迟还短，副本来不及得到答复
+    std::chrono::microseconds delay = hedge_->hedge_delay(service_id, opcode);
+    if (delay.count() <= 0 || (timeout.count() > 0 && delay >= timeout)) {
+        return call_RPC_tracked(endpoint, service_id, opcode, payload, respload, timeout, nullptr, false);
+    }
+
+    std::shared_ptr<HedgedCall> hedged = std::make_shared<HedgedCall>(payload);
+    std::chrono::microseconds hedge_timeout = timeout.count() > 0 ? timeout - delay : timeout;
+
+    std::weak_ptr<RpcClientImpl> weak_self = shared_from_this();
+    CallTimer::handle_t handle = call_timer_->add(delay, [=]() {
+        std::shared_ptr<RpcClientImpl> self = weak_self.lock();
+        if (self) {
+            self->start_hedge(hedged, endpoint, service_id, opcode, hedge_timeout);
+        }
+    });
+
+    RpcClientStatus status = call_RPC_tracked(endpoint, service_id, opcode, payload, respload, timeout,
+                                              hedged.get(), false);
+    call_timer_->cancel(handle);
+
+    std::unique_lock<std::mutex> lock(hedged->lock_);
+    hedged->primary_done_ = true;
+    hedged->payload_ = nullptr;
+
+    if (!hedged->answered_ && is_answered(status)) {
+        hedged->answered_ = true;
+        return status;
     }
 
-    SAFE_ASSERT(sec > 0);
-    was_timeout_ = false;
-    rpc_call_timer_->expires_from_now(seconds(sec));
-    rpc_call_timer_->async_wait(std::bind(&RpcClientImpl::rpc_call_timeout, shared_from_this(),
-                                          std::placeholders::_1, sync));
+    // 主请求失败的时候，副本还在进行就等待它的结果
+    while (!hedged->answered_ && hedged->hedge_running_) {
+        hedged->hedge_notify_.wait(lock);
+    }
+
+    if (hedged->answered_) {
+        respload = hedged->respload_;
+        return hedged->status_;
+    }
+
+    return status;
 }
 
-void RpcClientImpl::rpc_call_timeout(const boost::system::error_code& ec, bool sync) {
+std::shared_ptr<Endpoint> RpcClientImpl::pick_hedge_endpoint(const Endpoint& primary) {
 
-    if (ec == 0) {
-        roo::log_warning("rpc_call_timeout called, call activity started at %lu.", time_start_);
-        was_timeout_ = true;
-        if (sync) {
-            conn_sync_->shutdown_and_close_socket();
-        } else {
-            conn_async_->shutdown_and_close_socket();
+    std::shared_ptr<const EndpointList> endpoints;
+    {
+        std::lock_guard<std::mutex> lock(endpoints_lock_);
+        endpoints = endpoints_;
+    }
+
+    EndpointList others;
+    if (endpoints) {
+        for (auto iter = endpoints->begin(); iter != endpoints->end(); ++iter) {
+            if (iter->get() != &primary && !(*iter)->is_down()) {
+                others.push_back(*iter);
+            }
         }
-    } else if (ec == boost::asio::error::operation_aborted) {
-        // normal cancel, request handled in-time
-    } else {
-        roo::log_err("Undetected and won't handle error_code: {%d} %s.", ec.value(), ec.message().c_str());
     }
+
+    if (others.empty()) {
+        return std::shared_ptr<Endpoint>();
+    }
+
+    return balancer_->pick(others);
 }
 
-RpcClientStatus RpcClientImpl::call_RPC(uint16_t service_id, uint16_t opcode,
-                                        const std::string& payload, std::string& respload,
-                                        uint32_t timeout_sec) {
+void RpcClientImpl::start_hedge(std::shared_ptr<HedgedCall> hedged, std::shared_ptr<Endpoint> primary,
+                                uint16_t service_id, uint16_t opcode, std::chrono::microseconds timeout) {
 
-    std::lock_guard<std::mutex> lock(call_mutex_);
+    std::lock_guard<std::mutex> lock(hedged->lock_);
+    if (hedged->primary_done_ || hedged->answered_) {
+        return;
+    }
 
-    if (!conn_sync_) {
+    // 只有一个可用实例的时候不对冲，在同一个实例上重复请求多半同样慢
+    std::shared_ptr<Endpoint> endpoint = pick_hedge_endpoint(*primary);
+    if (!endpoint) {
+        return;
+    }
 
-        boost::system::error_code ec;
-        std::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr
-            = std::make_shared<boost::asio::ip::tcp::socket>(*client_setting_.io_service_);
+    if (!hedge_->try_acquire_budget()) {
+        roo::log_info("hedge budget exhausted, service_id %u, opcode %u.", service_id, opcode);
+        return;
+    }
 
-        socket_ptr->connect(boost::asio::ip::tcp::endpoint(
-                                boost::asio::ip::address::from_string(client_setting_.serv_addr_), client_setting_.serv_port_), ec);
-        if (ec) {
-            roo::log_err("Connect to %s:%u failed with {%d} %s.",
-                         client_setting_.serv_addr_.c_str(), client_setting_.serv_port_,
-                         ec.value(), ec.message().c_str());
-            return RpcClientStatus::NETWORK_CONNECT_ERROR;
+    {
+        std::lock_guard<std::mutex> hedge_lock(hedge_lock_);
+        hedge_inflight_.insert(hedged);
+    }
 
-        }
+    // 副本是阻塞的同步调用，不能占用io_service线程。hedge_workers_在析构的时候
+    // 等待进行中的副本结束，所以这里不需要持有RpcClientImpl的引用
+    // 排队的副本被丢弃的时候没有发送，归还预算
+    std::string payload = *hedged->payload_;
+    hedged->hedge_running_ = hedge_workers_->submit(
+        [=]() {
+            hedge_call(hedged, endpoint, service_id, opcode, payload, timeout);
+        },
+        [=]() {
+            hedge_->refund_budget();
+            finish_hedge(hedged);
+        });
+
+    if (!hedged->hedge_running_) {
+        hedge_->refund_budget();
+        std::lock_guard<std::mutex> hedge_lock(hedge_lock_);
+        hedge_inflight_.erase(hedged);
+    }
+}
+
+void RpcClientImpl::finish_hedge(const std::shared_ptr<HedgedCall>& hedged) {
+
+    {
+        std::lock_guard<std::mutex> lock(hedge_lock_);
+        hedge_inflight_.erase(hedged);
+    }
+
+    std::lock_guard<std::mutex> lock(hedged->lock_);
+    hedged->hedge_running_ = false;
+    hedged->hedge_notify_.notify_all();
+}
+
+void RpcClientImpl::hedge_call(std::shared_ptr<HedgedCall> hedged, std::shared_ptr<Endpoint> endpoint,
+                               uint16_t service_id, uint16_t opcode, const std::string& payload,
+                               std::chrono::microseconds timeout) {
+
+    // 线程都忙的时候副本会排队，开始执行的时候主请求可能已经得到了答复
+    bool skip = false;
+    {
+        std::lock_guard<std::mutex> lock(hedged->lock_);
+        skip = hedged->answered_ || hedged->aborted_;
+    }
+
+    if (skip) {
+        finish_hedge(hedged);
+        return;
+    }
 
-        conn_sync_.reset(new TcpConnSync(socket_ptr, *client_setting_.io_service_, client_setting_));
-        if (!conn_sync_) {
-            roo::log_err("Create socket %s:%u failed.",
-                         client_setting_.serv_addr_.c_str(), client_setting_.serv_port_);
-            return RpcClientStatus::NETWORK_BEFORE_ERROR;
+    // 借出的连接登记在hedged中，客户端析构的时候被关闭
+    std::string respload;
+    RpcClientStatus status = call_RPC_tracked(endpoint, service_id, opcode, payload, respload, timeout,
+                                              hedged.get(), true);
+
+    {
+        std::lock_guard<std::mutex> lock(hedged->lock_);
+        if (!hedged->answered_ && !hedged->aborted_ && is_answered(status)) {
+            hedged->answered_ = true;
+            hedged->status_ = status;
+            hedged->respload_ = std::move(respload);
+            hedge_->record_hedge_win();
+
+            if (hedged->primary_conn_) {
+                hedged->primary_conn_->abort();
+            }
         }
     }
 
-    time_start_ = ::time(NULL);
+    finish_hedge(hedged);
+}
+
+RpcClientStatus RpcClientImpl::call_RPC_endpoint(Endpoint& endpoint,
+                                                 uint16_t service_id, uint16_t opcode,
+                                                 const std::string& payload, std::string& respload,
+                                                 std::chrono::microseconds timeout,
+                                                 HedgedCall* hedged, bool is_hedge) {
+
+    std::shared_ptr<TcpConnSyncPool> conn_pool = endpoint.pool_;
+
+    std::shared_ptr<PooledConnSync> conn;
+    RpcClientStatus status = conn_pool->acquire(conn);
+    if (status != RpcClientStatus::OK) {
+        return status;
+    }
+
+    // 对冲调用登记借出的连接，另一方已经得到答复的时候不再发送
+    if (hedged && !hedged->attach_conn(is_hedge, conn)) {
+        conn_pool->release(conn, true);
+        return RpcClientStatus::NETWORK_BEFORE_ERROR;
+    }
+
+    auto time_start = std::chrono::steady_clock::now();
 
     // 构建请求包
     RpcRequestMessage rpc_request_message(service_id, opcode, payload);
+    rpc_request_message.header_.timeout_ms = header_timeout_ms(timeout);
+    rpc_request_message.header_.priority = static_cast<uint16_t>(client_setting_.priority_);
 
-    if (timeout_sec > 0) {
-        set_rpc_call_timeout(timeout_sec, true);
+    if (timeout.count() > 0) {
+        conn->set_timeout(timeout);
     }
 
     // 发送请求报文
-    if (!send_rpc_message(rpc_request_message)) {
-        conn_sync_.reset();
-        if (was_timeout_) {
-            roo::log_err("rpc_call was timeout with %d sec, and call activity started before %lu ago.",
-                         timeout_sec, (::time(NULL) - time_start_));
+    Message net_msg(rpc_request_message.net_str());
+    if (!conn->conn().send_net_message(net_msg)) {
+        if (hedged) {
+            hedged->detach_conn(is_hedge);
+        }
+        conn->cancel_timeout();
+        conn_pool->release(conn, false);
+        if (conn->was_timeout()) {
+            roo::log_err("rpc_call was timeout with %ld us, and call activity started before %ld us ago.",
+                         static_cast<long>(timeout.count()),
+                         static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - time_start).count()));
             return RpcClientStatus::RPC_CALL_TIMEOUT;
         }
         return RpcClientStatus::NETWORK_SEND_ERROR;
@@ -162,16 +575,29 @@ RpcClientStatus RpcClientImpl::call_RPC(uint16_t service_id, uint16_t opcode,
 
     // 接收报文
     Message net_message;
-    if (!recv_rpc_message(net_message)) {
-        conn_sync_.reset();
-        if (was_timeout_) {
-            roo::log_err("rpc_call was timeout with %d sec, and call activity started before %lu ago.",
-                         timeout_sec, (::time(NULL) - time_start_));
+    if (!conn->conn().recv_net_message(net_message)) {
+        if (hedged) {
+            hedged->detach_conn(is_hedge);
+        }
+        conn->cancel_timeout();
+        conn_pool->release(conn, false);
+        if (conn->was_timeout()) {
+            roo::log_err("rpc_call was timeout with %ld us, and call activity started before %ld us ago.",
+                         static_cast<long>(timeout.count()),
+                         static_cast<long>(std::chrono::duration_cast<std::chrono::microseconds>(
+                             std::chrono::steady_clock::now() - time_start).count()));
             return RpcClientStatus::RPC_CALL_TIMEOUT;
         }
         return RpcClientStatus::NETWORK_RECV_ERROR;
     }
 
+    // 一次请求答复已经完整读取，连接可以给其他调用者使用
+    if (hedged) {
+        hedged->detach_conn(is_hedge);
+    }
+    conn->cancel_timeout();
+    conn_pool->release(conn, true);
+
     // 解析报文
     RpcResponseMessage rpc_response_message;
     if (!RpcResponseMessageParse(net_message.payload_, rpc_response_message)) {
@@ -199,12 +625,6 @@ RpcClientStatus RpcClientImpl::call_RPC(uint16_t service_id, uint16_t opcode,
 }
 
 
-bool RpcClientImpl::send_rpc_message_async(const RpcRequestMessage& rpc_request_message) {
-    Message net_msg(rpc_request_message.net_str());
-    return conn_async_->send_net_message(net_msg);
-}
-
-
 void RpcClientImpl::async_recv_wrapper(const tzrpc::Message& net_message) {
 
     RpcClientStatus status = RpcClientStatus::OK;
@@ -221,10 +641,8 @@ void RpcClientImpl::async_recv_wrapper(const tzrpc::Message& net_message) {
         }
 
         // 返回参数校验
-        if (rpc_response_message.header_.magic != kRpcHeaderMagic //||
-            // rpc_response_message.header_.version != kRpcHeaderVersion ||
-            // rpc_response_message.header_.service_id != service_id ||
-           // rpc_response_message.header_.opcode != opcode
+        if (rpc_response_message.header_.magic != kRpcHeaderMagic
+            // || rpc_response_message.header_.version != kRpcHeaderVersion
            ) {
             roo::log_err("rpc_response_message header check error, full message header dump: %s]", 
                          rpc_response_message.header_.dump().c_str());
@@ -245,71 +663,596 @@ void RpcClientImpl::async_recv_wrapper(const tzrpc::Message& net_message) {
 
     } while (0);
 
-    // call
-    if (handler_) {
-        handler_(status, service_id, opcode, respload);
+    // 服务端没有带回关联ID，只能交给全局的handler处理
+    uint32_t call_id = net_message.header_.call_id;
+    if (call_id == 0) {
+        if (handler_) {
+            handler_(status, service_id, opcode, respload);
+        }
+        return;
+    }
+
+    std::shared_ptr<PendingCall> pending = take_pending_call(call_id);
+    if (!pending) {
+        roo::log_warning("response for call_id %u not found, maybe timeout already.", call_id);
+        return;
     }
+
+    cancel_pending_timeout(*pending);
+
+    // 错误答复中服务端不会填写service_id和opcode，只在成功的时候校验
+    if (status == RpcClientStatus::OK &&
+        (service_id != pending->service_id_ || opcode != pending->opcode_)) {
+        roo::log_err("call_id %u response mismatch, expect %u:%u but get %u:%u.",
+                     call_id, pending->service_id_, pending->opcode_, service_id, opcode);
+        status = RpcClientStatus::RECV_FORMAT_ERROR;
+        respload.clear();
+    }
+
+    pending->callback_(status, respload);
+}
+
+uint32_t RpcClientImpl::alloc_call_id() {
+
+    // 0表示不使用关联ID，回绕的时候跳过
+    uint32_t call_id = next_call_id_++;
+    if (call_id == 0) {
+        call_id = next_call_id_++;
+    }
+
+    return call_id;
+}
+
+std::shared_ptr<RpcClientImpl::PendingCall> RpcClientImpl::take_pending_call(uint32_t call_id) {
+
+    std::lock_guard<std::mutex> lock(pending_lock_);
+
+    auto iter = pending_calls_.find(call_id);
+    if (iter == pending_calls_.end()) {
+        return std::shared_ptr<PendingCall>();
+    }
+
+    std::shared_ptr<PendingCall> pending = iter->second;
+    pending_calls_.erase(iter);
+    return pending;
+}
+
+void RpcClientImpl::take_pending_calls(std::vector<std::shared_ptr<PendingCall>>& calls) {
+
+    std::lock_guard<std::mutex> lock(pending_lock_);
+
+    for (auto iter = pending_calls_.begin(); iter != pending_calls_.end(); ++iter) {
+        calls.push_back(iter->second);
+    }
+    pending_calls_.clear();
+}
+
+void RpcClientImpl::fail_pending_calls(std::vector<std::shared_ptr<PendingCall>>& calls, RpcClientStatus status) {
+
+    for (auto iter = calls.begin(); iter != calls.end(); ++iter) {
+        cancel_pending_timeout(**iter);
+        (*iter)->callback_(status, "");
+    }
+}
+
+void RpcClientImpl::cancel_pending_timeout(PendingCall& pending) {
+
+    // 请求已经从pending_calls_中取出，即使超时同时到期也不会再回调
+    if (pending.timer_armed_) {
+        call_timer_->cancel(pending.timer_handle_);
+        pending.timer_armed_ = false;
+    }
+}
+
+void RpcClientImpl::pending_call_timeout(uint32_t call_id) {
+
+    // 答复和超时同时发生的时候只有一方能取到请求
+    std::shared_ptr<PendingCall> pending = take_pending_call(call_id);
+    if (!pending) {
+        return;
+    }
+
+    roo::log_warning("rpc call_id %u timeout, service_id %u, opcode %u.",
+                     call_id, pending->service_id_, pending->opcode_);
+    pending->callback_(RpcClientStatus::RPC_CALL_TIMEOUT, "");
+}
+
+RpcClientStatus RpcClientImpl::call_RPC(uint16_t service_id, uint16_t opcode,
+                                        const std::string& payload,
+                                        std::chrono::microseconds timeout) {
+
+    // 兼容原来的接口，每个请求的答复仍然交给全局的handler处理
+    rpc_handler_t handler = handler_;
+    auto callback = [handler, service_id, opcode](const RpcClientStatus status, const std::string& rsp) {
+        if (handler) {
+            handler(status, service_id, opcode, rsp);
+        }
+    };
+
+    return call_RPC(service_id, opcode, payload, callback, timeout);
 }
 
 RpcClientStatus RpcClientImpl::call_RPC(uint16_t service_id, uint16_t opcode,
                                         const std::string& payload,
-                                        uint32_t timeout_sec) {
+                                        const rpc_callback_t& callback,
+                                        std::chrono::microseconds timeout) {
+
+    std::vector<AsyncCall> calls(1);
+    AsyncCall& call = calls.front();
+    call.service_id_ = service_id;
+    call.opcode_ = opcode;
+    call.payload_ = payload;
+    call.callback_ = callback;
+    call.timeout_ = timeout;
+    call.start_ = std::chrono::steady_clock::now();
+
+    if (client_setting_.batch_window_us_ > 0) {
+        enqueue_batch_call(call);
+        return RpcClientStatus::OK;
+    }
+
+    return send_calls_async(calls);
+}
+
+RpcClientStatus RpcClientImpl::call_RPC_batch(const std::vector<RpcBatchRequest>& requests,
+                                              std::vector<RpcCallResult>& results,
+                                              std::chrono::microseconds timeout) {
+
+    results.clear();
+    if (requests.empty()) {
+        return RpcClientStatus::OK;
+    }
+
+    // 所有请求完成、失败或者超时之后唤醒调用者
+    struct BatchState {
+        std::mutex lock_;
+        std::condition_variable cond_;
+        size_t remaining_;
+        std::vector<RpcCallResult> results_;
+    };
+
+    std::shared_ptr<BatchState> state = std::make_shared<BatchState>();
+    state->remaining_ = requests.size();
+    state->results_.assign(requests.size(), RpcCallResult(RpcClientStatus::NETWORK_BEFORE_ERROR, ""));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<AsyncCall> calls(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i) {
+        calls[i].service_id_ = requests[i].service_id_;
+        calls[i].opcode_ = requests[i].opcode_;
+        calls[i].payload_ = requests[i].payload_;
+        calls[i].timeout_ = timeout;
+        calls[i].start_ = start;
+        calls[i].callback_ = [state, i](const RpcClientStatus status, const std::string& rsp) {
+            std::lock_guard<std::mutex> lock(state->lock_);
+            state->results_[i] = RpcCallResult(status, rsp);
+            if (--state->remaining_ == 0) {
+                state->cond_.notify_one();
+            }
+        };
+    }
+
+    // 批量调用本身就是一次写出，不再进入自动批量发送的队列
+    RpcClientStatus status = send_calls_async(calls);
+    if (status != RpcClientStatus::OK) {
+        results.assign(requests.size(), RpcCallResult(status, ""));
+        return status;
+    }
+
+    std::unique_lock<std::mutex> lock(state->lock_);
+    state->cond_.wait(lock, [&state]() { return state->remaining_ == 0; });
+    results.swap(state->results_);
+
+    return RpcClientStatus::OK;
+}
+
+void RpcClientImpl::close_conn_async(std::vector<std::shared_ptr<PendingCall>>& broken_calls) {
+
+    if (conn_async_) {
+        conn_async_->shutdown_and_close_socket();
+        conn_async_.reset();
+    }
+
+    async_endpoint_.reset();
+    async_stat_ = AsyncConnStat::kDisconnected;
+    take_pending_calls(broken_calls);
+}
+
+void RpcClientImpl::start_connect_async() {
+
+    // 异步调用在一个连接上多路复用，只在建立连接的时候选择实例
+    std::shared_ptr<Endpoint> endpoint = pick_endpoint();
+    if (!endpoint) {
+        roo::log_err("no endpoint available.");
+        async_stat_ = AsyncConnStat::kDisconnected;
+        return;
+    }
+
+    uint64_t seq = ++connect_seq_;
+    std::weak_ptr<RpcClientImpl> weak_impl = shared_from_this();
+
+    // 所有实例都在退避期间，到期之后再重连
+    std::chrono::milliseconds delay = endpoint->backoff_->retry_after();
+    if (delay.count() > 0) {
+        async_stat_ = AsyncConnStat::kBackoff;
+        call_timer_->add(delay, [weak_impl, seq]() {
+            std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+            if (impl) {
+                impl->reconnect_timeout(seq);
+            }
+        });
+        return;
+    }
+
+    async_stat_ = AsyncConnStat::kConnecting;
+    connect_endpoint_ = endpoint;
+    connect_socket_ = std::make_shared<boost::asio::ip::tcp::socket>(*client_setting_.io_service_);
+
+    connect_socket_->async_connect(boost::asio::ip::tcp::endpoint(
+                                       boost::asio::ip::address::from_string(endpoint->addr_), endpoint->port_),
+                                   [weak_impl, seq](const boost::system::error_code& ec) {
+                                       std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+                                       if (impl) {
+                                           impl->connect_handler(seq, ec);
+                                       }
+                                   });
+
+    if (client_setting_.connect_timeout_ms_ > 0) {
+        connect_timer_handle_ = call_timer_->add(std::chrono::milliseconds(client_setting_.connect_timeout_ms_),
+                                                 [weak_impl, seq]() {
+                                                     std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+                                                     if (impl) {
+                                                         impl->connect_timeout(seq);
+                                                     }
+                                                 });
+        connect_timer_armed_ = true;
+    }
+}
+
+void RpcClientImpl::connect_timeout(uint64_t seq) {
 
     std::lock_guard<std::mutex> lock(call_mutex_);
 
-    if (!conn_async_) {
+    if (seq != connect_seq_ || async_stat_ != AsyncConnStat::kConnecting) {
+        return;
+    }
+
+    // 关闭socket之后connect_handler以operation_aborted返回，在那里处理失败
+    connect_timer_armed_ = false;
+    roo::log_err("connect to %s timeout with %u ms.",
+                 connect_endpoint_->key().c_str(), client_setting_.connect_timeout_ms_);
+
+    boost::system::error_code ignore_ec;
+    connect_socket_->close(ignore_ec);
+}
+
+void RpcClientImpl::connect_handler(uint64_t seq, const boost::system::error_code& ec) {
+
+    std::vector<std::shared_ptr<PendingCall>> broken_calls;
+    RpcClientStatus broken_status = RpcClientStatus::NETWORK_SEND_ERROR;
+
+    do {
+        std::lock_guard<std::mutex> lock(call_mutex_);
+
+        if (seq != connect_seq_ || async_stat_ != AsyncConnStat::kConnecting) {
+            return;
+        }
+
+        if (connect_timer_armed_) {
+            call_timer_->cancel(connect_timer_handle_);
+            connect_timer_armed_ = false;
+        }
 
-        boost::system::error_code ec;
-        std::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr
-            = std::make_shared<boost::asio::ip::tcp::socket>(*client_setting_.io_service_);
+        std::shared_ptr<Endpoint> endpoint = connect_endpoint_;
+        std::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr = connect_socket_;
+        connect_endpoint_.reset();
+        connect_socket_.reset();
 
-        socket_ptr->connect(boost::asio::ip::tcp::endpoint(
-                                boost::asio::ip::address::from_string(client_setting_.serv_addr_), client_setting_.serv_port_), ec);
         if (ec) {
-            roo::log_err("Connect to %s:%u failed with {%d} %s.",
-                         client_setting_.serv_addr_.c_str(), client_setting_.serv_port_,
-                         ec.value(), ec.message().c_str());
-            return RpcClientStatus::NETWORK_CONNECT_ERROR;
 
+            boost::system::error_code ignore_ec;
+            socket_ptr->close(ignore_ec);
+
+            std::chrono::milliseconds delay = endpoint->backoff_->failed();
+            roo::log_err("Connect to %s failed with {%d} %s, retry after %ld ms.",
+                         endpoint->key().c_str(), ec.value(), ec.message().c_str(), static_cast<long>(delay.count()));
+
+            // 还有其他可用实例的时候立即切换，否则等待退避结束
+            start_connect_async();
+
+            // 没有开启排队的时候，等待这次连接的请求不再等待退避结束
+            if (async_stat_ != AsyncConnStat::kConnecting && client_setting_.reconnect_queue_size_ == 0) {
+                take_reconnect_queue(broken_calls);
+            }
+
+            broken_status = RpcClientStatus::NETWORK_CONNECT_ERROR;
+            break;
         }
 
+        endpoint->backoff_->succeeded();
+
+        // 连接只持有RpcClientImpl的弱引用，避免互相引用导致都不能释放
+        std::weak_ptr<RpcClientImpl> weak_impl = shared_from_this();
         conn_async_.reset(new TcpConnAsync(socket_ptr, *client_setting_.io_service_, client_setting_,
-                                           std::bind(&RpcClientImpl::async_recv_wrapper, shared_from_this(),
-                                                     std::placeholders::_1)));
-        if (!conn_async_) {
-            roo::log_err("Create socket %s:%u failed.",
-                        client_setting_.serv_addr_.c_str(), client_setting_.serv_port_);
-            return RpcClientStatus::NETWORK_BEFORE_ERROR;
+                                           [weak_impl](const Message& net_message) {
+                                               std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+                                               if (impl) {
+                                                   impl->async_recv_wrapper(net_message);
+                                               }
+                                           },
+                                           [weak_impl, seq]() {
+                                               std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+                                               if (impl) {
+                                                   impl->async_conn_closed(seq);
+                                               }
+                                           }));
+
+        async_endpoint_ = endpoint;
+        async_stat_ = AsyncConnStat::kConnected;
+        conn_async_->recv_net_message();
+        roo::log_info("async connection to %s established.", endpoint->key().c_str());
+
+        // 发送重连期间排队的请求
+        prune_reconnect_queue();
+        if (!reconnect_queue_.empty()) {
+            std::vector<Message> net_msgs;
+            net_msgs.swap(reconnect_queue_);
+            if (!conn_async_->send_net_messages(net_msgs)) {
+                close_conn_async(broken_calls);
+            }
         }
 
-        conn_async_->recv_net_message();
+    } while (0);
+
+    fail_pending_calls(broken_calls, broken_status);
+}
+
+void RpcClientImpl::reconnect_timeout(uint64_t seq) {
+
+    std::lock_guard<std::mutex> lock(call_mutex_);
+
+    if (seq != connect_seq_ || async_stat_ != AsyncConnStat::kBackoff) {
+        return;
     }
 
-    time_start_ = ::time(NULL);
+    start_connect_async();
+}
+
+void RpcClientImpl::async_conn_closed(uint64_t seq) {
 
-    // 构建请求包
-    RpcRequestMessage rpc_request_message(service_id, opcode, payload);
+    std::vector<std::shared_ptr<PendingCall>> broken_calls;
 
-    if (timeout_sec > 0) {
-        set_rpc_call_timeout(timeout_sec, false);
+    {
+        std::lock_guard<std::mutex> lock(call_mutex_);
+
+        if (seq != connect_seq_ || async_stat_ != AsyncConnStat::kConnected) {
+            return;
+        }
+
+        roo::log_err("async connection to %s closed, reconnect in background.", async_endpoint_->key().c_str());
+        close_conn_async(broken_calls);
+        start_connect_async();
     }
 
-    // 发送请求报文
-    if (!send_rpc_message_async(rpc_request_message)) {
-        conn_async_.reset();
-        // 异步发送应该很快返回的，理论上不会在这里出现超时
-        if (was_timeout_) {
-            roo::log_err("rpc_call was timeout with %d sec, and call activity started before %lu ago.",
-                        timeout_sec, (::time(NULL) - time_start_));
-            return RpcClientStatus::RPC_CALL_TIMEOUT;
+    fail_pending_calls(broken_calls, RpcClientStatus::NETWORK_RECV_ERROR);
+}
+
+void RpcClientImpl::prune_reconnect_queue() {
+
+    std::lock_guard<std::mutex> lock(pending_lock_);
+
+    auto iter = reconnect_queue_.begin();
+    while (iter != reconnect_queue_.end()) {
+        if (pending_calls_.find(static_cast<uint32_t>(iter->header_.call_id)) == pending_calls_.end()) {
+            iter = reconnect_queue_.erase(iter);
+        } else {
+            ++iter;
         }
-        return RpcClientStatus::NETWORK_SEND_ERROR;
     }
+}
 
-    // 手动触发异步读取服务端响应
-    //conn_async_->recv_net_message();
+void RpcClientImpl::take_reconnect_queue(std::vector<std::shared_ptr<PendingCall>>& broken_calls) {
 
-    return RpcClientStatus::OK;
+    for (auto iter = reconnect_queue_.begin(); iter != reconnect_queue_.end(); ++iter) {
+        std::shared_ptr<PendingCall> pending = take_pending_call(static_cast<uint32_t>(iter->header_.call_id));
+        if (pending) {
+            broken_calls.push_back(pending);
+        }
+    }
+    reconnect_queue_.clear();
+}
+
+void RpcClientImpl::register_calls(const std::vector<AsyncCall>& calls, std::vector<Message>& net_msgs) {
+
+    std::weak_ptr<RpcClientImpl> weak_impl = shared_from_this();
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto iter = calls.begin(); iter != calls.end(); ++iter) {
+
+        // 在自动批量发送队列中等待的时间也计算在超时之内
+        std::chrono::microseconds timeout = iter->timeout_;
+        if (timeout.count() > 0) {
+            timeout -= std::chrono::duration_cast<std::chrono::microseconds>(now - iter->start_);
+            if (timeout.count() <= 0) {
+                timeout = std::chrono::microseconds(1);
+            }
+        }
+
+        // 构建请求包
+        RpcRequestMessage rpc_request_message(iter->service_id_, iter->opcode_, iter->payload_);
+        rpc_request_message.header_.timeout_ms = header_timeout_ms(timeout);
+        rpc_request_message.header_.priority = static_cast<uint16_t>(client_setting_.priority_);
+
+        // 答复可能在发送返回之前就到达，所以需要先登记
+        uint32_t call_id = alloc_call_id();
+        std::shared_ptr<PendingCall> pending = std::make_shared<PendingCall>();
+        pending->service_id_ = iter->service_id_;
+        pending->opcode_ = iter->opcode_;
+        pending->callback_ = iter->callback_;
+        pending->timer_armed_ = false;
+
+        if (timeout.count() > 0) {
+            pending->timer_handle_ = call_timer_->add(timeout, [weak_impl, call_id]() {
+                std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+                if (impl) {
+                    impl->pending_call_timeout(call_id);
+                }
+            });
+            pending->timer_armed_ = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> pending_lock(pending_lock_);
+            pending_calls_[call_id] = pending;
+        }
+
+        net_msgs.emplace_back(rpc_request_message.net_str());
+        net_msgs.back().header_.call_id = call_id;
+    }
+}
+
+void RpcClientImpl::unregister_calls(const std::vector<Message>& net_msgs) {
+
+    // 这些请求返回错误给调用者，不再回调
+    for (auto iter = net_msgs.begin(); iter != net_msgs.end(); ++iter) {
+        std::shared_ptr<PendingCall> pending = take_pending_call(static_cast<uint32_t>(iter->header_.call_id));
+        if (pending) {
+            cancel_pending_timeout(*pending);
+        }
+    }
+}
+
+RpcClientStatus RpcClientImpl::send_calls_async(const std::vector<AsyncCall>& calls) {
+
+    // 连接失效的请求在释放call_mutex_之后通知，避免回调中再次发起调用死锁
+    std::vector<std::shared_ptr<PendingCall>> broken_calls;
+    RpcClientStatus result = RpcClientStatus::OK;
+
+    do {
+
+        std::lock_guard<std::mutex> lock(call_mutex_);
+
+        // 连接已经断开，但是还没有收到关闭的通知
+        if (async_stat_ == AsyncConnStat::kConnected &&
+            conn_async_->get_conn_stat() != tzrpc::ConnStat::kWorking) {
+            roo::log_err("async connection to %s broken, reconnect it.", async_endpoint_->key().c_str());
+            close_conn_async(broken_calls);
+        }
+
+        if (async_stat_ == AsyncConnStat::kDisconnected) {
+            start_connect_async();
+        }
+
+        // 开启排队的时候，连接建立之前的请求进入队列，连接建立之后发送
+        // 不排队的时候，正在建立连接期间的请求同样进入队列，连接失败的时候通过
+        // callback通知失败。这里不能阻塞等待连接：批量发送的定时器和答复的回调
+        // 都在io_service线程中调用，阻塞之后连接本身也无法完成
+        if (async_stat_ == AsyncConnStat::kConnecting ||
+            (async_stat_ != AsyncConnStat::kConnected && client_setting_.reconnect_queue_size_ > 0)) {
+
+            if (client_setting_.reconnect_queue_size_ > 0 &&
+                reconnect_queue_.size() + calls.size() > client_setting_.reconnect_queue_size_) {
+                prune_reconnect_queue();
+            }
+
+            if (client_setting_.reconnect_queue_size_ > 0 &&
+                reconnect_queue_.size() + calls.size() > client_setting_.reconnect_queue_size_) {
+                roo::log_err("reconnect queue full with %d requests, reject %d requests.",
+                             static_cast<int>(reconnect_queue_.size()), static_cast<int>(calls.size()));
+                result = RpcClientStatus::NETWORK_CONNECT_ERROR;
+                break;
+            }
+
+            register_calls(calls, reconnect_queue_);
+            break;
+        }
+
+        // 实例在退避期间，直接失败
+        if (async_stat_ != AsyncConnStat::kConnected) {
+            result = RpcClientStatus::NETWORK_CONNECT_ERROR;
+            break;
+        }
+
+        std::vector<Message> net_msgs;
+        net_msgs.reserve(calls.size());
+        register_calls(calls, net_msgs);
+
+        // 发送请求报文
+        if (!conn_async_->send_net_messages(net_msgs)) {
+            unregister_calls(net_msgs);
+            close_conn_async(broken_calls);
+            result = RpcClientStatus::NETWORK_SEND_ERROR;
+            break;
+        }
+
+    } while (0);
+
+    fail_pending_calls(broken_calls, RpcClientStatus::NETWORK_RECV_ERROR);
+    return result;
+}
+
+void RpcClientImpl::enqueue_batch_call(const AsyncCall& call) {
+
+    std::vector<AsyncCall> calls;
+
+    {
+        std::lock_guard<std::mutex> lock(batch_lock_);
+        batch_queue_.push_back(call);
+
+        if (batch_queue_.size() < client_setting_.batch_max_calls_) {
+            if (!batch_timer_armed_) {
+                std::weak_ptr<RpcClientImpl> weak_impl = shared_from_this();
+                batch_timer_handle_ = call_timer_->add(std::chrono::microseconds(client_setting_.batch_window_us_),
+                                                       [weak_impl]() {
+                                                           std::shared_ptr<RpcClientImpl> impl = weak_impl.lock();
+                                                           if (impl) {
+                                                               impl->flush_batch_calls();
+                                                           }
+                                                       });
+                batch_timer_armed_ = true;
+            }
+            return;
+        }
+
+        // 积累的请求足够多，不用等到窗口结束
+        calls.swap(batch_queue_);
+        if (batch_timer_armed_) {
+            call_timer_->cancel(batch_timer_handle_);
+            batch_timer_armed_ = false;
+        }
+    }
+
+    send_batch_calls(calls);
+}
+
+void RpcClientImpl::flush_batch_calls() {
+
+    std::vector<AsyncCall> calls;
+
+    {
+        std::lock_guard<std::mutex> lock(batch_lock_);
+        calls.swap(batch_queue_);
+        batch_timer_armed_ = false;
+    }
+
+    send_batch_calls(calls);
+}
+
+void RpcClientImpl::send_batch_calls(const std::vector<AsyncCall>& calls) {
+
+    if (calls.empty()) {
+        return;
+    }
+
+    // 调用者已经得到了OK的返回，发送失败只能通过callback通知
+    RpcClientStatus status = send_calls_async(calls);
+    if (status != RpcClientStatus::OK) {
+        roo::log_err("send %d batched calls failed with status %d.",
+                     static_cast<int>(calls.size()), static_cast<int>(status));
+        for (auto iter = calls.begin(); iter != calls.end(); ++iter) {
+            iter->callback_(status, "");
+        }
+    }
 }
 
 
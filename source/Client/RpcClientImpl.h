@@ -10,27 +10,38 @@
 
 #include <xtra_rhel.h>
 
-#include <boost/asio/steady_timer.hpp>
-using boost::asio::steady_timer;
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/asio.hpp>
 
 #include <other/Log.h>
 
+#include <Core/Message.h>
+
 #include <concurrency/IoService.h>
 #include <Client/include/RpcClientStatus.h>
 #include <Client/include/RpcClient.h>
+#include <Client/LoadBalancer.h>
+#include <Client/CallTimer.h>
+#include <Client/HedgePolicy.h>
+#include <Client/HedgeWorkers.h>
 
 namespace tzrpc {
 
 class RpcRequestMessage;
 class RpcResponseMessage;
-class Message;
 
 }
 
 namespace tzrpc_client {
 
-class TcpConnSync;
+class TcpConnSyncPool;
 class TcpConnAsync;
+class PooledConnSync;
 
 ///////////////////////////
 //
@@ -50,12 +61,31 @@ public:
         io_service_(),
         roo_io_service_(),
         call_mutex_(),
-        time_start_(0),
-        was_timeout_(false),
-        rpc_call_timer_(),
-        conn_sync_(),
+        call_timer_(),
+        balancer_(),
+        endpoints_lock_(),
+        endpoints_(),
+        hedge_(),
+        hedge_workers_(),
+        hedge_lock_(),
+        hedge_inflight_(),
         conn_async_(),
-        handler_() {
+        async_endpoint_(),
+        async_stat_(AsyncConnStat::kDisconnected),
+        connect_seq_(0),
+        connect_socket_(),
+        connect_endpoint_(),
+        connect_timer_armed_(false),
+        connect_timer_handle_(),
+        reconnect_queue_(),
+        handler_(),
+        next_call_id_(1),
+        pending_lock_(),
+        pending_calls_(),
+        batch_lock_(),
+        batch_queue_(),
+        batch_timer_armed_(false),
+        batch_timer_handle_() {
     }
 
     ~RpcClientImpl();
@@ -69,11 +99,22 @@ public:
 
     RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
                              const std::string& payload, std::string& respload,
-                             uint32_t timeout_sec);
+                             std::chrono::microseconds timeout);
+
+    RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
+                             const std::string& payload,
+                             std::chrono::microseconds timeout);
 
     RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
                              const std::string& payload,
-                             uint32_t timeout_sec);
+                             const rpc_callback_t& callback,
+                             std::chrono::microseconds timeout);
+
+    RpcClientStatus call_RPC_batch(const std::vector<RpcBatchRequest>& requests,
+                                   std::vector<RpcCallResult>& results,
+                                   std::chrono::microseconds timeout);
+
+    bool update_endpoints(const std::vector<std::string>& endpoints);
 
 private:
 
@@ -82,32 +123,209 @@ private:
     std::unique_ptr<roo::IoService> roo_io_service_;
     
 
-    // 确保不会客户端多线程调用，导致底层的连接串话
+    // 异步连接的状态变化和发送需要串行，同步调用使用连接池，不受这个锁的限制
     std::mutex call_mutex_;
 
-    bool send_rpc_message(const tzrpc::RpcRequestMessage& rpc_request_message);
-    bool recv_rpc_message(tzrpc::Message& net_message);
+    // 同步和异步调用共享的超时定时器
+    std::shared_ptr<CallTimer> call_timer_;
 
     //
-    // rpc调用超时相关的配置
+    // 服务端实例列表和负载均衡
     //
-    time_t time_start_;        // 请求创建的时间
-    bool was_timeout_;
-    std::unique_ptr<steady_timer> rpc_call_timer_;
-    void set_rpc_call_timeout(uint32_t msec, bool sync); // 区分同步和异步的操作超时
-    void rpc_call_timeout(const boost::system::error_code& ec, bool sync);
-
-    // 请求到达后按照需求自动创建
-    std::shared_ptr<TcpConnSync>  conn_sync_;
+    std::unique_ptr<LoadBalancer> balancer_;
+
+    // 列表整体替换，调用者取得快照之后在锁外选择实例
+    std::mutex endpoints_lock_;
+    std::shared_ptr<const EndpointList> endpoints_;
+
+    std::shared_ptr<Endpoint> create_endpoint(const std::string& addr, uint16_t port);
+    std::shared_ptr<Endpoint> pick_endpoint();
+
+    // 对冲调用的共享状态
+    // 主请求在调用线程中执行，超过对冲延迟之后在另一个实例上发送副本，先得到
+    // 答复的一方有效。副本先得到答复的时候关闭主请求借出的连接，让阻塞的读取
+    // 返回，主请求先得到答复的时候副本的答复被忽略
+    struct HedgedCall {
+        std::mutex lock_;
+        std::condition_variable hedge_notify_;
+        const std::string* payload_;                // 主请求完成之前有效
+        bool primary_done_;
+        bool hedge_running_;
+        bool answered_;                             // 已经有一方得到了答复
+        bool aborted_;                              // 客户端析构，副本不再发送
+        RpcClientStatus status_;                    // 副本的答复
+        std::string respload_;
+        std::shared_ptr<PooledConnSync> primary_conn_;
+        std::shared_ptr<PooledConnSync> hedge_conn_;
+
+        explicit HedgedCall(const std::string& payload) :
+            lock_(), hedge_notify_(), payload_(&payload),
+            primary_done_(false), hedge_running_(false), answered_(false), aborted_(false),
+            status_(RpcClientStatus::OK), respload_(), primary_conn_(), hedge_conn_() {
+        }
+
+        // 登记借出的连接，之后另一方或者客户端析构可以关闭这个连接
+        // 已经有答复或者被中止的时候返回false，请求不需要再发送
+        bool attach_conn(bool is_hedge, std::shared_ptr<PooledConnSync> conn) {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (answered_ || aborted_) {
+                return false;
+            }
+            (is_hedge ? hedge_conn_ : primary_conn_) = conn;
+            return true;
+        }
+
+        // 连接归还之前取消登记，之后不会再被关闭
+        void detach_conn(bool is_hedge) {
+            std::lock_guard<std::mutex> lock(lock_);
+            (is_hedge ? hedge_conn_ : primary_conn_).reset();
+        }
+    };
+
+    // 对冲的幂等请求
+    std::unique_ptr<HedgePolicy> hedge_;
+    std::unique_ptr<HedgeWorkers> hedge_workers_;
+
+    // 已经提交给hedge_workers_还没有结束的副本，析构的时候中止它们的连接
+    std::mutex hedge_lock_;
+    std::set<std::shared_ptr<HedgedCall>> hedge_inflight_;
+
+    RpcClientStatus call_RPC_hedged(uint16_t service_id, uint16_t opcode,
+                                    const std::string& payload, std::string& respload,
+                                    std::chrono::microseconds timeout);
+
+    // 对冲延迟到期，在io_service线程中调用，副本交给hedge_workers_执行
+    void start_hedge(std::shared_ptr<HedgedCall> hedged, std::shared_ptr<Endpoint> primary,
+                     uint16_t service_id, uint16_t opcode, std::chrono::microseconds timeout);
+    void hedge_call(std::shared_ptr<HedgedCall> hedged, std::shared_ptr<Endpoint> endpoint,
+                    uint16_t service_id, uint16_t opcode, const std::string& payload,
+                    std::chrono::microseconds timeout);
+
+    // 副本结束或者被丢弃，唤醒等待的主请求
+    void finish_hedge(const std::shared_ptr<HedgedCall>& hedged);
+
+    // 除了primary之外的可用实例中选择，没有的时候返回空
+    std::shared_ptr<Endpoint> pick_hedge_endpoint(const Endpoint& primary);
+
+    // 在选定的实例上同步调用，并且更新实例的负载均衡统计
+    RpcClientStatus call_RPC_tracked(const std::shared_ptr<Endpoint>& endpoint,
+                                     uint16_t service_id, uint16_t opcode,
+                                     const std::string& payload, std::string& respload,
+                                     std::chrono::microseconds timeout,
+                                     HedgedCall* hedged, bool is_hedge);
+
+    // 同步调用，连接从所选实例的连接池中借出
+    // hedged不为空的时候是对冲调用的主请求或者副本(is_hedge)，借出的连接登记在hedged中
+    RpcClientStatus call_RPC_endpoint(Endpoint& endpoint,
+                                      uint16_t service_id, uint16_t opcode,
+                                      const std::string& payload, std::string& respload,
+                                      std::chrono::microseconds timeout,
+                                      HedgedCall* hedged, bool is_hedge);
 
     // 异步处理的连接
 
-    bool send_rpc_message_async(const tzrpc::RpcRequestMessage& rpc_request_message);
-
     // 这里进行一些RPC数据包的解析操作，业务层不做包细节的处理
     void async_recv_wrapper(const tzrpc::Message& net_message);
     std::shared_ptr<TcpConnAsync> conn_async_;
+    std::shared_ptr<Endpoint> async_endpoint_;   // 异步连接建立的时候由负载均衡选择
+
+    //
+    // 异步连接的状态，由call_mutex_保护
+    // 连接在后台异步建立，失败之后按照实例的退避时间重连，调用者不会阻塞在
+    // 系统的连接超时上，实例退避期间的调用直接失败
+    //
+    enum class AsyncConnStat : uint8_t {
+        kDisconnected = 1,      // 没有连接，下次调用的时候建立
+        kConnecting   = 2,
+        kConnected    = 3,
+        kBackoff      = 4,      // 建立连接失败，等待退避结束之后重连
+    };
+
+    AsyncConnStat async_stat_;
+    uint64_t connect_seq_;      // 每次建立连接递增，过期的回调直接忽略
+    std::shared_ptr<boost::asio::ip::tcp::socket> connect_socket_;
+    std::shared_ptr<Endpoint> connect_endpoint_;
+    bool connect_timer_armed_;
+    CallTimer::handle_t connect_timer_handle_;
+
+    // 建立连接期间排队的请求报文，请求已经登记在pending_calls_中，各自的超时仍然有效
+    // reconnect_queue_size_为0的时候只在kConnecting期间排队，连接失败的时候取出并通知失败
+    std::vector<tzrpc::Message> reconnect_queue_;
+
+    void start_connect_async();
+    void connect_handler(uint64_t seq, const boost::system::error_code& ec);
+    void connect_timeout(uint64_t seq);
+    void reconnect_timeout(uint64_t seq);
+
+    // 连接因为网络错误或者服务端关闭而断开，失败所有等待的请求并在后台重连
+    void async_conn_closed(uint64_t seq);
+
     rpc_handler_t handler_;
+
+    //
+    // 异步连接上等待答复的请求，按照关联ID索引
+    //
+    struct PendingCall {
+        uint16_t service_id_;
+        uint16_t opcode_;
+        rpc_callback_t callback_;
+        bool timer_armed_;                    // 没有设置超时的时候为false
+        CallTimer::handle_t timer_handle_;
+    };
+
+    std::atomic<uint32_t> next_call_id_;
+    std::mutex pending_lock_;
+    std::map<uint32_t, std::shared_ptr<PendingCall>> pending_calls_;
+
+    uint32_t alloc_call_id();
+    std::shared_ptr<PendingCall> take_pending_call(uint32_t call_id);
+
+    // 连接失效的时候取出所有等待的请求，调用者在释放锁之后通知失败
+    void take_pending_calls(std::vector<std::shared_ptr<PendingCall>>& calls);
+    void fail_pending_calls(std::vector<std::shared_ptr<PendingCall>>& calls, RpcClientStatus status);
+    void cancel_pending_timeout(PendingCall& pending);
+
+    // 单个请求的超时，只让这个请求失败，连接上的其他请求不受影响
+    void pending_call_timeout(uint32_t call_id);
+
+    // 关闭异步连接并取出所有等待的请求，调用者持有call_mutex_
+    void close_conn_async(std::vector<std::shared_ptr<PendingCall>>& broken_calls);
+
+    //
+    // 等待在异步连接上发送的请求
+    //
+    struct AsyncCall {
+        uint16_t service_id_;
+        uint16_t opcode_;
+        std::string payload_;
+        rpc_callback_t callback_;
+        std::chrono::microseconds timeout_;
+        std::chrono::steady_clock::time_point start_;    // 超时从请求发起开始计算
+    };
+
+    // 多个请求在异步连接上一次写出，返回值不是OK的时候这些请求都没有发出，
+    // callback不会被调用
+    RpcClientStatus send_calls_async(const std::vector<AsyncCall>& calls);
+
+    // 构建请求报文并登记等待答复，报文追加到net_msgs中
+    void register_calls(const std::vector<AsyncCall>& calls, std::vector<tzrpc::Message>& net_msgs);
+    void unregister_calls(const std::vector<tzrpc::Message>& net_msgs);
+
+    // 去掉排队期间已经超时的请求
+    void prune_reconnect_queue();
+    // 取出排队的请求，调用者在释放锁之后通知失败
+    void take_reconnect_queue(std::vector<std::shared_ptr<PendingCall>>& broken_calls);
+
+    // 自动批量发送，窗口中的第一个请求启动定时器，窗口结束或者请求积累到
+    // batch_max_calls_的时候一起发送
+    std::mutex batch_lock_;
+    std::vector<AsyncCall> batch_queue_;
+    bool batch_timer_armed_;
+    CallTimer::handle_t batch_timer_handle_;
+
+    void enqueue_batch_call(const AsyncCall& call);
+    void flush_batch_calls();
+    void send_batch_calls(const std::vector<AsyncCall>& calls);
 };
 
 
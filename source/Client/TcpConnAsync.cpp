@@ -28,10 +28,13 @@ using tzrpc::ShutdownType;
 TcpConnAsync::TcpConnAsync(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
                            boost::asio::io_service& io_service,
                            RpcClientSetting& client_setting,
-                           const rpc_wrapper_t& handler) :
+                           const rpc_wrapper_t& handler,
+                           const conn_close_t& close_handler) :
     NetConn(socket),
     client_setting_(client_setting),
     wrapper_handler_(handler),
+    close_handler_(close_handler),
+    close_notified_(false),
     io_service_(io_service),
     strand_(std::make_shared<boost::asio::io_service::strand>(io_service)),
     send_status_(SendStatus::kDone) {
@@ -50,9 +53,6 @@ TcpConnAsync::~TcpConnAsync() {
 
 bool TcpConnAsync::do_write() {
 
-    if (send_status_ != SendStatus::kDone)
-        return true;
-
     roo::log_info("strand write ... in thread %#lx", (long)pthread_self());
 
     if (get_conn_stat() != ConnStat::kWorking) {
@@ -64,17 +64,21 @@ bool TcpConnAsync::do_write() {
     {
         std::lock_guard<std::mutex> lock(bound_mutex_);
 
+        // 上一次写操作完成之前追加的报文，在write_handler中一起发送
+        if (send_status_ != SendStatus::kDone)
+            return true;
+
         if (send_bound_.buffer_.get_length() == 0) {
             return true;
         }
 
-        uint32_t to_write = std::min((uint32_t)(send_bound_.buffer_.get_length()),
-                                     (uint32_t)(kFixedIoBufferSize));
-
-        send_bound_.buffer_.consume(send_bound_.io_block_, to_write);
+        // 缓冲区中积累的报文一次全部写出，不再按照io_block_的大小分段，
+        // 批量发送的大量小请求只需要很少的系统调用
+        uint32_t to_write = send_bound_.buffer_.get_length();
+        send_bound_.buffer_.consume(send_pending_, to_write);
         send_status_ = SendStatus::kSend;
 
-        async_write(*socket_, boost::asio::buffer(send_bound_.io_block_, to_write),
+        async_write(*socket_, boost::asio::buffer(send_pending_),
                     boost::asio::transfer_exactly(to_write),
                     strand_->wrap(
                         std::bind(&TcpConnAsync::write_handler,
@@ -97,7 +101,10 @@ void TcpConnAsync::write_handler(const boost::system::error_code& ec, size_t byt
     // transfer_at_least 应该可以保证将需要的数据传输完，除非错误发生了
     SAFE_ASSERT(bytes_transferred > 0);
 
-    send_status_ = SendStatus::kDone;
+    {
+        std::lock_guard<std::mutex> lock(bound_mutex_);
+        send_status_ = SendStatus::kDone;
+    }
 
     // 再次触发写，如果为空就直接返回
     // 函数中会检查，如果内容为空，就直接返回不执行写操作
@@ -172,7 +179,7 @@ bool TcpConnAsync::do_read() {
         return true;
     } else {
         roo::log_err("read error found, shutdown connection...");
-        sock_shutdown_and_close(ShutdownType::kBoth);
+        close_on_error();
         return false;
     }
 
@@ -207,7 +214,7 @@ void TcpConnAsync::read_handler(const boost::system::error_code& ec, std::size_t
         return;
     } else {
         roo::log_err("read_handler error found, shutdown connection...");
-        sock_shutdown_and_close(ShutdownType::kBoth);
+        close_on_error();
         return;
     }
 }
@@ -276,7 +283,7 @@ void TcpConnAsync::do_read_msg() {
         } else {
 
             roo::log_err("read_msg error found, shutdown connection...");
-            sock_shutdown_and_close(ShutdownType::kBoth);
+            close_on_error();
             return;
 
         }
@@ -318,7 +325,7 @@ void TcpConnAsync::read_msg_handler(const boost::system::error_code& ec, size_t
     } else {
 
         roo::log_err("read_msg_handler error found, shutdown connection...");
-        sock_shutdown_and_close(ShutdownType::kBoth);
+        close_on_error();
         return;
 
     }
@@ -327,6 +334,16 @@ void TcpConnAsync::read_msg_handler(const boost::system::error_code& ec, size_t
 
 // socket helper function here...
 
+void TcpConnAsync::close_on_error() {
+
+    sock_shutdown_and_close(ShutdownType::kBoth);
+
+    // 只通知一次，上层主动关闭的连接不通知
+    if (close_handler_ && !close_notified_.exchange(true)) {
+        close_handler_();
+    }
+}
+
 // http://www.boost.org/doc/libs/1_44_0/doc/html/boost_asio/reference/error__basic_errors.html
 bool TcpConnAsync::handle_socket_ec(const boost::system::error_code& ec) {
 
@@ -351,7 +368,7 @@ bool TcpConnAsync::handle_socket_ec(const boost::system::error_code& ec) {
 
 
     if (close_socket) {
-        sock_shutdown_and_close(ShutdownType::kBoth);
+        close_on_error();
     }
 
     return close_socket;
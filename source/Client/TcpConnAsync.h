@@ -11,6 +11,9 @@
 
 #include <xtra_rhel.h>
 
+#include <atomic>
+#include <vector>
+
 #include <Network/NetConn.h>
 #include <other/Log.h>
 
@@ -28,6 +31,9 @@ class RpcClientSetting;
 
 typedef std::function<void(const tzrpc::Message& net_message)> rpc_wrapper_t;
 
+// 连接因为网络错误或者服务端关闭而断开的时候调用
+typedef std::function<void()> conn_close_t;
+
 class TcpConnAsync : public NetConn,
     public std::enable_shared_from_this<TcpConnAsync> {
 
@@ -40,7 +46,8 @@ public:
     TcpConnAsync(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
                  boost::asio::io_service& io_service,
                  RpcClientSetting& client_setting,
-                 const rpc_wrapper_t& handler);
+                 const rpc_wrapper_t& handler,
+                 const conn_close_t& close_handler = conn_close_t());
 
     virtual ~TcpConnAsync();
 
@@ -61,6 +68,28 @@ public:
         return do_write();
     }
 
+    // 多个报文在一次加锁中追加到发送缓冲区，然后一起写出
+    bool send_net_messages(const std::vector<Message>& msgs) {
+
+        for (auto iter = msgs.begin(); iter != msgs.end(); ++iter) {
+            if (client_setting_.send_max_msg_size_ != 0 &&
+                iter->header_.length > client_setting_.send_max_msg_size_) {
+                roo::log_err("Limit send_max_msg_size length to %d, but need to send content length %d.",
+                             static_cast<int>(client_setting_.send_max_msg_size_), static_cast<int>(iter->header_.length));
+                return false;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(bound_mutex_);
+            for (auto iter = msgs.begin(); iter != msgs.end(); ++iter) {
+                send_bound_.buffer_.append(*iter);
+            }
+        }
+
+        return do_write();
+    }
+
     // 在连接创建后，由上层应用发起读取响应请求，然后会根据协议包格式，依次读取
     // 每个完整的响应报文
     // !!! 不要在send_net_message调用后再调用这个函数
@@ -69,6 +98,7 @@ public:
     }
 
 
+    // 上层主动关闭连接，不会调用close_handler
     // between shutdown and close on a socket is the behavior when the socket is shared by other processes.
     // A shutdown() affects all copies of the socket while close() affects only the file descriptor in one process.
     void shutdown_and_close_socket() {
@@ -96,6 +126,10 @@ private:
     // 主要用来进行Rpc拆包，然后再调用内部嵌套的业务层回调函数
     rpc_wrapper_t wrapper_handler_;
 
+    conn_close_t close_handler_;
+    std::atomic<bool> close_notified_;
+    void close_on_error();
+
 
     boost::asio::io_service& io_service_;
 
@@ -114,6 +148,9 @@ private:
     // 客户端显式发起请求
     SendStatus send_status_;
     IOBound send_bound_;
+
+    // 正在写出的数据，写操作完成之前需要保持有效
+    std::string send_pending_;
 };
 
 
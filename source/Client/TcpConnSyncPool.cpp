@@ -0,0 +1,441 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <other/Log.h>
+
+#include <Client/TcpConnSyncPool.h>
+#include <Client/TcpConnSync.h>
+
+namespace tzrpc_client {
+
+PooledConnSync::PooledConnSync(std::shared_ptr<TcpConnSync> conn, std::shared_ptr<CallTimer> call_timer) :
+    conn_(conn),
+    call_timer_(call_timer),
+    timer_lock_(),
+    timer_handle_(),
+    timer_armed_(false),
+    timer_seq_(0),
+    was_timeout_(false) {
+}
+
+bool PooledConnSync::is_working() const {
+    return conn_->get_conn_stat() == tzrpc::ConnStat::kWorking;
+}
+
+void PooledConnSync::set_timeout(std::chrono::microseconds timeout) {
+
+    std::lock_guard<std::mutex> lock(timer_lock_);
+
+    was_timeout_ = false;
+    ++timer_seq_;
+
+    timer_handle_ = call_timer_->add(timeout, std::bind(&PooledConnSync::timeout_handler, shared_from_this(),
+                                                        timer_seq_));
+    timer_armed_ = true;
+}
+
+void PooledConnSync::cancel_timeout() {
+
+    std::lock_guard<std::mutex> lock(timer_lock_);
+
+    ++timer_seq_;
+
+    if (timer_armed_) {
+        call_timer_->cancel(timer_handle_);
+        timer_armed_ = false;
+    }
+}
+
+void PooledConnSync::abort() {
+    conn_->shutdown_and_close_socket();
+}
+
+void PooledConnSync::timeout_handler(uint64_t seq) {
+
+    std::lock_guard<std::mutex> lock(timer_lock_);
+
+    // 到期和取消同时发生，请求已经完成，连接可能已经借给了其他调用者
+    if (seq != timer_seq_) {
+        return;
+    }
+
+    roo::log_warning("rpc_call_timeout called, shutdown the pooled connection.");
+    timer_armed_ = false;
+    was_timeout_ = true;
+    conn_->shutdown_and_close_socket();
+}
+
+
+TcpConnSyncPool::TcpConnSyncPool(const RpcClientSetting& client_setting, std::shared_ptr<CallTimer> call_timer,
+                                 std::shared_ptr<ConnectBackoff> backoff) :
+    client_setting_(client_setting),
+    call_timer_(call_timer),
+    backoff_(backoff),
+    lock_(),
+    conn_notify_(),
+    idle_(),
+    total_(0),
+    warming_up_(false),
+    closed_(false),
+    warm_up_socket_(),
+    warm_up_seq_(0),
+    warm_up_timer_handle_(),
+    warm_up_timer_armed_(false),
+    create_count_(0),
+    wait_timeout_count_(0) {
+
+    if (client_setting_.pool_max_conns_ == 0) {
+        client_setting_.pool_max_conns_ = 1;
+    }
+
+    if (client_setting_.pool_min_conns_ > client_setting_.pool_max_conns_) {
+        client_setting_.pool_min_conns_ = client_setting_.pool_max_conns_;
+    }
+}
+
+TcpConnSyncPool::~TcpConnSyncPool() {
+    shutdown();
+}
+
+bool TcpConnSyncPool::init() {
+
+    if (!client_setting_.io_service_) {
+        roo::log_err("io_service not provided for TcpConnSyncPool.");
+        return false;
+    }
+
+    roo::log_info("TcpConnSyncPool for %s:%u, min_conns %u, max_conns %u, wait_ms %u.",
+                  client_setting_.serv_addr_.c_str(), client_setting_.serv_port_,
+                  client_setting_.pool_min_conns_, client_setting_.pool_max_conns_,
+                  client_setting_.pool_wait_ms_);
+
+    if (client_setting_.pool_min_conns_ > 0) {
+        std::lock_guard<std::mutex> lock(lock_);
+        warming_up_ = true;
+        client_setting_.io_service_->post(std::bind(&TcpConnSyncPool::warm_up, shared_from_this()));
+    }
+
+    return true;
+}
+
+// 非阻塞方式建立连接，最多等待timeout_ms，0表示由系统决定
+// boost::asio同步的connect在非阻塞的socket上仍然会一直等待，所以直接使用系统调用
+static void connect_with_timeout(boost::asio::ip::tcp::socket& socket,
+                                 const boost::asio::ip::tcp::endpoint& endpoint,
+                                 uint32_t timeout_ms, boost::system::error_code& ec) {
+
+    if (timeout_ms == 0) {
+        socket.connect(endpoint, ec);
+        return;
+    }
+
+    socket.open(endpoint.protocol(), ec);
+    if (ec) {
+        return;
+    }
+
+    socket.non_blocking(true, ec);
+    if (ec) {
+        return;
+    }
+
+    int fd = socket.native_handle();
+    if (::connect(fd, endpoint.data(), static_cast<socklen_t>(endpoint.size())) != 0) {
+
+        if (errno != EINPROGRESS) {
+            ec = boost::system::error_code(errno, boost::system::system_category());
+            return;
+        }
+
+        struct pollfd pfd {};
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+
+        int ret = ::poll(&pfd, 1, static_cast<int>(timeout_ms));
+        if (ret == 0) {
+            ec = boost::asio::error::timed_out;
+            return;
+        } else if (ret < 0) {
+            ec = boost::system::error_code(errno, boost::system::system_category());
+            return;
+        }
+
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0) {
+            error = errno;
+        }
+        if (error != 0) {
+            ec = boost::system::error_code(error, boost::system::system_category());
+            return;
+        }
+    }
+
+    // 同步连接上的读写需要阻塞模式
+    socket.non_blocking(false, ec);
+}
+
+std::shared_ptr<PooledConnSync> TcpConnSyncPool::create_conn() {
+
+    boost::system::error_code ec;
+    std::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr
+        = std::make_shared<boost::asio::ip::tcp::socket>(*client_setting_.io_service_);
+
+    connect_with_timeout(*socket_ptr,
+                         boost::asio::ip::tcp::endpoint(
+                             boost::asio::ip::address::from_string(client_setting_.serv_addr_), client_setting_.serv_port_),
+                         client_setting_.connect_timeout_ms_, ec);
+    if (ec) {
+        boost::system::error_code ignore_ec;
+        socket_ptr->close(ignore_ec);
+
+        std::chrono::milliseconds delay = backoff_->failed();
+        roo::log_err("Connect to %s:%u failed with {%d} %s, retry after %ld ms.",
+                     client_setting_.serv_addr_.c_str(), client_setting_.serv_port_,
+                     ec.value(), ec.message().c_str(), static_cast<long>(delay.count()));
+        return std::shared_ptr<PooledConnSync>();
+    }
+
+    backoff_->succeeded();
+
+    std::shared_ptr<TcpConnSync> conn
+        = std::make_shared<TcpConnSync>(socket_ptr, *client_setting_.io_service_, client_setting_);
+    ++create_count_;
+
+    return std::make_shared<PooledConnSync>(conn, call_timer_);
+}
+
+void TcpConnSyncPool::warm_up() {
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (closed_ || total_ >= client_setting_.pool_min_conns_) {
+        warming_up_ = false;
+        return;
+    }
+
+    std::chrono::milliseconds delay = backoff_->retry_after();
+    if (delay.count() > 0) {
+        schedule_warm_up(delay);
+        return;
+    }
+
+    ++total_;
+
+    uint64_t seq = ++warm_up_seq_;
+    warm_up_socket_ = std::make_shared<boost::asio::ip::tcp::socket>(*client_setting_.io_service_);
+    warm_up_socket_->async_connect(boost::asio::ip::tcp::endpoint(
+                                       boost::asio::ip::address::from_string(client_setting_.serv_addr_),
+                                       client_setting_.serv_port_),
+                                   std::bind(&TcpConnSyncPool::warm_up_handler, shared_from_this(),
+                                             seq, std::placeholders::_1));
+
+    if (client_setting_.connect_timeout_ms_ > 0) {
+        warm_up_timer_handle_ = call_timer_->add(std::chrono::milliseconds(client_setting_.connect_timeout_ms_),
+                                                 std::bind(&TcpConnSyncPool::warm_up_timeout, shared_from_this(),
+                                                           seq));
+        warm_up_timer_armed_ = true;
+    }
+}
+
+void TcpConnSyncPool::warm_up_timeout(uint64_t seq) {
+
+    std::lock_guard<std::mutex> lock(lock_);
+
+    if (seq != warm_up_seq_ || !warm_up_socket_) {
+        return;
+    }
+
+    // 关闭socket之后warm_up_handler以operation_aborted返回，在那里处理失败
+    warm_up_timer_armed_ = false;
+    roo::log_err("connect to %s:%u timeout with %u ms.",
+                 client_setting_.serv_addr_.c_str(), client_setting_.serv_port_,
+                 client_setting_.connect_timeout_ms_);
+
+    boost::system::error_code ignore_ec;
+    warm_up_socket_->close(ignore_ec);
+}
+
+void TcpConnSyncPool::warm_up_handler(uint64_t seq, const boost::system::error_code& ec) {
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        if (seq != warm_up_seq_ || !warm_up_socket_) {
+            return;
+        }
+
+        if (warm_up_timer_armed_) {
+            call_timer_->cancel(warm_up_timer_handle_);
+            warm_up_timer_armed_ = false;
+        }
+
+        std::shared_ptr<boost::asio::ip::tcp::socket> socket_ptr = warm_up_socket_;
+        warm_up_socket_.reset();
+
+        if (ec || closed_) {
+
+            boost::system::error_code ignore_ec;
+            socket_ptr->close(ignore_ec);
+
+            --total_;
+            conn_notify_.notify_one();
+
+            if (closed_) {
+                warming_up_ = false;
+                return;
+            }
+
+            // 服务端暂时不可用，退避结束之后再补齐
+            std::chrono::milliseconds delay = backoff_->failed();
+            roo::log_err("Connect to %s:%u failed with {%d} %s, retry after %ld ms.",
+                         client_setting_.serv_addr_.c_str(), client_setting_.serv_port_,
+                         ec.value(), ec.message().c_str(), static_cast<long>(delay.count()));
+            schedule_warm_up(backoff_->retry_after());
+            return;
+        }
+
+        backoff_->succeeded();
+
+        std::shared_ptr<TcpConnSync> conn
+            = std::make_shared<TcpConnSync>(socket_ptr, *client_setting_.io_service_, client_setting_);
+        ++create_count_;
+
+        idle_.push_back(std::make_shared<PooledConnSync>(conn, call_timer_));
+        conn_notify_.notify_one();
+    }
+
+    // 继续补齐下一个连接
+    warm_up();
+}
+
+void TcpConnSyncPool::schedule_warm_up(std::chrono::milliseconds delay) {
+
+    // warming_up_保持为true，期间不会重复发起补齐
+    std::shared_ptr<TcpConnSyncPool> self = shared_from_this();
+    call_timer_->add(delay, [self]() {
+        self->client_setting_.io_service_->post(std::bind(&TcpConnSyncPool::warm_up, self));
+    });
+}
+
+RpcClientStatus TcpConnSyncPool::acquire(std::shared_ptr<PooledConnSync>& conn) {
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(client_setting_.pool_wait_ms_);
+
+    {
+        std::unique_lock<std::mutex> lock(lock_);
+
+        while (true) {
+
+            if (closed_) {
+                return RpcClientStatus::NETWORK_BEFORE_ERROR;
+            }
+
+            // 最近归还的连接最可能还是活跃的
+            while (!idle_.empty()) {
+                conn = idle_.back();
+                idle_.pop_back();
+
+                if (conn->is_working()) {
+                    return RpcClientStatus::OK;
+                }
+
+                --total_;
+                conn.reset();
+            }
+
+            if (total_ < client_setting_.pool_max_conns_) {
+
+                // 退避期间不再尝试建立连接，直接失败
+                if (backoff_->is_down()) {
+                    return RpcClientStatus::NETWORK_CONNECT_ERROR;
+                }
+
+                ++total_;
+                break;
+            }
+
+            if (std::chrono::steady_clock::now() >= deadline) {
+                ++wait_timeout_count_;
+                roo::log_err("wait free connection timeout %u ms, max_conns %u, total wait timeout %lu.",
+                             client_setting_.pool_wait_ms_, client_setting_.pool_max_conns_,
+                             static_cast<unsigned long>(wait_timeout_count_.load()));
+                return RpcClientStatus::NETWORK_BEFORE_ERROR;
+            }
+
+            conn_notify_.wait_until(lock, deadline);
+        }
+    }
+
+    // 在锁外面建立连接，不阻塞其他调用者归还和借出
+    conn = create_conn();
+    if (!conn) {
+        std::lock_guard<std::mutex> lock(lock_);
+        --total_;
+        conn_notify_.notify_one();
+        return RpcClientStatus::NETWORK_CONNECT_ERROR;
+    }
+
+    return RpcClientStatus::OK;
+}
+
+void TcpConnSyncPool::release(std::shared_ptr<PooledConnSync> conn, bool reusable) {
+
+    bool need_warm_up = false;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        if (reusable && !closed_ && conn->is_working()) {
+            idle_.push_back(conn);
+        } else {
+            --total_;
+            conn->conn().shutdown_and_close_socket();
+
+            if (!closed_ && !warming_up_ && total_ < client_setting_.pool_min_conns_) {
+                warming_up_ = true;
+                need_warm_up = true;
+            }
+        }
+    }
+
+    conn_notify_.notify_one();
+
+    if (need_warm_up) {
+        client_setting_.io_service_->post(std::bind(&TcpConnSyncPool::warm_up, shared_from_this()));
+    }
+}
+
+void TcpConnSyncPool::shutdown() {
+
+    std::deque<std::shared_ptr<PooledConnSync>> idle;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        closed_ = true;
+        total_ -= idle_.size();
+        idle.swap(idle_);
+
+        // 正在补齐的连接可能一直等不到结果，直接中止
+        if (warm_up_socket_) {
+            boost::system::error_code ignore_ec;
+            warm_up_socket_->close(ignore_ec);
+        }
+    }
+
+    conn_notify_.notify_all();
+
+    // 客户端必须主动关闭socket，否则连接会一直保留到进程退出
+    for (auto iter = idle.begin(); iter != idle.end(); ++iter) {
+        (*iter)->conn().shutdown_and_close_socket();
+    }
+}
+
+} // end namespace tzrpc_client
@@ -0,0 +1,133 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __CLIENT_TCP_CONN_SYNC_POOL_H__
+#define __CLIENT_TCP_CONN_SYNC_POOL_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include <boost/asio.hpp>
+
+#include <Client/include/RpcClientStatus.h>
+#include <Client/include/RpcClient.h>
+#include <Client/CallTimer.h>
+#include <Client/ConnectBackoff.h>
+
+namespace tzrpc_client {
+
+class TcpConnSync;
+
+// 连接池中的一个同步连接，同一时刻只会借给一个调用者
+// 超时的时候关闭socket让阻塞的读写返回
+class PooledConnSync : public std::enable_shared_from_this<PooledConnSync> {
+
+    __noncopyable__(PooledConnSync)
+
+public:
+    PooledConnSync(std::shared_ptr<TcpConnSync> conn, std::shared_ptr<CallTimer> call_timer);
+    ~PooledConnSync() = default;
+
+    TcpConnSync& conn() {
+        return *conn_;
+    }
+
+    bool is_working() const;
+
+    void set_timeout(std::chrono::microseconds timeout);
+    void cancel_timeout();
+
+    bool was_timeout() const {
+        return was_timeout_;
+    }
+
+    // 对冲调用的副本先得到答复，关闭连接让主请求阻塞的读写返回
+    void abort();
+
+private:
+    void timeout_handler(uint64_t seq);
+
+    std::shared_ptr<TcpConnSync> conn_;
+    std::shared_ptr<CallTimer> call_timer_;
+
+    // 保证取消之后已经到期的超时处理不会再关闭连接
+    std::mutex timer_lock_;
+    CallTimer::handle_t timer_handle_;
+    bool timer_armed_;
+    uint64_t timer_seq_;
+    std::atomic<bool> was_timeout_;
+};
+
+
+// 同步调用的连接池
+// 调用者借出一个空闲的连接独占使用，完成之后归还，这样多个线程共享一个
+// RpcClient的时候不再串行，并发度最高为pool_max_conns_。连接都被占用的
+// 时候调用者最多等待pool_wait_ms_，创建时候在后台预先建立pool_min_conns_
+// 个连接，连接损坏被丢弃之后也会在后台补齐
+// 建立连接失败之后实例进入退避，期间需要新连接的调用直接失败，后台补齐
+// 连接也推迟到退避结束之后
+class TcpConnSyncPool : public std::enable_shared_from_this<TcpConnSyncPool> {
+
+    __noncopyable__(TcpConnSyncPool)
+
+public:
+    TcpConnSyncPool(const RpcClientSetting& client_setting, std::shared_ptr<CallTimer> call_timer,
+                    std::shared_ptr<ConnectBackoff> backoff);
+    ~TcpConnSyncPool();
+
+    bool init();
+
+    // 返回OK的时候conn为可用的连接，使用完成之后必须调用release归还
+    RpcClientStatus acquire(std::shared_ptr<PooledConnSync>& conn);
+
+    // reusable为false或者连接已经失效的时候关闭并丢弃这个连接
+    void release(std::shared_ptr<PooledConnSync> conn, bool reusable);
+
+    void shutdown();
+
+private:
+    std::shared_ptr<PooledConnSync> create_conn();
+
+    // 后台补齐在io_service的线程中执行，使用异步连接，不能阻塞其他的回调
+    void warm_up();
+    void warm_up_handler(uint64_t seq, const boost::system::error_code& ec);
+    void warm_up_timeout(uint64_t seq);
+
+    // 调用者持有lock_，退避结束之后再补齐连接
+    void schedule_warm_up(std::chrono::milliseconds delay);
+
+    // 连接引用这份配置，所以保存一份拷贝，不依赖RpcClientImpl的生命周期
+    RpcClientSetting client_setting_;
+    std::shared_ptr<CallTimer> call_timer_;
+    std::shared_ptr<ConnectBackoff> backoff_;
+
+    std::mutex lock_;
+    std::condition_variable conn_notify_;
+
+    std::deque<std::shared_ptr<PooledConnSync>> idle_;
+    size_t total_;              // 空闲、借出以及正在建立的连接总数
+    bool warming_up_;
+    bool closed_;
+
+    // 后台补齐正在建立的连接，同一时刻最多一个
+    std::shared_ptr<boost::asio::ip::tcp::socket> warm_up_socket_;
+    uint64_t warm_up_seq_;
+    CallTimer::handle_t warm_up_timer_handle_;
+    bool warm_up_timer_armed_;
+
+    std::atomic<uint64_t> create_count_;
+    std::atomic<uint64_t> wait_timeout_count_;
+};
+
+} // end namespace tzrpc_client
+
+#endif // __CLIENT_TCP_CONN_SYNC_POOL_H__
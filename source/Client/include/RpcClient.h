@@ -10,8 +10,13 @@
 
 #include <libconfig/libconfig.h++>
 
+#include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "RpcClientStatus.h"
 
@@ -39,6 +44,33 @@ namespace tzrpc_client {
 typedef std::function<int(const RpcClientStatus status, uint16_t service_id, uint16_t opcode, const std::string& rsp)> rpc_handler_t;
 extern rpc_handler_t dummy_handler_;
 
+// 单次异步调用的回调函数，每个请求在网络报文头中携带关联ID，答复可以乱序到达，
+// 客户端根据关联ID找到对应请求的回调，请求超时只会让这个请求失败，不会关闭连接
+typedef std::function<void(const RpcClientStatus status, const std::string& rsp)> rpc_callback_t;
+
+struct RpcCallResult {
+    RpcClientStatus status_;
+    std::string     respload_;
+
+    RpcCallResult(RpcClientStatus status, const std::string& respload) :
+        status_(status),
+        respload_(respload) {
+    }
+};
+
+// 批量调用中的一个请求
+struct RpcBatchRequest {
+    uint16_t    service_id_;
+    uint16_t    opcode_;
+    std::string payload_;
+
+    RpcBatchRequest(uint16_t service_id, uint16_t opcode, const std::string& payload) :
+        service_id_(service_id),
+        opcode_(opcode),
+        payload_(payload) {
+    }
+};
+
 struct RpcClientSetting {
 
     std::string serv_addr_;
@@ -49,6 +81,48 @@ struct RpcClientSetting {
 
     uint32_t    log_level_;
 
+    // 请求的优先级，0表示由服务端决定，1高 2普通 3低
+    // 健康检查这类控制面的请求可以设置为高优先级，避免被业务请求阻塞
+    uint32_t    priority_;
+
+    // 同步调用的连接池，多个线程共享一个RpcClient的时候各自使用独立的连接
+    // pool_min_conns_是后台预先建立的连接数目，pool_max_conns_是连接数上限，
+    // 连接都被占用的时候调用者最多等待pool_wait_ms_毫秒
+    uint32_t    pool_min_conns_;
+    uint32_t    pool_max_conns_;
+    uint32_t    pool_wait_ms_;
+
+    // 多个服务端实例，格式为"ip:port"，为空的时候只使用serv_addr_和serv_port_
+    // balance_policy_可以是round_robin、least_outstanding或者p2c
+    std::vector<std::string> endpoints_;
+    std::string balance_policy_;
+
+    // 建立连接的超时，0表示由系统决定
+    // 连接失败之后在后台重连，重连间隔从reconnect_initial_ms_开始翻倍到
+    // reconnect_max_ms_，并且加入随机抖动，退避期间发往这个实例的请求直接失败。
+    // reconnect_queue_size_大于0的时候，异步调用在重连期间最多排队这么多请求，
+    // 连接恢复之后发送，排队的请求仍然受各自的超时限制
+    uint32_t    connect_timeout_ms_;
+    uint32_t    reconnect_initial_ms_;
+    uint32_t    reconnect_max_ms_;
+    uint32_t    reconnect_queue_size_;
+
+    // 异步调用的自动批量发送，batch_window_us_微秒之内发起的异步调用合并成
+    // 一次写操作，积累到batch_max_calls_个请求的时候立即发送，0表示不合并
+    uint32_t    batch_window_us_;
+    uint32_t    batch_max_calls_;
+
+    // 幂等请求的对冲，只对hedge_opcodes_中的同步调用生效
+    // 请求超过最近延迟的hedge_percentile_分位数(不少于hedge_min_delay_us_)还没有
+    // 答复的时候，向另一个实例发送一个副本，使用先到达的答复，副本的数目不超过
+    // 请求数的hedge_budget_percent_%，hedge_percentile_为0表示不对冲
+    // 副本在hedge_threads_个固定的线程中执行，线程都忙的时候副本排队
+    uint32_t    hedge_percentile_;
+    uint32_t    hedge_min_delay_us_;
+    uint32_t    hedge_budget_percent_;
+    uint32_t    hedge_threads_;
+    std::vector<std::pair<uint16_t, uint16_t>> hedge_opcodes_;     // service_id, opcode
+
     // advanced attr
     rpc_handler_t handler_;
     std::shared_ptr<boost::asio::io_service> io_service_;
@@ -59,6 +133,23 @@ struct RpcClientSetting {
         send_max_msg_size_(0),
         recv_max_msg_size_(0),
         log_level_(7),
+        priority_(0),
+        pool_min_conns_(0),
+        pool_max_conns_(1),
+        pool_wait_ms_(1000),
+        endpoints_(),
+        balance_policy_("round_robin"),
+        connect_timeout_ms_(1000),
+        reconnect_initial_ms_(100),
+        reconnect_max_ms_(10000),
+        reconnect_queue_size_(0),
+        batch_window_us_(0),
+        batch_max_calls_(64),
+        hedge_percentile_(0),
+        hedge_min_delay_us_(1000),
+        hedge_budget_percent_(5),
+        hedge_threads_(2),
+        hedge_opcodes_(),
         handler_(),
         io_service_() {
     }
@@ -88,14 +179,58 @@ public:
     RpcClient(const RpcClientSetting& setting);
 
     // 带客户端超时支持
+    // 超时可以是秒数，也可以是std::chrono::milliseconds、std::chrono::microseconds
+    // 等更精细的时间，0表示没有超时
     RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
                              const std::string& payload, std::string& respload,
                              uint32_t timeout_sec = 0);
+    RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
+                             const std::string& payload, std::string& respload,
+                             std::chrono::microseconds timeout);
 
     // 异步调用的接口，底层调用完成后会自动调用handler来处理
     RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
                              const std::string& payload,
                              uint32_t timeout_sec = 0);
+    RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
+                             const std::string& payload,
+                             std::chrono::microseconds timeout);
+
+    // 异步调用的接口，请求完成、失败或者超时的时候调用callback，多个请求可以
+    // 同时在一个连接上等待答复。返回值不是OK的时候请求没有发出，callback不会被调用
+    // 开启自动批量发送的时候请求先进入队列，发送失败通过callback通知
+    // 注意：callback在io_service的线程中执行，不要在其中做耗时的操作
+    RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
+                             const std::string& payload,
+                             const rpc_callback_t& callback,
+                             uint32_t timeout_sec = 0);
+    RpcClientStatus call_RPC(uint16_t service_id, uint16_t opcode,
+                             const std::string& payload,
+                             const rpc_callback_t& callback,
+                             std::chrono::microseconds timeout);
+
+    // 返回future的异步调用，请求没有发出的时候future立即就绪
+    std::future<RpcCallResult> call_RPC_future(uint16_t service_id, uint16_t opcode,
+                                               const std::string& payload,
+                                               uint32_t timeout_sec = 0);
+    std::future<RpcCallResult> call_RPC_future(uint16_t service_id, uint16_t opcode,
+                                               const std::string& payload,
+                                               std::chrono::microseconds timeout);
+
+    // 批量调用，所有请求在同一个连接上一次写出，按照关联ID收集答复，results和
+    // requests一一对应，每个请求的超时单独计算。返回值不是OK的时候请求没有发出，
+    // 所有结果都是这个错误；返回OK的时候每个请求的状态在各自的结果中
+    // 注意：会阻塞等待所有请求完成，不要在异步调用的callback中使用
+    RpcClientStatus call_RPC_batch(const std::vector<RpcBatchRequest>& requests,
+                                   std::vector<RpcCallResult>& results,
+                                   uint32_t timeout_sec = 0);
+    RpcClientStatus call_RPC_batch(const std::vector<RpcBatchRequest>& requests,
+                                   std::vector<RpcCallResult>& results,
+                                   std::chrono::microseconds timeout);
+
+    // 运行时更新服务端实例列表，保留的实例继续使用原来的连接和统计信息，
+    // 移除的实例在正在进行的请求完成之后关闭连接
+    bool update_endpoints(const std::vector<std::string>& endpoints);
 
 private:
 
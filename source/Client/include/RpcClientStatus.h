@@ -35,6 +35,9 @@ enum class RpcClientStatus : uint8_t {
     INVALID_REQUEST = 4,
 
     SYSTEM_ERROR    = 5,
+
+    OVERLOADED      = 6,      // 服务端过载，请求没有被处理，可以退避之后重试
+    DEADLINE_EXCEEDED = 7,    // 请求在服务端排队超过了超时时间，没有被处理
     // 以上部分是和服务端相互兼容的，客户端和服务端必须同时改动
 
 
@@ -26,13 +26,13 @@ struct Header {
     uint16_t version;       // "1"
     uint32_t length;        // playload length ( NOT include header)
 
-    uint32_t rev1;          // 当前保留空间，后续升级使用
-    uint32_t rev2;
+    uint32_t call_id;       // 请求的关联ID，服务端在答复中原样带回，0表示不使用
+    uint32_t rev2;          // 当前保留空间，后续升级使用
 
     std::string dump() const {
         char msg[64]{};
-        snprintf(msg, sizeof(msg), "mgc:%0x, ver:%0x, len:%u",
-                 magic, version, length);
+        snprintf(msg, sizeof(msg), "mgc:%0x, ver:%0x, len:%u, cid:%u",
+                 magic, version, length, call_id);
         return msg;
     }
 
@@ -41,12 +41,14 @@ struct Header {
         magic   = be16toh(magic);
         version = be16toh(version);
         length  = be32toh(length);
+        call_id = be32toh(call_id);
     }
 
     void to_net_endian() {
         magic   = htobe16(magic);
         version = htobe16(version);
         length  = htobe32(length);
+        call_id = htobe32(call_id);
     }
 
 } __attribute__((__packed__));
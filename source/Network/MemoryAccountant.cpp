@@ -0,0 +1,176 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <vector>
+#include <sstream>
+
+#include <other/Log.h>
+
+#include <Network/MemoryAccountant.h>
+
+namespace tzrpc {
+
+static const char* memory_type_name(size_t idx) {
+    static const char* names[] = { "fixed", "recv", "queued", "send" };
+    return idx < sizeof(names) / sizeof(names[0]) ? names[idx] : "unknown";
+}
+
+ConnMemoryStat::ConnMemoryStat(const std::string& peer) :
+    peer_(peer) {
+
+    for (size_t i = 0; i < static_cast<size_t>(MemoryType::kTypeCount); ++i)
+        bytes_[i] = 0;
+
+    MemoryAccountant::instance().attach(this);
+}
+
+ConnMemoryStat::~ConnMemoryStat() {
+    MemoryAccountant::instance().detach(this);
+}
+
+
+MemoryAccountant& MemoryAccountant::instance() {
+    static MemoryAccountant accountant;
+    return accountant;
+}
+
+void MemoryAccountant::attach(ConnMemoryStat* stat) {
+    std::lock_guard<std::mutex> lock(lock_);
+    conns_.insert(stat);
+}
+
+void MemoryAccountant::detach(ConnMemoryStat* stat) {
+
+    // 和dump在同一个锁下清理，状态输出不会看到总量已经扣除但是连接还在的中间状态
+    std::lock_guard<std::mutex> lock(lock_);
+
+    // 正常情况下所有的记账都已经归还了，这里做兜底处理
+    for (size_t i = 0; i < static_cast<size_t>(MemoryType::kTypeCount); ++i) {
+        int64_t remain = stat->bytes_[i].exchange(0);
+        if (remain != 0) {
+            type_total_[i] -= remain;
+            total_ -= remain;
+        }
+    }
+
+    conns_.erase(stat);
+}
+
+void MemoryAccountant::update_peak(int64_t current) {
+    int64_t peak = peak_.load(std::memory_order_relaxed);
+    while (current > peak &&
+           !peak_.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        // retry
+    }
+}
+
+bool MemoryAccountant::try_charge(ConnMemoryStat& stat, enum MemoryType type, int64_t bytes) {
+
+    if (bytes <= 0)
+        return true;
+
+    int64_t budget = budget_.load(std::memory_order_relaxed);
+    int64_t current = total_.fetch_add(bytes) + bytes;
+    if (budget != 0 && current > budget) {
+        total_ -= bytes;
+        ++rejected_;
+        roo::log_err("memory budget %ld exceeded, current %ld, peer %s request %ld bytes.",
+                     static_cast<long>(budget), static_cast<long>(current - bytes),
+                     stat.peer().c_str(), static_cast<long>(bytes));
+        return false;
+    }
+
+    stat.bytes_[static_cast<uint8_t>(type)] += bytes;
+    type_total_[static_cast<uint8_t>(type)] += bytes;
+    update_peak(current);
+    return true;
+}
+
+void MemoryAccountant::charge(ConnMemoryStat& stat, enum MemoryType type, int64_t bytes) {
+
+    if (bytes <= 0)
+        return;
+
+    stat.bytes_[static_cast<uint8_t>(type)] += bytes;
+    type_total_[static_cast<uint8_t>(type)] += bytes;
+    update_peak(total_.fetch_add(bytes) + bytes);
+}
+
+void MemoryAccountant::release(ConnMemoryStat& stat, enum MemoryType type, int64_t bytes) {
+
+    if (bytes <= 0)
+        return;
+
+    stat.bytes_[static_cast<uint8_t>(type)] -= bytes;
+    type_total_[static_cast<uint8_t>(type)] -= bytes;
+    total_ -= bytes;
+}
+
+void MemoryAccountant::transfer(ConnMemoryStat& stat, enum MemoryType from, enum MemoryType to, int64_t bytes) {
+
+    if (bytes <= 0 || from == to)
+        return;
+
+    stat.bytes_[static_cast<uint8_t>(from)] -= bytes;
+    type_total_[static_cast<uint8_t>(from)] -= bytes;
+    stat.bytes_[static_cast<uint8_t>(to)] += bytes;
+    type_total_[static_cast<uint8_t>(to)] += bytes;
+}
+
+void MemoryAccountant::release_all(ConnMemoryStat& stat, enum MemoryType type) {
+
+    int64_t remain = stat.bytes_[static_cast<uint8_t>(type)].exchange(0);
+    if (remain != 0) {
+        type_total_[static_cast<uint8_t>(type)] -= remain;
+        total_ -= remain;
+    }
+}
+
+std::string MemoryAccountant::dump(size_t top_n) {
+
+    std::stringstream ss;
+
+    ss << "\t" << "memory_budget: " << budget_.load() << std::endl;
+    ss << "\t" << "memory_total: " << total_.load() << std::endl;
+    ss << "\t" << "memory_peak: " << peak_.load() << std::endl;
+    ss << "\t" << "memory_rejected: " << rejected_.load() << std::endl;
+    for (size_t i = 0; i < static_cast<size_t>(MemoryType::kTypeCount); ++i) {
+        ss << "\t" << "memory_" << memory_type_name(i) << ": " << type_total_[i].load() << std::endl;
+    }
+
+    std::vector<std::pair<int64_t, std::string>> consumers;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        ss << "\t" << "memory_connections: " << conns_.size() << std::endl;
+
+        consumers.reserve(conns_.size());
+        for (auto iter = conns_.begin(); iter != conns_.end(); ++iter) {
+            std::stringstream detail;
+            detail << (*iter)->peer();
+            for (size_t i = 0; i < static_cast<size_t>(MemoryType::kTypeCount); ++i) {
+                detail << (i == 0 ? " (" : ", ") << memory_type_name(i) << ":" << (*iter)->bytes_[i].load();
+            }
+            detail << ")";
+            consumers.push_back(std::make_pair((*iter)->total(), detail.str()));
+        }
+    }
+
+    size_t count = std::min(top_n, consumers.size());
+    std::partial_sort(consumers.begin(), consumers.begin() + count, consumers.end(),
+                      [](const std::pair<int64_t, std::string>& a, const std::pair<int64_t, std::string>& b) {
+                          return a.first > b.first;
+                      });
+
+    ss << "\t" << "memory_top_consumers: " << std::endl;
+    for (size_t i = 0; i < count; ++i) {
+        ss << "\t\t" << consumers[i].first << " " << consumers[i].second << std::endl;
+    }
+
+    return ss.str();
+}
+
+} // end namespace tzrpc
@@ -0,0 +1,134 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __NETWORK_MEMORY_ACCOUNTANT_H__
+#define __NETWORK_MEMORY_ACCOUNTANT_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace tzrpc {
+
+// 内存记账的分类
+enum class MemoryType : uint8_t {
+    kFixed  = 0,    // 连接固定开销，主要是两个IOBound
+    kRecv   = 1,    // 已经根据Header预留，但是还没有接收完成的消息体
+    kQueued = 2,    // 已经接收完成，在RpcInstance中排队或者处理的请求
+    kSend   = 3,    // 等待发送的响应数据
+    kTypeCount,
+};
+
+// 每个连接的内存使用统计，由TcpConnAsync持有，RpcInstance也会持有
+// 一个引用，这样即使连接提前释放了，排队请求的内存也能正确归还
+class ConnMemoryStat {
+
+    __noncopyable__(ConnMemoryStat)
+
+public:
+    explicit ConnMemoryStat(const std::string& peer);
+    ~ConnMemoryStat();
+
+    int64_t get(enum MemoryType type) const {
+        return bytes_[static_cast<uint8_t>(type)].load(std::memory_order_relaxed);
+    }
+
+    int64_t total() const {
+        int64_t sum = 0;
+        for (size_t i = 0; i < static_cast<size_t>(MemoryType::kTypeCount); ++i)
+            sum += bytes_[i].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    const std::string& peer() const {
+        return peer_;
+    }
+
+private:
+    friend class MemoryAccountant;
+
+    const std::string peer_;
+    std::atomic<int64_t> bytes_[static_cast<size_t>(MemoryType::kTypeCount)];
+};
+
+
+// 进程级别的内存记账，对接收缓存、排队请求和发送缓存进行统计，
+// 当配置了预算之后，在解析到Header的时候就进行预留，超过预算的请求
+// 不再接收消息体，直接拒绝
+class MemoryAccountant {
+
+    __noncopyable__(MemoryAccountant)
+
+public:
+    static MemoryAccountant& instance();
+
+    // 预留内存，如果超过预算返回false，并且不会计入
+    bool try_charge(ConnMemoryStat& stat, enum MemoryType type, int64_t bytes);
+
+    // 无条件计入，比如响应数据已经生成了，不能够再拒绝
+    void charge(ConnMemoryStat& stat, enum MemoryType type, int64_t bytes);
+    void release(ConnMemoryStat& stat, enum MemoryType type, int64_t bytes);
+
+    // 在连接的不同分类之间转移，总量不变
+    void transfer(ConnMemoryStat& stat, enum MemoryType from, enum MemoryType to, int64_t bytes);
+
+    // 释放某个分类下的全部记账，连接关闭的时候使用
+    void release_all(ConnMemoryStat& stat, enum MemoryType type);
+
+    // 0表示不进行限制
+    void set_budget(int64_t budget) {
+        budget_.store(budget);
+    }
+
+    int64_t budget() const {
+        return budget_.load();
+    }
+
+    int64_t total() const {
+        return total_.load();
+    }
+
+    std::string dump(size_t top_n);
+
+private:
+    friend class ConnMemoryStat;
+
+    MemoryAccountant() :
+        budget_(0),
+        total_(0),
+        peak_(0),
+        rejected_(0),
+        lock_(),
+        conns_() {
+        for (size_t i = 0; i < static_cast<size_t>(MemoryType::kTypeCount); ++i)
+            type_total_[i] = 0;
+    }
+
+    ~MemoryAccountant() = default;
+
+    void attach(ConnMemoryStat* stat);
+    void detach(ConnMemoryStat* stat);
+
+    void update_peak(int64_t current);
+
+    std::atomic<int64_t> budget_;
+    std::atomic<int64_t> total_;
+    std::atomic<int64_t> peak_;
+    std::atomic<int64_t> rejected_;
+    std::atomic<int64_t> type_total_[static_cast<size_t>(MemoryType::kTypeCount)];
+
+    // 只有在连接建立、释放和状态输出的时候才会使用
+    std::mutex lock_;
+    std::set<ConnMemoryStat*> conns_;
+};
+
+} // end namespace tzrpc
+
+#endif // __NETWORK_MEMORY_ACCOUNTANT_H__
@@ -46,6 +46,8 @@ private:
     int32_t     send_max_msg_size_;         // 如果为0，则不限制
     int32_t     recv_max_msg_size_;         // 如果为0，则不限制
 
+    int32_t     memory_budget_;             // 进程内存预算(MB)，如果为0，则不限制
+
     std::string bind_addr_;
     int32_t     bind_port_;
 
@@ -113,6 +115,7 @@ private:
         ops_cancel_time_out_(0),
         send_max_msg_size_(0),
         recv_max_msg_size_(0),
+        memory_budget_(0),
         bind_addr_(),
         bind_port_(0),
         lock_(),
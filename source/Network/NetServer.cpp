@@ -7,6 +7,7 @@
 
 #include <Network/NetServer.h>
 #include <Network/TcpConnAsync.h>
+#include <Network/MemoryAccountant.h>
 
 #include <scaffold/Setting.h>
 #include <scaffold/Status.h>
@@ -103,6 +104,12 @@ bool NetConf::load_conf(const libconfig::Config& conf) {
         return false;
     }
 
+    conf.lookupValue("rpc.network.memory_budget", memory_budget_);
+    if (memory_budget_ < 0) {
+        roo::log_err("invalid rpc.network.memory_budget %d.", memory_budget_);
+        return false;
+    }
+
     roo::log_info("NetConf conf parse successfully!");
     return true;
 }
@@ -161,6 +168,9 @@ bool NetServer::init() {
                   conf_.service_enabled_ ? "true" : "false",
                   conf_.service_speed_);
 
+    MemoryAccountant::instance().set_budget(static_cast<int64_t>(conf_.memory_budget_) * 1024 * 1024);
+    roo::log_info("rpc.network memory_budget: %d MB.", conf_.memory_budget_);
+
     if (!io_service_threads_.init_threads(
             std::bind(&NetServer::io_service_run, this, std::placeholders::_1),
             conf_.io_thread_number_)) {
@@ -313,6 +323,10 @@ int NetServer::module_status(std::string& module, std::string& name, std::string
     ss << "\t" << "session_cancel_time_out: " << conf_.session_cancel_time_out_ << std::endl;
     ss << "\t" << "ops_cancel_time_out: " << conf_.ops_cancel_time_out_ << std::endl;
 
+    ss << "\t" << std::endl;
+
+    ss << MemoryAccountant::instance().dump(5);
+
     val = ss.str();
     return 0;
 }
@@ -387,6 +401,13 @@ int NetServer::module_runtime(const libconfig::Config& cfg) {
         roo::log_warning("Service Concurrency limit %d.",  conf_.service_concurrency_);
     }
 
+    if (conf_.memory_budget_ != conf.memory_budget_) {
+        roo::log_warning("update memory_budget from %d MB to %d MB.",
+                         conf_.memory_budget_, conf.memory_budget_);
+        conf_.memory_budget_ = conf.memory_budget_;
+        MemoryAccountant::instance().set_budget(static_cast<int64_t>(conf_.memory_budget_) * 1024 * 1024);
+    }
+
     return 0;
 }
 
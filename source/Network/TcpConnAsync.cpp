@@ -32,16 +32,32 @@ TcpConnAsync::TcpConnAsync(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
     server_(server),
     strand_(std::make_shared<boost::asio::io_service::strand>(server.io_service_)),
     bound_mutex_(),
-    send_status_(SendStatus::kDone) {
+    send_status_(SendStatus::kDone),
+    memory_stat_(),
+    remote_ip_key_(0) {
 
     set_tcp_nodelay(true);
     set_tcp_nonblocking(true);
 
+    boost::system::error_code ignore_ec;
+    auto remote = socket->remote_endpoint(ignore_ec);
+    std::string remote_ip = remote.address().to_string(ignore_ec);
+    std::string peer = remote_ip + ":" + std::to_string(static_cast<long long>(remote.port()));
+    remote_ip_key_ = std::hash<std::string>()(remote_ip);
+
+    memory_stat_ = std::make_shared<ConnMemoryStat>(peer);
+    MemoryAccountant::instance().charge(*memory_stat_, MemoryType::kFixed, 2 * sizeof(IOBound));
+
     ++current_concurrency_;
 }
 
 TcpConnAsync::~TcpConnAsync() {
 
+    // 排队中的请求由RpcInstance自己归还
+    MemoryAccountant::instance().release_all(*memory_stat_, MemoryType::kFixed);
+    MemoryAccountant::instance().release_all(*memory_stat_, MemoryType::kRecv);
+    MemoryAccountant::instance().release_all(*memory_stat_, MemoryType::kSend);
+
     --current_concurrency_;
     roo::log_info("TcpConnAsync SOCKET RELEASED!!!");
 }
@@ -90,6 +106,13 @@ int TcpConnAsync::parse_header() {
         return -1;
     }
 
+    // 在接收消息体之前按照Header声明的长度进行预留，超过预算就不再接收了
+    if (!MemoryAccountant::instance().try_charge(*memory_stat_, MemoryType::kRecv, recv_bound_.header_.length)) {
+        roo::log_err("Memory budget exhausted, reject message with content length %d.",
+                     static_cast<int>(recv_bound_.header_.length));
+        return -1;
+    }
+
     return 0;
 }
 
@@ -225,7 +248,9 @@ void TcpConnAsync::do_read_msg() {
             // 转发到RPC请求
             roo::log_info("read_message: %s", msg.dump().c_str());
             roo::log_info("read message finished, dispatch for RPC process.");
-            auto instance = std::make_shared<RpcInstance>(msg.payload_, shared_from_this(), msg.payload_.size());
+            MemoryAccountant::instance().transfer(*memory_stat_, MemoryType::kRecv, MemoryType::kQueued, msg.payload_.size());
+            auto instance = std::make_shared<RpcInstance>(msg.payload_, shared_from_this(), msg.payload_.size(),
+                                                          static_cast<uint32_t>(msg.header_.call_id));
             Dispatcher::instance().handle_RPC(instance);
 
             do_read(); // read again for future
@@ -266,7 +291,9 @@ void TcpConnAsync::read_msg_handler(const boost::system::error_code& ec, size_t
         // 转发到RPC请求
         roo::log_info("read_message: %s", msg.dump().c_str());
         roo::log_info("read message finished, dispatch for RPC process.");
-        auto instance = std::make_shared<RpcInstance>(msg.payload_, shared_from_this(), msg.payload_.size());
+        MemoryAccountant::instance().transfer(*memory_stat_, MemoryType::kRecv, MemoryType::kQueued, msg.payload_.size());
+        auto instance = std::make_shared<RpcInstance>(msg.payload_, shared_from_this(), msg.payload_.size(),
+                                                      static_cast<uint32_t>(msg.header_.call_id));
         Dispatcher::instance().handle_RPC(instance);
 
         do_read();
@@ -295,6 +322,7 @@ int TcpConnAsync::async_send_message(const Message& msg) {
     {
         std::lock_guard<std::mutex> lock(bound_mutex_);
         send_bound_.buffer_.append(msg);
+        MemoryAccountant::instance().charge(*memory_stat_, MemoryType::kSend, sizeof(Header) + msg.payload_.size());
     }
 
     do_write();
@@ -337,6 +365,7 @@ bool TcpConnAsync::do_write() {
                                      (uint32_t)(kFixedIoBufferSize));
 
         send_bound_.buffer_.consume(send_bound_.io_block_, to_write);
+        MemoryAccountant::instance().release(*memory_stat_, MemoryType::kSend, to_write);
         send_status_ = SendStatus::kSend;
 
         set_ops_cancel_timeout();
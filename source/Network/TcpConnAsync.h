@@ -17,6 +17,7 @@
 using boost::asio::steady_timer;
 
 #include <Network/NetConn.h>
+#include <Network/MemoryAccountant.h>
 #include <other/Log.h>
 
 namespace tzrpc {
@@ -49,6 +50,15 @@ public:
 
     int async_send_message(const Message& msg);
 
+    std::shared_ptr<ConnMemoryStat> memory_stat() const {
+        return memory_stat_;
+    }
+
+    // 客户端IP的散列值，用于按照客户端公平调度
+    uint64_t remote_ip_key() const {
+        return remote_ip_key_;
+    }
+
 private:
 
     virtual bool do_read()override;
@@ -116,6 +126,11 @@ private:
     // 因为响应是再线程池中处理的，多个线程池可能会并发的向同一个客户端发送响应数据
     SendStatus send_status_;
     IOBound send_bound_;
+
+    // 该连接的内存记账
+    std::shared_ptr<ConnMemoryStat> memory_stat_;
+
+    uint64_t remote_ip_key_;
 };
 
 
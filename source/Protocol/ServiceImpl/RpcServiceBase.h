@@ -2,18 +2,28 @@
 #define __PROTOCOL_RPC_SERVICE_BASE_H__
 
 #include <string>
+#include <vector>
+#include <functional>
 
 #include <scaffold/Setting.h>
+#include <message/ProtoBuf.h>
 #include <other/Log.h>
 
+#include <RPC/Service.h>
+#include <RPC/RpcInstance.h>
+
 namespace tzrpc {
 
+// 按照opcode分发的处理函数，框架不对请求体做任何处理
+typedef std::function<void(std::shared_ptr<RpcInstance>&)> opcode_handler_t;
+
 // 继承一些实现函数，避免多个服务实例中重复执行
 class RpcServiceBase {
 
 protected:
     explicit RpcServiceBase(const std::string& instance_name) :
-        instance_name_(instance_name) {
+        instance_name_(instance_name),
+        handlers_() {
     }
 
     ~RpcServiceBase() { }
@@ -29,6 +39,23 @@ protected:
         setting.lookupValue("exec_thread_pool_size_hard", conf.exec_thread_number_hard_);
         setting.lookupValue("exec_thread_pool_step_size", conf.exec_thread_step_size_);
 
+        std::string policy = "reject_new";
+        conf.exec_queue_type_ = "mutex";
+        conf.exec_queue_capacity_ = 0;
+        conf.exec_queue_lifo_depth_ = -1;
+        conf.exec_queue_fair_key_ = "connection";
+        conf.exec_queue_source_cap_ = 0;
+        conf.exec_batch_size_ = 1;
+        conf.exec_weight_ = 1;
+        setting.lookupValue("exec_queue_type",      conf.exec_queue_type_);
+        setting.lookupValue("exec_queue_capacity",  conf.exec_queue_capacity_);
+        setting.lookupValue("exec_queue_policy",    policy);
+        setting.lookupValue("exec_queue_lifo_depth", conf.exec_queue_lifo_depth_);
+        setting.lookupValue("exec_queue_fair_key",  conf.exec_queue_fair_key_);
+        setting.lookupValue("exec_queue_source_cap", conf.exec_queue_source_cap_);
+        setting.lookupValue("exec_batch_size",      conf.exec_batch_size_);
+        setting.lookupValue("exec_weight",          conf.exec_weight_);
+
         // 检查ExecutorConf参数合法性
         if (conf.exec_thread_number_hard_ < conf.exec_thread_number_) {
             conf.exec_thread_number_hard_ = conf.exec_thread_number_;
@@ -49,8 +76,301 @@ protected:
             return -1;
         }
 
+        if (!parse_overload_policy(policy, conf.exec_queue_policy_)) {
+            roo::log_err("Detected invalid exec_queue_policy setting: %s.", policy.c_str());
+            return -1;
+        }
+
+        // mpmc必须是有界的，而且只能从头部出队，不支持LIFO
+        if ((conf.exec_queue_type_ != "mutex" && conf.exec_queue_type_ != "mpmc" &&
+             conf.exec_queue_type_ != "fair") ||
+            conf.exec_queue_capacity_ < 0 ||
+            (conf.exec_queue_type_ == "mpmc" &&
+             (conf.exec_queue_capacity_ == 0 || conf.exec_queue_policy_ == OverloadPolicy::kLIFO))) {
+            roo::log_err("Detected invalid exec_queue setting: type %s, capacity %d, policy %s.",
+                         conf.exec_queue_type_.c_str(), conf.exec_queue_capacity_, policy.c_str());
+            return -1;
+        }
+
+        // fair按照来源轮转出队，同样不支持LIFO
+        if (conf.exec_queue_type_ == "fair" &&
+            ((conf.exec_queue_fair_key_ != "connection" && conf.exec_queue_fair_key_ != "ip") ||
+             conf.exec_queue_source_cap_ < 0 || conf.exec_queue_policy_ == OverloadPolicy::kLIFO)) {
+            roo::log_err("Detected invalid fair exec_queue setting: key %s, source_cap %d, policy %s.",
+                         conf.exec_queue_fair_key_.c_str(), conf.exec_queue_source_cap_, policy.c_str());
+            return -1;
+        }
+
+        if (conf.exec_batch_size_ <= 0 || conf.exec_batch_size_ > 128) {
+            roo::log_err("Detected invalid exec_batch_size setting: %d.", conf.exec_batch_size_);
+            return -1;
+        }
+
+        if (conf.exec_weight_ <= 0 || conf.exec_weight_ > 100) {
+            roo::log_err("Detected invalid exec_weight setting: %d.", conf.exec_weight_);
+            return -1;
+        }
+
+        if (handle_rpc_autoscale_conf(setting, conf) != 0 ||
+            handle_rpc_priority_conf(setting, conf) != 0 ||
+            handle_rpc_inline_conf(setting, conf) != 0 ||
+            handle_rpc_coalesce_conf(setting, conf) != 0 ||
+            handle_rpc_cache_conf(setting, conf) != 0 ||
+            handle_rpc_limiter_conf(setting, conf) != 0) {
+            return -1;
+        }
+
+        // LIFO默认在队列超过一半容量的时候开启，不限制容量的队列必须明确配置
+        // 深度，深度为0的时候完全后进先出，早先到达的请求可能一直得不到处理
+        if (conf.exec_queue_lifo_depth_ < 0) {
+            conf.exec_queue_lifo_depth_ = conf.exec_queue_capacity_ / 2;
+        }
+
+        if (conf.exec_queue_policy_ == OverloadPolicy::kLIFO && conf.exec_queue_lifo_depth_ <= 0) {
+            roo::log_err("Detected invalid lifo setting: capacity %d, lifo_depth %d.",
+                         conf.exec_queue_capacity_, conf.exec_queue_lifo_depth_);
+            return -1;
+        }
+
+        return 0;
+
+    }
+
+    int handle_rpc_autoscale_conf(const libconfig::Setting& setting, ExecutorConf& conf) {
+
+        ExecutorAutoscaleConf& autoscale = conf.exec_autoscale_conf_;
+
+        autoscale.scale_up_utilization_ = 0.8;
+        autoscale.scale_down_utilization_ = 0.3;
+        autoscale.scale_up_queue_wait_ms_ = 50;
+        autoscale.scale_up_max_step_ = 2;
+        autoscale.scale_up_cooldown_sec_ = 3;
+        autoscale.scale_down_cooldown_sec_ = 30;
+
+        if (!setting.exists("exec_autoscale")) {
+            return 0;
+        }
+
+        const libconfig::Setting& autoscale_setting = setting["exec_autoscale"];
+        autoscale_setting.lookupValue("scale_up_utilization",   autoscale.scale_up_utilization_);
+        autoscale_setting.lookupValue("scale_down_utilization", autoscale.scale_down_utilization_);
+        autoscale_setting.lookupValue("scale_up_queue_wait_ms", autoscale.scale_up_queue_wait_ms_);
+        autoscale_setting.lookupValue("scale_up_max_step",      autoscale.scale_up_max_step_);
+        autoscale_setting.lookupValue("scale_up_cooldown_sec",  autoscale.scale_up_cooldown_sec_);
+        autoscale_setting.lookupValue("scale_down_cooldown_sec", autoscale.scale_down_cooldown_sec_);
+
+        // 上下阈值之间需要留出足够的间隔，否则会来回伸缩
+        if (autoscale.scale_up_utilization_ <= 0 || autoscale.scale_up_utilization_ > 1.0 ||
+            autoscale.scale_down_utilization_ < 0 ||
+            autoscale.scale_down_utilization_ >= autoscale.scale_up_utilization_ ||
+            autoscale.scale_up_queue_wait_ms_ <= 0 || autoscale.scale_up_max_step_ <= 0 ||
+            autoscale.scale_up_cooldown_sec_ < 0 || autoscale.scale_down_cooldown_sec_ < 0) {
+            roo::log_err("Detected invalid exec_autoscale setting: utilization %f~%f, queue_wait %d ms, "
+                         "max_step %d, cooldown %d/%d sec.",
+                         autoscale.scale_down_utilization_, autoscale.scale_up_utilization_,
+                         autoscale.scale_up_queue_wait_ms_, autoscale.scale_up_max_step_,
+                         autoscale.scale_up_cooldown_sec_, autoscale.scale_down_cooldown_sec_);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    // exec_priority = {
+    //     high_opcodes = [ 1 ];
+    //     low_opcodes  = [ ];
+    //     schedule = "weighted";
+    //     weights  = [ 8, 4, 1 ];
+    // };
+    int handle_rpc_priority_conf(const libconfig::Setting& setting, ExecutorConf& conf) {
+
+        conf.exec_opcode_priority_.clear();
+        conf.exec_priority_strict_ = false;
+        conf.exec_priority_weights_[0] = 8;
+        conf.exec_priority_weights_[1] = 4;
+        conf.exec_priority_weights_[2] = 1;
+
+        if (!setting.exists("exec_priority")) {
+            return 0;
+        }
+
+        const libconfig::Setting& priority = setting["exec_priority"];
+
+        const char* opcode_keys[] = { "high_opcodes", "low_opcodes" };
+        const uint16_t opcode_priorities[] = { kRpcPriorityHigh, kRpcPriorityLow };
+        for (size_t i = 0; i < 2; ++i) {
+            if (!priority.exists(opcode_keys[i]))
+                continue;
+
+            // 同一个opcode只能属于一个优先级，配置错误的时候拒绝加载
+            const libconfig::Setting& opcodes = priority[opcode_keys[i]];
+            for (int j = 0; j < opcodes.getLength(); ++j) {
+                int opcode = opcodes[j];
+                if (opcode < 0 || opcode > 0xFFFF) {
+                    roo::log_err("Detected invalid exec_priority.%s opcode: %d.", opcode_keys[i], opcode);
+                    return -1;
+                }
+
+                auto iter = conf.exec_opcode_priority_.find(static_cast<uint16_t>(opcode));
+                if (iter != conf.exec_opcode_priority_.end()) {
+                    roo::log_err("Detected duplicate exec_priority opcode %d in %s, already configured with priority %u.",
+                                 opcode, opcode_keys[i], iter->second);
+                    return -1;
+                }
+
+                conf.exec_opcode_priority_[static_cast<uint16_t>(opcode)] = opcode_priorities[i];
+            }
+        }
+
+        std::string schedule = "weighted";
+        priority.lookupValue("schedule", schedule);
+        if (schedule != "weighted" && schedule != "strict") {
+            roo::log_err("Detected invalid exec_priority.schedule setting: %s.", schedule.c_str());
+            return -1;
+        }
+        conf.exec_priority_strict_ = (schedule == "strict");
+
+        if (priority.exists("weights")) {
+            const libconfig::Setting& weights = priority["weights"];
+            if (weights.getLength() != 3) {
+                roo::log_err("exec_priority.weights should have 3 items, but got %d.", weights.getLength());
+                return -1;
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                conf.exec_priority_weights_[i] = weights[i];
+                if (conf.exec_priority_weights_[i] <= 0) {
+                    roo::log_err("Detected invalid exec_priority.weights[%d]: %d.", i, conf.exec_priority_weights_[i]);
+                    return -1;
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    int handle_rpc_inline_conf(const libconfig::Setting& setting, ExecutorConf& conf) {
+
+        conf.exec_inline_opcodes_.clear();
+        conf.exec_inline_budget_us_ = 200;
+        conf.exec_inline_demote_overruns_ = 3;
+
+        if (!setting.exists("exec_inline")) {
+            return 0;
+        }
+
+        const libconfig::Setting& inline_setting = setting["exec_inline"];
+        inline_setting.lookupValue("budget_us",       conf.exec_inline_budget_us_);
+        inline_setting.lookupValue("demote_overruns", conf.exec_inline_demote_overruns_);
+
+        if (inline_setting.exists("opcodes")) {
+            const libconfig::Setting& opcodes = inline_setting["opcodes"];
+            for (int i = 0; i < opcodes.getLength(); ++i) {
+                int opcode = opcodes[i];
+                conf.exec_inline_opcodes_.push_back(static_cast<uint16_t>(opcode));
+            }
+        }
+
+        if (conf.exec_inline_budget_us_ <= 0 || conf.exec_inline_demote_overruns_ <= 0) {
+            roo::log_err("Detected invalid exec_inline setting: budget %d us, demote_overruns %d.",
+                         conf.exec_inline_budget_us_, conf.exec_inline_demote_overruns_);
+            return -1;
+        }
+
         return 0;
+    }
+
+    int handle_rpc_coalesce_conf(const libconfig::Setting& setting, ExecutorConf& conf) {
+
+        conf.exec_coalesce_opcodes_.clear();
+
+        if (!setting.exists("exec_coalesce")) {
+            return 0;
+        }
+
+        const libconfig::Setting& coalesce_setting = setting["exec_coalesce"];
+        if (coalesce_setting.exists("opcodes")) {
+            const libconfig::Setting& opcodes = coalesce_setting["opcodes"];
+            for (int i = 0; i < opcodes.getLength(); ++i) {
+                int opcode = opcodes[i];
+                conf.exec_coalesce_opcodes_.push_back(static_cast<uint16_t>(opcode));
+            }
+        }
 
+        return 0;
+    }
+
+    int handle_rpc_cache_conf(const libconfig::Setting& setting, ExecutorConf& conf) {
+
+        ResponseCacheConf& cache = conf.exec_cache_conf_;
+        int memory_mb = 64;
+        cache.shard_count_ = 16;
+        cache.opcode_ttl_ms_.clear();
+
+        if (setting.exists("exec_cache")) {
+
+            const libconfig::Setting& cache_setting = setting["exec_cache"];
+            cache_setting.lookupValue("memory_mb", memory_mb);
+            cache_setting.lookupValue("shards",    cache.shard_count_);
+
+            if (cache_setting.exists("opcodes")) {
+                const libconfig::Setting& opcodes = cache_setting["opcodes"];
+                for (int i = 0; i < opcodes.getLength(); ++i) {
+                    int opcode = 0;
+                    int ttl_ms = 0;
+                    if (!opcodes[i].lookupValue("opcode", opcode) ||
+                        !opcodes[i].lookupValue("ttl_ms", ttl_ms) || ttl_ms <= 0) {
+                        roo::log_err("Detected invalid exec_cache opcode setting at %d.", i);
+                        return -1;
+                    }
+                    cache.opcode_ttl_ms_[static_cast<uint16_t>(opcode)] = ttl_ms;
+                }
+            }
+        }
+
+        if (memory_mb <= 0 || cache.shard_count_ <= 0 || cache.shard_count_ > 1024) {
+            roo::log_err("Detected invalid exec_cache setting: memory %d MB, shards %d.",
+                         memory_mb, cache.shard_count_);
+            return -1;
+        }
+
+        cache.memory_limit_ = static_cast<int64_t>(memory_mb) * 1024 * 1024;
+        return 0;
+    }
+
+    int handle_rpc_limiter_conf(const libconfig::Setting& setting, ExecutorConf& conf) {
+
+        ConcurrencyLimiterConf& limiter = conf.exec_limiter_conf_;
+
+        conf.exec_limiter_enable_ = false;
+        limiter.min_limit_ = 4;
+        limiter.max_limit_ = 1000;
+        limiter.initial_limit_ = 20;
+        limiter.tolerance_ = 2.0;
+        limiter.smoothing_ = 0.2;
+
+        if (!setting.exists("exec_limiter")) {
+            return 0;
+        }
+
+        const libconfig::Setting& limiter_setting = setting["exec_limiter"];
+        limiter_setting.lookupValue("enable",        conf.exec_limiter_enable_);
+        limiter_setting.lookupValue("min_limit",     limiter.min_limit_);
+        limiter_setting.lookupValue("max_limit",     limiter.max_limit_);
+        limiter_setting.lookupValue("initial_limit", limiter.initial_limit_);
+        limiter_setting.lookupValue("tolerance",     limiter.tolerance_);
+        limiter_setting.lookupValue("smoothing",     limiter.smoothing_);
+
+        if (limiter.min_limit_ <= 0 || limiter.max_limit_ < limiter.min_limit_ ||
+            limiter.initial_limit_ < limiter.min_limit_ || limiter.initial_limit_ > limiter.max_limit_ ||
+            limiter.tolerance_ < 1.0 || limiter.smoothing_ <= 0 || limiter.smoothing_ > 1.0) {
+            roo::log_err("Detected invalid exec_limiter setting: limit %d~%d, initial %d, tolerance %f, smoothing %f.",
+                         limiter.min_limit_, limiter.max_limit_, limiter.initial_limit_,
+                         limiter.tolerance_, limiter.smoothing_);
+            return -1;
+        }
+
+        return 0;
     }
 
     int module_status(std::string& module, std::string& name, std::string& val) {
@@ -59,10 +379,126 @@ protected:
         return 0;
     }
 
+
+    // 注册opcode的处理函数，请求体由handler自己解析
+    // 需要在服务初始化阶段完成注册，服务运行后不再修改分发表
+    bool register_handler(uint16_t opcode, const opcode_handler_t& handler) {
+
+        if (!handler) {
+            roo::log_err("register empty handler for opcode %u.", opcode);
+            return false;
+        }
+
+        if (opcode >= handlers_.size()) {
+            handlers_.resize(opcode + 1);
+        }
+
+        if (handlers_[opcode]) {
+            roo::log_err("handler for opcode %u already registered.", opcode);
+            return false;
+        }
+
+        handlers_[opcode] = handler;
+        return true;
+    }
+
+    // 序列化response并答复，异步完成的处理函数在完成的时候调用
+    template <typename Rsp>
+    static void reply_response(std::shared_ptr<RpcInstance>& rpc_instance, const Rsp& response) {
+
+        std::string& response_str = reusable_buffer();
+        if (!roo::ProtoBuf::marshalling_to_string(response, &response_str)) {
+            roo::log_err("marshal response for opcode %u failed.", rpc_instance->get_opcode());
+            rpc_instance->reject(RpcResponseStatus::SYSTEM_ERROR);
+            return;
+        }
+
+        rpc_instance->reply_rpc_message(response_str);
+    }
+
+    // 注册类型化的处理函数，框架负责Request的反序列化和Response的序列化，
+    // handler返回OK之后回复response，否则按照返回的状态码reject
+    // handler调用了rpc_instance->defer()的话框架不做答复，由handler之后
+    // 通过reply_response或者reject自行完成
+    // bad_request可选，用于在请求体解析失败的时候填充业务错误的response，
+    // 没有提供的时候直接按照INVALID_REQUEST拒绝
+    // 注意：request和response是线程内复用的对象，handler返回之后就会
+    // 被下一个请求覆盖，如果需要保留请自行拷贝。调用了defer()的handler
+    // 也不能保留response的引用，需要在自己的Rsp对象中填写并通过
+    // reply_response答复
+    template <uint16_t OpCode, typename Req, typename Rsp>
+    bool register_handler(const std::function<RpcResponseStatus(std::shared_ptr<RpcInstance>&, const Req&, Rsp&)>& fn,
+                          const std::function<void(Rsp&)>& bad_request = nullptr) {
+
+        if (!fn) {
+            roo::log_err("register empty typed handler for opcode %u.", OpCode);
+            return false;
+        }
+
+        return register_handler(OpCode, [fn, bad_request](std::shared_ptr<RpcInstance>& rpc_instance) {
+
+            // Req和Rsp是同一个类型的时候也要使用不同的对象，否则填写response
+            // 会覆盖handler正在读取的request
+            Req& request = reusable_message<Req, 0>();
+            Rsp& response = reusable_message<Rsp, 1>();
+
+            RpcResponseStatus status = RpcResponseStatus::OK;
+            if (!roo::ProtoBuf::unmarshalling_from_string(rpc_instance->get_rpc_request_message().payload_, &request)) {
+                roo::log_err("unmarshal request for opcode %u failed.", OpCode);
+                if (!bad_request) {
+                    rpc_instance->reject(RpcResponseStatus::INVALID_REQUEST);
+                    return;
+                }
+                bad_request(response);
+            } else {
+                status = fn(rpc_instance, request, response);
+            }
+
+            if (status != RpcResponseStatus::OK) {
+                rpc_instance->reject(status);
+                return;
+            }
+
+            if (rpc_instance->is_deferred()) {
+                return;
+            }
+
+            reply_response(rpc_instance, response);
+        });
+    }
+
+    // 根据opcode查找分发表，没有注册的opcode返回false，由调用者决定如何拒绝
+    bool dispatch_RPC(std::shared_ptr<RpcInstance>& rpc_instance) {
+
+        uint16_t opcode = rpc_instance->get_opcode();
+        if (unlikely(opcode >= handlers_.size() || !handlers_[opcode])) {
+            return false;
+        }
+
+        handlers_[opcode](rpc_instance);
+        return true;
+    }
+
 private:
 
+    template <typename T, int Slot>
+    static T& reusable_message() {
+        static thread_local T message;
+        message.Clear();
+        return message;
+    }
+
+    static std::string& reusable_buffer() {
+        static thread_local std::string buffer;
+        buffer.clear();
+        return buffer;
+    }
+
     const std::string instance_name_;
 
+    // 按照opcode直接索引的分发表
+    std::vector<opcode_handler_t> handlers_;
+
 };
 
 } // namespace tzrpc
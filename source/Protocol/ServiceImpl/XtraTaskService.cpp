@@ -3,6 +3,7 @@
 
 #include <scaffold/Setting.h>
 #include <scaffold/Status.h>
+#include <concurrency/Timer.h>
 
 #include <Captain.h>
 #include "XtraTaskService.h"
@@ -11,6 +12,19 @@ namespace tzrpc {
 
 bool XtraTaskService::init() {
 
+    using XtraTask::OpCode;
+
+    // 注册各个opcode的处理函数
+    register_handler<OpCode::CMD_READ, XtraTask::XtraReadOps::Request, XtraTask::XtraReadOps::Response>(
+        std::bind(&XtraTaskService::read_ops_impl, this,
+                  std::placeholders::_1, std::placeholders::_2, std::placeholders::_3),
+        [](XtraTask::XtraReadOps::Response& response) {
+            response.set_code(-1);
+            response.set_msg("参数错误");
+        });
+    register_handler(OpCode::CMD_WRITE,
+                     std::bind(&XtraTaskService::write_ops_impl, this, std::placeholders::_1));
+
     auto setting_ptr = Captain::instance().setting_ptr()->get_setting();
     if (!setting_ptr) {
         roo::log_err("Setting not initialized? return setting_ptr empty!!!");
@@ -155,83 +169,72 @@ int XtraTaskService::module_status(std::string& module, std::string& name, std::
 
 void XtraTaskService::handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) {
 
-    using XtraTask::OpCode;
-
     // Call the appropriate RPC handler based on the request's opCode.
-    switch (rpc_instance->get_opcode()) {
-        case OpCode::CMD_READ:
-            read_ops_impl(rpc_instance);
-            break;
-        case OpCode::CMD_WRITE:
-            write_ops_impl(rpc_instance);
-            break;
-
-        default:
-            roo::log_err("Received RPC request with unknown opcode %u: "
-                         "rejecting it as invalid request",
-                         rpc_instance->get_opcode());
-            rpc_instance->reject(RpcResponseStatus::INVALID_REQUEST);
+    if (!dispatch_RPC(rpc_instance)) {
+        roo::log_err("Received RPC request with unknown opcode %u: "
+                     "rejecting it as invalid request",
+                     rpc_instance->get_opcode());
+        rpc_instance->reject(RpcResponseStatus::INVALID_REQUEST);
     }
 }
 
 
-void XtraTaskService::read_ops_impl(std::shared_ptr<RpcInstance> rpc_instance) {
+RpcResponseStatus XtraTaskService::read_ops_impl(std::shared_ptr<RpcInstance>& rpc_instance,
+                                                 const XtraTask::XtraReadOps::Request& request,
+                                                 XtraTask::XtraReadOps::Response& response) {
 
-    // 再做一次opcode校验
-    RpcRequestMessage& rpc_request_message = rpc_instance->get_rpc_request_message();
-    if (rpc_request_message.header_.opcode != XtraTask::OpCode::CMD_READ) {
-        roo::log_err("invalid opcode %u in service XtraTask.", rpc_request_message.header_.opcode);
-        rpc_instance->reject(RpcResponseStatus::INVALID_REQUEST);
-        return;
-    }
-
-    XtraTask::XtraReadOps::Response response;
     response.set_code(0);
     response.set_msg("OK");
 
-    do {
-
-        // 消息体的unmarshal
-        XtraTask::XtraReadOps::Request request;
-        if (!roo::ProtoBuf::unmarshalling_from_string(rpc_request_message.payload_, &request)) {
-            roo::log_err("unmarshal request failed.");
-            response.set_code(-1);
-            response.set_msg("参数错误");
-            break;
+    // 相同类目下的子RPC分发
+    if (request.has_ping()) {
+        roo::log_info("XtraTask::XtraReadOps::ping -> %s", request.ping().msg().c_str());
+        response.mutable_ping()->set_msg("[[[pong]]]");
+    } else if (request.has_gets()) {
+        roo::log_info("XtraTask::XtraReadOps::get -> %s", request.gets().key().c_str());
+        response.mutable_gets()->set_value("[[[pong]]]");
+    } else if (request.has_echo()) {
+        const std::string& real_msg = request.echo().msg();
+        roo::log_info("XtraTask::XtraReadOps::echo -> %s", real_msg.c_str());
+        response.mutable_echo()->set_msg("echo:" + real_msg);
+    } else if (request.has_timeout()) {
+        int32_t timeout = request.timeout().timeout();
+        if (timeout < 0) {
+            roo::log_err("invalid timeout request: %d sec.", timeout);
+            return RpcResponseStatus::INVALID_REQUEST;
         }
-
-        // 相同类目下的子RPC分发
-        if (request.has_ping()) {
-            roo::log_info("XtraTask::XtraReadOps::ping -> %s", request.ping().msg().c_str());
-            response.mutable_ping()->set_msg("[[[pong]]]");
-            break;
-        } else if (request.has_gets()) {
-            roo::log_info("XtraTask::XtraReadOps::get -> %s", request.gets().key().c_str());
-            response.mutable_gets()->set_value("[[[pong]]]");
-            break;
-        } else if (request.has_echo()) {
-            std::string real_msg = request.echo().msg();
-            roo::log_info("XtraTask::XtraReadOps::echo -> %s", real_msg.c_str());
-            response.mutable_echo()->set_msg("echo:" + real_msg);
-        } else if (request.has_timeout()) {
-            int32_t timeout = request.timeout().timeout();
-            roo::log_info("this thread will sleep for %d sec.", timeout);
-            ::sleep(timeout);
-            response.mutable_timeout()->set_timeout("you should not see this.");
-        } else {
-            roo::log_err("undetected specified service call.");
-            rpc_instance->reject(RpcResponseStatus::INVALID_REQUEST);
-            return;
+        roo::log_info("this request will be replied after %d sec.", timeout);
+
+        // 通过定时器异步答复，等待期间不占用执行线程
+        rpc_instance->defer();
+        std::shared_ptr<RpcInstance> instance = rpc_instance;
+        if (!Captain::instance().timer_ptr()->add_timer(
+                [instance](const boost::system::error_code& ec) mutable {
+                    // 定时器被取消或者出错，没有等待到指定的时间，不能答复成功
+                    if (ec) {
+                        roo::log_err("timeout timer failed: %s", ec.message().c_str());
+                        instance->reject(RpcResponseStatus::SYSTEM_ERROR);
+                        return;
+                    }
+
+                    XtraTask::XtraReadOps::Response timeout_response;
+                    timeout_response.set_code(0);
+                    timeout_response.set_msg("OK");
+                    timeout_response.mutable_timeout()->set_timeout("you should not see this.");
+                    reply_response(instance, timeout_response);
+                }, timeout * 1000, false)) {
+            roo::log_err("add timeout timer failed.");
+            return RpcResponseStatus::SYSTEM_ERROR;
         }
+    } else {
+        roo::log_err("undetected specified service call.");
+        return RpcResponseStatus::INVALID_REQUEST;
+    }
 
-    } while (0);
-
-    std::string response_str;
-    roo::ProtoBuf::marshalling_to_string(response, &response_str);
-    rpc_instance->reply_rpc_message(response_str);
+    return RpcResponseStatus::OK;
 }
 
-void XtraTaskService::write_ops_impl(std::shared_ptr<RpcInstance> rpc_instance) {
+void XtraTaskService::write_ops_impl(std::shared_ptr<RpcInstance>& rpc_instance) {
 
 #if 0
     PRELUDE(XtraWriteCmd);
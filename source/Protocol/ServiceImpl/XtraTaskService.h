@@ -8,6 +8,8 @@
 
 #include <scaffold/Setting.h>
 
+#include <Protocol/gen-cpp/XtraTask.pb.h>
+
 #include "RpcServiceBase.h"
 
 namespace tzrpc {
@@ -56,8 +58,10 @@ private:
 private:
 
     ////////// RPC handlers //////////
-    void read_ops_impl(std::shared_ptr<RpcInstance> rpc_instance);
-    void write_ops_impl(std::shared_ptr<RpcInstance> rpc_instance);
+    RpcResponseStatus read_ops_impl(std::shared_ptr<RpcInstance>& rpc_instance,
+                                    const XtraTask::XtraReadOps::Request& request,
+                                    XtraTask::XtraReadOps::Response& response);
+    void write_ops_impl(std::shared_ptr<RpcInstance>& rpc_instance);
 
     const std::string instance_name_;
 
@@ -0,0 +1,141 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <cmath>
+#include <sstream>
+
+#include <other/Log.h>
+
+#include <RPC/ConcurrencyLimiter.h>
+
+namespace tzrpc {
+
+// 采样窗口至少持续的时间，以及至少需要的样本数目
+static const int64_t kWindowTimeMs   = 100;
+static const int64_t kWindowMinCount = 10;
+
+// 每隔若干个窗口用这段时间内的最小RTT替换，适应下游基础延迟的变化
+static const uint64_t kMinRttResetWindows = 600;
+
+ConcurrencyLimiter::ConcurrencyLimiter(const ConcurrencyLimiterConf& conf) :
+    conf_(conf),
+    limit_(conf.initial_limit_),
+    inflight_(0),
+    shed_count_(0),
+    lock_(),
+    limit_value_(conf.initial_limit_),
+    min_rtt_us_(0),
+    period_min_rtt_us_(0),
+    last_rtt_us_(0),
+    window_rtt_sum_(0),
+    window_count_(0),
+    window_seq_(0),
+    window_start_(std::chrono::steady_clock::now()) {
+}
+
+bool ConcurrencyLimiter::try_acquire() {
+
+    int inflight = inflight_.load(std::memory_order_relaxed);
+    while (inflight < limit_.load(std::memory_order_relaxed)) {
+        if (inflight_.compare_exchange_weak(inflight, inflight + 1))
+            return true;
+    }
+
+    ++shed_count_;
+    return false;
+}
+
+void ConcurrencyLimiter::release(int64_t rtt_us) {
+
+    --inflight_;
+
+    if (rtt_us < 0)
+        return;
+
+    int64_t sample_rtt_us = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        window_rtt_sum_ += rtt_us;
+        ++window_count_;
+
+        auto now = std::chrono::steady_clock::now();
+        if (window_count_ < kWindowMinCount ||
+            now - window_start_ < std::chrono::milliseconds(kWindowTimeMs)) {
+            return;
+        }
+
+        sample_rtt_us = window_rtt_sum_ / window_count_;
+        window_rtt_sum_ = 0;
+        window_count_ = 0;
+        window_start_ = now;
+
+        update_limit(sample_rtt_us);
+    }
+}
+
+// 持有lock_调用
+void ConcurrencyLimiter::update_limit(int64_t sample_rtt_us) {
+
+    if (sample_rtt_us <= 0)
+        sample_rtt_us = 1;
+
+    if (min_rtt_us_ == 0 || sample_rtt_us < min_rtt_us_) {
+        min_rtt_us_ = sample_rtt_us;
+    }
+
+    if (period_min_rtt_us_ == 0 || sample_rtt_us < period_min_rtt_us_) {
+        period_min_rtt_us_ = sample_rtt_us;
+    }
+
+    // 不能直接取当前的采样值，负载高的时候它本身就偏大，梯度会一直停在1.0附近
+    if (++window_seq_ % kMinRttResetWindows == 0) {
+        min_rtt_us_ = period_min_rtt_us_;
+        period_min_rtt_us_ = 0;
+    }
+
+    last_rtt_us_ = sample_rtt_us;
+
+    double gradient = conf_.tolerance_ * min_rtt_us_ / sample_rtt_us;
+    gradient = std::max(0.5, std::min(1.0, gradient));
+
+    // 实际并发远小于限制的时候不需要再增加，否则空闲的时候limit会一直涨到上限
+    double new_limit = limit_value_ * gradient;
+    if (gradient < 1.0 || inflight_.load(std::memory_order_relaxed) * 2 >= limit_value_) {
+        new_limit += std::sqrt(limit_value_);
+    }
+
+    new_limit = limit_value_ * (1 - conf_.smoothing_) + new_limit * conf_.smoothing_;
+    new_limit = std::max<double>(conf_.min_limit_, std::min<double>(conf_.max_limit_, new_limit));
+
+    int old_limit = limit_.load(std::memory_order_relaxed);
+    limit_value_ = new_limit;
+    limit_.store(static_cast<int>(new_limit), std::memory_order_relaxed);
+
+    if (old_limit != static_cast<int>(new_limit)) {
+        roo::log_info("concurrency limit %d -> %d, min_rtt %ld us, sample_rtt %ld us.",
+                      old_limit, static_cast<int>(new_limit), min_rtt_us_, sample_rtt_us);
+    }
+}
+
+std::string ConcurrencyLimiter::dump() {
+
+    std::stringstream ss;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    ss << "\t" << "limiter_limit: " << limit_.load() << " ("
+       << conf_.min_limit_ << "~" << conf_.max_limit_ << ")" << std::endl;
+    ss << "\t" << "limiter_inflight: " << inflight_.load() << std::endl;
+    ss << "\t" << "limiter_min_rtt_us: " << min_rtt_us_ << std::endl;
+    ss << "\t" << "limiter_sample_rtt_us: " << last_rtt_us_ << std::endl;
+    ss << "\t" << "limiter_shed_count: " << shed_count_.load() << std::endl;
+
+    return ss.str();
+}
+
+} // end namespace tzrpc
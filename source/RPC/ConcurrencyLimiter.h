@@ -0,0 +1,84 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_CONCURRENCY_LIMITER_H__
+#define __RPC_CONCURRENCY_LIMITER_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace tzrpc {
+
+struct ConcurrencyLimiterConf {
+    int    min_limit_;
+    int    max_limit_;
+    int    initial_limit_;
+    double tolerance_;    // 允许采样RTT超过最小RTT的倍数，超过之后开始收缩
+    double smoothing_;    // 每个窗口新计算的limit所占的比重
+};
+
+// 基于延迟梯度的自适应并发限制
+// 统计请求从处理函数开始执行到完成的时间，不包括排队时间，当采样的RTT相对于
+// 最小RTT变大的时候说明下游或者共享的资源开始饱和了，按照比值收缩允许的并发
+// 数目，RTT恢复之后再逐步增加。超过并发限制的请求在分发的时候直接拒绝，不再排队
+// 最小RTT定期用上一个周期内观察到的最小值替换，适应下游基础延迟的变化
+//
+//   gradient  = clamp(tolerance * min_rtt / sample_rtt, 0.5, 1.0)
+//   new_limit = limit * gradient + sqrt(limit)
+//   limit     = limit * (1 - smoothing) + new_limit * smoothing
+class ConcurrencyLimiter {
+
+    __noncopyable__(ConcurrencyLimiter)
+
+public:
+    explicit ConcurrencyLimiter(const ConcurrencyLimiterConf& conf);
+    ~ConcurrencyLimiter() = default;
+
+    // 分发请求的时候调用，返回false表示应当拒绝这个请求
+    bool try_acquire();
+
+    // 请求处理完成之后调用，rtt_us为负数表示这个请求不参与RTT的统计
+    void release(int64_t rtt_us);
+
+    int limit() const {
+        return limit_.load(std::memory_order_relaxed);
+    }
+
+    int inflight() const {
+        return inflight_.load(std::memory_order_relaxed);
+    }
+
+    std::string dump();
+
+private:
+    void update_limit(int64_t sample_rtt_us);
+
+    const ConcurrencyLimiterConf conf_;
+
+    std::atomic<int> limit_;
+    std::atomic<int> inflight_;
+    std::atomic<uint64_t> shed_count_;
+
+    // 以下的采样窗口数据都由lock_保护
+    std::mutex lock_;
+    double   limit_value_;     // limit_的浮点值，避免平滑过程中的取整误差
+    int64_t  min_rtt_us_;
+    int64_t  period_min_rtt_us_;   // 本周期内的最小RTT，周期结束的时候替换min_rtt_us_
+    int64_t  last_rtt_us_;
+    int64_t  window_rtt_sum_;
+    int64_t  window_count_;
+    uint64_t window_seq_;
+    std::chrono::steady_clock::time_point window_start_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_CONCURRENCY_LIMITER_H__
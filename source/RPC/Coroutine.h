@@ -0,0 +1,301 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_COROUTINE_H__
+#define __RPC_COROUTINE_H__
+
+// C++20协程的服务接口，需要使用 cmake -DBUILD_COROUTINE=ON 编译，
+// 没有开启的时候这个头文件为空，其余代码仍然可以按照C++11编译
+#ifdef TZRPC_COROUTINE
+
+#include <xtra_rhel.h>
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <other/Log.h>
+
+#include <RPC/ExecutorPool.h>
+#include <RPC/RpcInstance.h>
+
+namespace tzrpc {
+
+// 协程处理函数的返回类型，调用之后立即开始执行，执行结束之后协程帧自动释放
+//
+//   RpcTask handler(std::shared_ptr<RpcInstance> rpc_instance) {
+//       co_await sleep_for(io_service, std::chrono::milliseconds(10));
+//       rpc_instance->reply_rpc_message(...);
+//   }
+//
+// 如果协程的参数中有std::shared_ptr<RpcInstance>，出现未捕获的异常并且
+// 请求还没有答复的时候，自动以SYSTEM_ERROR拒绝该请求
+class RpcTask {
+
+public:
+    struct promise_type {
+
+        promise_type() = default;
+
+        template<typename... Args>
+        explicit promise_type(Args&... args) {
+            (capture(args), ...);
+        }
+
+        RpcTask get_return_object() {
+            return RpcTask();
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {
+        }
+
+        void unhandled_exception() {
+            try {
+                std::rethrow_exception(std::current_exception());
+            } catch (const std::exception& e) {
+                roo::log_err("coroutine handler exception: %s", e.what());
+            } catch (...) {
+                roo::log_err("coroutine handler unknown exception.");
+            }
+
+            if (rpc_instance_ && !rpc_instance_->is_completed()) {
+                rpc_instance_->reject(RpcResponseStatus::SYSTEM_ERROR);
+            }
+        }
+
+    private:
+        void capture(std::shared_ptr<RpcInstance>& rpc_instance) {
+            rpc_instance_ = rpc_instance;
+        }
+
+        template<typename T>
+        void capture(T&) {
+        }
+
+        std::shared_ptr<RpcInstance> rpc_instance_;
+    };
+};
+
+
+// 在io_service的线程上恢复执行，可以用来从执行线程切换到io线程
+class IoServiceAwaiter {
+
+public:
+    explicit IoServiceAwaiter(boost::asio::io_service& io_service) :
+        io_service_(io_service) {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        io_service_.post([handle]() { handle.resume(); });
+    }
+
+    void await_resume() const noexcept {
+    }
+
+private:
+    boost::asio::io_service& io_service_;
+};
+
+static inline IoServiceAwaiter resume_on(boost::asio::io_service& io_service) {
+    return IoServiceAwaiter(io_service);
+}
+
+
+// 在共享执行线程池的工作线程上恢复执行，awaiter本身保存在协程帧中，
+// 在恢复之前一直有效
+class ExecutorPoolAwaiter : public Schedulable {
+
+public:
+    explicit ExecutorPoolAwaiter(ExecutorPool& pool) :
+        pool_(pool),
+        handle_() {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        pool_.schedule(this);
+    }
+
+    void await_resume() const noexcept {
+    }
+
+    // 协程恢复之后awaiter可能已经随协程帧释放，之后不能再访问成员
+    void run_scheduled(int64_t budget_us)override {
+        handle_.resume();
+    }
+
+    std::string instance_name()override {
+        return "coroutine";
+    }
+
+private:
+    ExecutorPool& pool_;
+    std::coroutine_handle<> handle_;
+};
+
+static inline ExecutorPoolAwaiter resume_on(ExecutorPool& pool) {
+    return ExecutorPoolAwaiter(pool);
+}
+
+
+// 异步等待一段时间，超时之后在io_service的线程上恢复执行
+class SleepAwaiter {
+
+public:
+    SleepAwaiter(boost::asio::io_service& io_service, std::chrono::milliseconds duration) :
+        timer_(std::make_shared<boost::asio::steady_timer>(io_service)),
+        duration_(duration) {
+    }
+
+    bool await_ready() const noexcept {
+        return duration_.count() <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        auto timer = timer_;
+        timer_->expires_from_now(duration_);
+        timer_->async_wait([timer, handle](const boost::system::error_code& ec) {
+            handle.resume();
+        });
+    }
+
+    void await_resume() const noexcept {
+    }
+
+private:
+    std::shared_ptr<boost::asio::steady_timer> timer_;
+    std::chrono::milliseconds duration_;
+};
+
+static inline SleepAwaiter sleep_for(boost::asio::io_service& io_service, std::chrono::milliseconds duration) {
+    return SleepAwaiter(io_service, duration);
+}
+
+
+// 把回调形式的异步接口转换成可以co_await的对象，回调在任意线程中调用
+// set_value，协程在调用set_value的线程上恢复执行。下游的tzrpc调用、
+// 其他异步完成的操作都可以通过它来等待
+//
+//   auto result = std::make_shared<AsyncValue<std::string>>();
+//   some_async_call([result](const std::string& rsp) { result->set_value(rsp); });
+//   std::string rsp = co_await *result;
+template<typename T>
+class AsyncValue {
+
+public:
+    AsyncValue() :
+        lock_(),
+        value_(),
+        handle_() {
+    }
+
+    AsyncValue(const AsyncValue&) = delete;
+    AsyncValue& operator=(const AsyncValue&) = delete;
+
+    void set_value(T value) {
+
+        std::coroutine_handle<> handle;
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            if (value_)
+                return;
+
+            value_ = std::move(value);
+            handle = handle_;
+        }
+
+        if (handle) {
+            handle.resume();
+        }
+    }
+
+    // co_await的时候只引用AsyncValue，避免编译器尝试复制它
+    class Awaiter {
+
+    public:
+        explicit Awaiter(AsyncValue& value) :
+            value_(value) {
+        }
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> lock(value_.lock_);
+            return value_.value_.has_value();
+        }
+
+        // 返回false表示值已经设置了，不需要挂起
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(value_.lock_);
+            if (value_.value_)
+                return false;
+
+            value_.handle_ = handle;
+            return true;
+        }
+
+        T await_resume() {
+            std::lock_guard<std::mutex> lock(value_.lock_);
+            return std::move(*value_.value_);
+        }
+
+    private:
+        AsyncValue& value_;
+    };
+
+    Awaiter operator co_await() {
+        return Awaiter(*this);
+    }
+
+private:
+    std::mutex lock_;
+    std::optional<T> value_;
+    std::coroutine_handle<> handle_;
+};
+
+
+// 把协程处理函数包装成普通的opcode处理函数，可以直接用于RpcServiceBase::register_handler
+// 请求会被标记为异步完成，执行线程在协程第一次挂起的时候就返回
+typedef std::function<RpcTask(std::shared_ptr<RpcInstance>)> coroutine_handler_t;
+
+static inline std::function<void(std::shared_ptr<RpcInstance>&)>
+make_coroutine_handler(const coroutine_handler_t& handler) {
+    return [handler](std::shared_ptr<RpcInstance>& rpc_instance) {
+        rpc_instance->defer();
+        handler(rpc_instance);
+    };
+}
+
+} // end namespace tzrpc
+
+#endif // TZRPC_COROUTINE
+
+#endif // __RPC_COROUTINE_H__
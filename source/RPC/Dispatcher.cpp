@@ -6,9 +6,12 @@
  */
 
 #include <scaffold/Setting.h>
+#include <scaffold/Status.h>
 
 #include <RPC/Service.h>
 #include <RPC/Executor.h>
+#include <RPC/WorkStealingPool.h>
+#include <RPC/FairSharePool.h>
 #include <RPC/RpcInstance.h>
 #include <RPC/Dispatcher.h>
 
@@ -26,6 +29,17 @@ bool Dispatcher::init() {
 
     initialized_ = true;
 
+    if (executor_pool_) {
+
+        executor_pool_->pool_start();
+        roo::log_info("start executor pool %s successfully.", executor_pool_->instance_name().c_str());
+
+        Captain::instance().status_ptr()->attach_status_callback(
+            "executor_pool_" + executor_pool_->instance_name(),
+            std::bind(&ExecutorPool::module_status, executor_pool_,
+                      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
     for (auto iter = services_.begin(); iter != services_.end(); ++iter) {
         Executor* executor = dynamic_cast<Executor*>(iter->second.get());
 
@@ -56,16 +70,80 @@ void Dispatcher::register_service(uint16_t service_id, std::shared_ptr<Service>
         return;
     }
 
-    auto exec_service = std::make_shared<Executor>(service);
+    if (!executor_pool_loaded_ && !load_executor_pool()) {
+        roo::log_err("load executor pool failed, service %s will not be registered.",
+                     service->instance_name().c_str());
+        return;
+    }
+
+    auto exec_service = std::make_shared<Executor>(service, executor_pool_);
     if (!exec_service || !exec_service->init()) {
         roo::log_err("service %s init failed.", service->instance_name().c_str());
         return;
     }
 
     services_[service_id] = exec_service;
+    update_service_table();
     roo::log_info("Register service %s successfully.", service->instance_name().c_str());
 }
 
+bool Dispatcher::load_executor_pool() {
+
+    executor_pool_loaded_ = true;
+
+    auto setting_ptr = Captain::instance().setting_ptr()->get_setting();
+    if (!setting_ptr) {
+        roo::log_err("setting_ptr is nullptr.");
+        return false;
+    }
+
+    bool enable = false;
+    int thread_number = 0;
+    std::string scheduler = "work_stealing";
+    int quantum_us = 2000;
+    setting_ptr->lookupValue("rpc.executor_pool.enable", enable);
+    setting_ptr->lookupValue("rpc.executor_pool.thread_pool_size", thread_number);
+    setting_ptr->lookupValue("rpc.executor_pool.scheduler", scheduler);
+    setting_ptr->lookupValue("rpc.executor_pool.quantum_us", quantum_us);
+
+    if (!enable) {
+        roo::log_info("shared executor pool disabled, each service uses its own thread pool.");
+        return true;
+    }
+
+    if (thread_number <= 0) {
+        roo::log_err("invalid rpc.executor_pool.thread_pool_size %d.", thread_number);
+        return false;
+    }
+
+    std::shared_ptr<ExecutorPool> pool;
+    if (scheduler == "work_stealing") {
+        pool = std::make_shared<WorkStealingPool>("shared");
+    } else if (scheduler == "fair" && quantum_us > 0) {
+        pool = std::make_shared<FairSharePool>("shared", quantum_us);
+    } else {
+        roo::log_err("invalid rpc.executor_pool scheduler %s, quantum_us %d.", scheduler.c_str(), quantum_us);
+        return false;
+    }
+
+    if (!pool || !pool->init(thread_number)) {
+        roo::log_err("init shared executor pool failed.");
+        return false;
+    }
+
+    executor_pool_ = pool;
+    return true;
+}
+
+void Dispatcher::update_service_table() {
+
+    std::unique_ptr<ServiceTable> table(new ServiceTable(services_));
+
+    std::lock_guard<std::mutex> lock(table_lock_);
+    table_.store(table.get(), std::memory_order_release);
+    tables_.push_back(std::move(table));
+}
+
 
 void Dispatcher::handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) {
 
@@ -75,12 +153,10 @@ void Dispatcher::handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) {
         return;
     }
 
-    std::shared_ptr<Service> service;
-    auto it = services_.find(rpc_instance->get_service_id());
-    if (it != services_.end())
-        service = it->second;
+    const ServiceTable* table = table_.load(std::memory_order_acquire);
+    Service* service = table ? table->find(rpc_instance->get_service_id()) : nullptr;
 
-    if (service) {
+    if (likely(service)) {
         service->handle_RPC(rpc_instance);
     } else {
         roo::log_err("found service_impl for %u:%u failed, not register it before ???",
@@ -90,6 +166,16 @@ void Dispatcher::handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) {
 }
 
 
+void Dispatcher::invalidate_response_cache(uint16_t service_id, uint16_t opcode, const std::string& payload) {
+
+    const ServiceTable* table = table_.load(std::memory_order_acquire);
+    Service* service = table ? table->find(service_id) : nullptr;
+
+    if (service) {
+        service->invalidate_response_cache(opcode, payload);
+    }
+}
+
 
 int Dispatcher::module_runtime(const libconfig::Config& conf) {
 
@@ -11,8 +11,13 @@
 #include <xtra_rhel.h>
 
 #include <cinttypes>
+#include <atomic>
 #include <map>
 #include <mutex>
+#include <vector>
+
+#include <RPC/ServiceTable.h>
+#include <RPC/ExecutorPool.h>
 
 
 namespace tzrpc {
@@ -33,6 +38,9 @@ public:
     void register_service(uint16_t service_id, std::shared_ptr<Service> service);
     void handle_RPC(std::shared_ptr<RpcInstance> rpc_instance);
 
+    // 服务数据变更之后失效答复缓存，payload为空表示失效该opcode所有的条目
+    void invalidate_response_cache(uint16_t service_id, uint16_t opcode, const std::string& payload = "");
+
     std::string instance_name() {
         return "Dispatcher";
     }
@@ -43,7 +51,12 @@ private:
 
     Dispatcher() :
         initialized_(false),
-        services_({ }) {
+        services_({ }),
+        table_(nullptr),
+        table_lock_(),
+        tables_(),
+        executor_pool_loaded_(false),
+        executor_pool_() {
     }
 
     ~Dispatcher() = default;
@@ -52,8 +65,25 @@ private:
 
     // 系统在启动的时候进行注册初始化，然后再提供服务，所以
     // 这边就不使用锁结构进行保护了，防止影响性能
+    // services_持有Service的所有权，请求路由只使用下面的table_
     std::map<uint16_t, std::shared_ptr<Service>> services_;
 
+    // 根据services_重新生成路由表，并原子地替换当前的快照
+    void update_service_table();
+
+    // 当前生效的路由表快照，请求路径上只有一次acquire读取
+    std::atomic<const ServiceTable*> table_;
+
+    // 旧的路由表不会立即释放，因为io线程可能还在使用，更新的频率
+    // 非常低，所以直接保留到进程退出
+    std::mutex table_lock_;
+    std::vector<std::unique_ptr<ServiceTable>> tables_;
+
+    // 配置了rpc.executor_pool之后，所有服务共享同一个工作窃取线程池，
+    // 否则每个服务使用自己独立的线程池
+    bool load_executor_pool();
+    bool executor_pool_loaded_;
+    std::shared_ptr<ExecutorPool> executor_pool_;
 
 };
 
@@ -8,10 +8,14 @@
 
 #include <xtra_rhel.h>
 
+#include <cmath>
+
 #include <scaffold/Status.h>
 #include <concurrency/Timer.h>
 
 #include <RPC/RpcInstance.h>
+#include <RPC/MPMCQueue.h>
+#include <RPC/FairRpcQueue.h>
 #include <RPC/Executor.h>
 #include <RPC/Dispatcher.h>
 
@@ -24,6 +28,101 @@ bool Executor::init() {
 
     conf_ = service_impl_->get_executor_conf();
 
+    // 每个优先级使用单独的队列和完整的容量，低优先级的积压不会占用高优先级的空间
+    for (int i = 0; i < kPriorityCount; ++i) {
+
+        if (conf_.exec_queue_type_ == "mpmc") {
+            rpc_queues_[i].reset(new MPMCQueue<std::shared_ptr<RpcInstance>>(
+                                     conf_.exec_queue_capacity_, conf_.exec_queue_policy_));
+        } else if (conf_.exec_queue_type_ == "fair") {
+            FairRpcQueue<std::shared_ptr<RpcInstance>>::source_key_t source_key;
+            if (conf_.exec_queue_fair_key_ == "ip") {
+                source_key = [](const std::shared_ptr<RpcInstance>& rpc_instance) {
+                    return rpc_instance->get_ip_key();
+                };
+            } else {
+                source_key = [](const std::shared_ptr<RpcInstance>& rpc_instance) {
+                    return rpc_instance->get_conn_key();
+                };
+            }
+            rpc_queues_[i].reset(new FairRpcQueue<std::shared_ptr<RpcInstance>>(
+                                     source_key, conf_.exec_queue_capacity_,
+                                     conf_.exec_queue_source_cap_, conf_.exec_queue_policy_));
+        } else {
+            rpc_queues_[i].reset(new MutexRpcQueue<std::shared_ptr<RpcInstance>>(
+                                     conf_.exec_queue_capacity_, conf_.exec_queue_policy_, conf_.exec_queue_lifo_depth_));
+        }
+
+        if (!rpc_queues_[i]) {
+            roo::log_err("create rpc_queue for service %s failed.", instance_name().c_str());
+            return false;
+        }
+
+        priority_count_[i] = 0;
+    }
+
+    roo::log_info("Service %s uses %s rpc_queue, capacity %d per priority, overload policy %s.",
+                  instance_name().c_str(), rpc_queues_[0]->queue_type().c_str(), conf_.exec_queue_capacity_,
+                  overload_policy_str(conf_.exec_queue_policy_).c_str());
+
+    batch_size_ = conf_.exec_batch_size_ > 0 ? conf_.exec_batch_size_ : 1;
+    schedule_weight_ = conf_.exec_weight_ > 0 ? conf_.exec_weight_ : 1;
+
+    if (conf_.exec_limiter_enable_) {
+        limiter_.reset(new ConcurrencyLimiter(conf_.exec_limiter_conf_));
+        roo::log_info("Service %s enable adaptive concurrency limiter, limit %d~%d.",
+                      instance_name().c_str(),
+                      conf_.exec_limiter_conf_.min_limit_, conf_.exec_limiter_conf_.max_limit_);
+    }
+
+    for (auto iter = conf_.exec_inline_opcodes_.begin(); iter != conf_.exec_inline_opcodes_.end(); ++iter) {
+        std::unique_ptr<InlineOpcode> inline_opcode(new InlineOpcode());
+        inline_opcode->budget_us_ = conf_.exec_inline_budget_us_;
+        inline_opcode->demote_overruns_ = conf_.exec_inline_demote_overruns_;
+        inline_opcode->enabled_ = true;
+        inline_opcode->overruns_ = 0;
+        inline_opcode->count_ = 0;
+        inline_opcodes_[*iter] = std::move(inline_opcode);
+        roo::log_info("Service %s opcode %u will be executed inline.", instance_name().c_str(), *iter);
+    }
+
+    if (!conf_.exec_cache_conf_.opcode_ttl_ms_.empty()) {
+        cache_.reset(new ResponseCache(conf_.exec_cache_conf_));
+        roo::log_info("Service %s enable response cache for %lu opcodes, memory %ld bytes.",
+                      instance_name().c_str(), conf_.exec_cache_conf_.opcode_ttl_ms_.size(),
+                      conf_.exec_cache_conf_.memory_limit_);
+    }
+
+    if (!conf_.exec_coalesce_opcodes_.empty()) {
+        coalescer_.reset(new RequestCoalescer(conf_.exec_coalesce_opcodes_,
+                                              std::bind(&Executor::submit_RPC, this, std::placeholders::_1)));
+        roo::log_info("Service %s enable request coalescing for %lu opcodes.",
+                      instance_name().c_str(), conf_.exec_coalesce_opcodes_.size());
+    }
+
+    // 优先级的配置只在启动的时候加载
+    for (auto iter = conf_.exec_opcode_priority_.begin(); iter != conf_.exec_opcode_priority_.end(); ++iter) {
+        opcode_priority_[iter->first] = iter->second - kRpcPriorityHigh;
+    }
+
+    priority_weight_sum_ = 0;
+    for (int i = 0; i < kPriorityCount; ++i) {
+        priority_weight_[i] = conf_.exec_priority_strict_ ? 0 : conf_.exec_priority_weights_[i];
+        priority_weight_sum_ += priority_weight_[i];
+    }
+
+    if (executor_pool_) {
+        roo::log_info("Service %s will be scheduled in shared pool %s, with max concurrency %d",
+                      instance_name().c_str(), executor_pool_->instance_name().c_str(),
+                      conf_.exec_thread_number_hard_);
+
+        Captain::instance().status_ptr()->attach_status_callback(
+            "executor_" + instance_name(),
+            std::bind(&Executor::module_status, shared_from_this(),
+                      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        return true;
+    }
+
     SAFE_ASSERT(conf_.exec_thread_number_ > 0);
     if (!executor_threads_.init_threads(
             std::bind(&Executor::executor_service_run, this, std::placeholders::_1), conf_.exec_thread_number_)) {
@@ -64,34 +163,123 @@ void Executor::executor_threads_adjust(const boost::system::error_code& ec) {
     }
 
     SAFE_ASSERT(conf.exec_thread_step_size_ > 0);
+    const ExecutorAutoscaleConf& autoscale = conf.exec_autoscale_conf_;
+
+    auto now = std::chrono::steady_clock::now();
+    int64_t interval_us = std::chrono::duration_cast<std::chrono::microseconds>(now - autoscale_last_tp_).count();
+    if (interval_us <= 0) {
+        return;
+    }
+
+    uint64_t busy_us  = busy_us_.load();
+    uint64_t wait_us  = wait_us_.load();
+    uint64_t executed = executed_count_.load();
+
+    uint64_t delta_busy_us  = busy_us - autoscale_last_busy_us_;
+    uint64_t delta_wait_us  = wait_us - autoscale_last_wait_us_;
+    uint64_t delta_executed = executed - autoscale_last_executed_;
+
+    autoscale_last_busy_us_  = busy_us;
+    autoscale_last_wait_us_  = wait_us;
+    autoscale_last_executed_ = executed;
+    autoscale_last_tp_ = now;
 
-    // 进行检查，看是否需要伸缩线程池
-    int expect_thread = conf.exec_thread_number_;
+    int current = static_cast<int>(executor_threads_.get_pool_size());
+    if (current <= 0) {
+        return;
+    }
 
-    int queueSize = rpc_queue_.SIZE();
-    if (queueSize > conf.exec_thread_step_size_) {
-        expect_thread += queueSize / conf.exec_thread_step_size_;
+    // 处理时间只有在请求完成的时候才会累计，处理函数长时间阻塞的时候
+    // 用正在执行的请求数目来估计利用率
+    double utilization = static_cast<double>(delta_busy_us) / (interval_us * current);
+    utilization = std::max(utilization, static_cast<double>(executing_.load()) / current);
+
+    int64_t queue_wait_ms = delta_executed > 0 ? delta_wait_us / delta_executed / 1000 : 0;
+
+    // 保留exec_thread_pool_step_size原来的含义，每排队step_size个请求需要一个
+    // 额外的线程，作为扩容目标的下限
+    int queue_need = conf.exec_thread_number_ + static_cast<int>(queue_size() / conf.exec_thread_step_size_);
+
+    int expect_thread = current;
+    std::string reason;
+
+    if ((utilization > autoscale.scale_up_utilization_ ||
+         queue_wait_ms > autoscale.scale_up_queue_wait_ms_ ||
+         queue_need > current) &&
+        current < conf.exec_thread_number_hard_ &&
+        now - autoscale_scale_up_tp_ >= std::chrono::seconds(autoscale.scale_up_cooldown_sec_)) {
+
+        // 估算让利用率回到上下阈值中间需要的线程数目，每次最多增加max_step个
+        double target = (autoscale.scale_up_utilization_ + autoscale.scale_down_utilization_) / 2;
+        int need = static_cast<int>(std::ceil(current * utilization / target));
+        expect_thread = std::max(need, current + 1);
+        expect_thread = std::max(expect_thread, queue_need);
+        expect_thread = std::min(expect_thread, current + autoscale.scale_up_max_step_);
+        expect_thread = std::min(expect_thread, conf.exec_thread_number_hard_);
+        reason = "scale up";
+
+    } else if (utilization < autoscale.scale_down_utilization_ &&
+               queue_wait_ms <= autoscale.scale_up_queue_wait_ms_ / 2 &&
+               queue_need < current &&
+               current > conf.exec_thread_number_ &&
+               now - autoscale_scale_up_tp_ >= std::chrono::seconds(autoscale.scale_down_cooldown_sec_) &&
+               now - autoscale_scale_down_tp_ >= std::chrono::seconds(autoscale.scale_down_cooldown_sec_)) {
+
+        // 缩容每次只减少一个线程，避免突发流量之后立即又要扩容
+        expect_thread = current - 1;
+        reason = "scale down";
+
+    } else if (current < conf.exec_thread_number_) {
+
+        // 动态更新调大了exec_thread_pool_size
+        expect_thread = conf.exec_thread_number_;
+        reason = "apply conf";
     }
-    if (expect_thread > conf.exec_thread_number_hard_) {
-        expect_thread = conf.exec_thread_number_hard_;
+
+    if (expect_thread == current) {
+        return;
     }
 
-    if (expect_thread != conf.exec_thread_number_) {
-        roo::log_warning("Start with thread number: %d before, expect resize to %d",
-                         conf.exec_thread_number_, expect_thread);
+    if (expect_thread > current) {
+        autoscale_scale_up_tp_ = now;
+    } else {
+        autoscale_scale_down_tp_ = now;
     }
 
+    char decision[256]{};
+    snprintf(decision, sizeof(decision), "%s %d -> %d, utilization %.2f, queue_wait %ld ms, queue_size %lu",
+             reason.c_str(), current, expect_thread, utilization, queue_wait_ms, queue_size());
+    roo::log_warning("executor %s %s", instance_name().c_str(), decision);
+    autoscale_record(decision);
+
     executor_threads_.resize_threads(expect_thread);
 }
 
+void Executor::autoscale_record(const std::string& decision) {
+
+    const size_t kMaxAutoscaleLog = 16;
+
+    char time_str[32]{};
+    time_t now = ::time(NULL);
+    struct tm now_tm;
+    ::localtime_r(&now, &now_tm);
+    ::strftime(time_str, sizeof(time_str), "%F %T", &now_tm);
+
+    std::lock_guard<std::mutex> lock(autoscale_lock_);
+    autoscale_log_.push_back(std::string(time_str) + " " + decision);
+    if (autoscale_log_.size() > kMaxAutoscaleLog) {
+        autoscale_log_.pop_front();
+    }
+}
+
 
 void Executor::executor_service_run(roo::ThreadObjPtr ptr) {
 
     roo::log_warning("executor_service thread %#lx about to loop ...", (long)pthread_self());
 
-    while (true) {
+    std::vector<std::shared_ptr<RpcInstance>> batch;
 
-        std::shared_ptr<RpcInstance> rpc_instance{};
+    while (true) {
 
         if (unlikely(ptr->status_ == roo::ThreadStatus::kTerminating)) {
             roo::log_err("thread %#lx is about to terminating...", (long)pthread_self());
@@ -104,12 +292,12 @@ void Executor::executor_service_run(roo::ThreadObjPtr ptr) {
             continue;
         }
 
-        if (!rpc_queue_.POP(rpc_instance, 1000 /*1s*/) || !rpc_instance) {
+        batch.clear();
+        if (dequeue(batch, batch_size_.load(std::memory_order_relaxed), 1000 /*1s*/) == 0) {
             continue;
         }
 
-        // execute RPC handler
-        service_impl_->handle_RPC(rpc_instance);
+        execute_RPC(batch);
     }
 
     ptr->status_ = roo::ThreadStatus::kDead;
@@ -120,6 +308,374 @@ void Executor::executor_service_run(roo::ThreadObjPtr ptr) {
 }
 
 
+int Executor::priority_class(std::shared_ptr<RpcInstance>& rpc_instance) const {
+
+    // 优先级由服务端按照opcode决定，请求头由客户端填写，不可信任，只能用来
+    // 降低自己的优先级，比如批量任务主动让出，不能提升到配置之上
+    int priority = kPriorityNormal;
+    auto iter = opcode_priority_.find(rpc_instance->get_opcode());
+    if (iter != opcode_priority_.end()) {
+        priority = iter->second;
+    }
+
+    uint16_t requested = rpc_instance->get_priority();
+    if (requested >= kRpcPriorityHigh && requested <= kRpcPriorityLow &&
+        requested - kRpcPriorityHigh > priority) {
+        priority = requested - kRpcPriorityHigh;
+    }
+
+    return priority;
+}
+
+size_t Executor::try_dequeue(std::vector<std::shared_ptr<RpcInstance>>& batch, size_t max_count) {
+
+    size_t count = 0;
+
+    // 加权调度: 按照权重选出本次优先检查的队列，这样即使高优先级的请求
+    // 持续到达，低优先级的请求也能得到一定比例的处理
+    int first = kPriorityHigh;
+    if (priority_weight_sum_ > 0) {
+        int slot = static_cast<int>(priority_seq_++ % priority_weight_sum_);
+        for (first = 0; first < kPriorityCount - 1; ++first) {
+            if (slot < priority_weight_[first])
+                break;
+            slot -= priority_weight_[first];
+        }
+
+        count += rpc_queues_[first]->POP_BATCH(batch, max_count, 0);
+    }
+
+    // 选中的队列不够一批，或者严格优先级调度，按照优先级从高到低补充
+    for (int i = 0; i < kPriorityCount && count < max_count; ++i) {
+        if (i != first || priority_weight_sum_ == 0) {
+            count += rpc_queues_[i]->POP_BATCH(batch, max_count - count, 0);
+        }
+    }
+
+    return count;
+}
+
+size_t Executor::dequeue(std::vector<std::shared_ptr<RpcInstance>>& batch, size_t max_count, uint64_t msec) {
+
+    size_t count = try_dequeue(batch, max_count);
+    if (count > 0 || msec == 0)
+        return count;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+
+    std::unique_lock<std::mutex> lock(park_lock_);
+    ++sleepers_;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    while ((count = try_dequeue(batch, max_count)) == 0) {
+        if (park_notify_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            count = try_dequeue(batch, max_count);
+            break;
+        }
+    }
+
+    --sleepers_;
+    return count;
+}
+
+size_t Executor::queue_size() {
+
+    size_t size = 0;
+    for (int i = 0; i < kPriorityCount; ++i) {
+        size += rpc_queues_[i]->SIZE();
+    }
+    return size;
+}
+
+void Executor::execute_RPC(std::vector<std::shared_ptr<RpcInstance>>& batch) {
+
+    // 客户端已经放弃等待的请求，直接答复而不再调用处理函数
+    size_t valid = 0;
+    uint64_t wait_us = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i]->is_expired()) {
+            ++expired_count_;
+            batch[i]->reject(RpcResponseStatus::DEADLINE_EXCEEDED);
+            continue;
+        }
+
+        wait_us += batch[i]->elapsed_us();
+        batch[i]->mark_execute_start();
+        if (valid != i) {
+            batch[valid] = std::move(batch[i]);
+        }
+        ++valid;
+    }
+
+    batch.resize(valid);
+    if (batch.empty()) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    wait_us_ += wait_us;
+    ++executing_;
+
+    // execute RPC handler
+    if (batch.size() == 1) {
+        service_impl_->handle_RPC(batch.front());
+    } else {
+        service_impl_->handle_RPC_batch(batch);
+    }
+
+    --executing_;
+    busy_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    executed_count_ += valid;
+    ++executed_batch_count_;
+}
+
+// 请求答复的时候调用，可能在任意线程中执行
+// 异步完成的请求，处理函数返回的时候还没有结束，所以并发和延迟在这里统计
+void Executor::on_completion(RpcInstance& rpc_instance, RpcResponseStatus status) {
+
+    --inflight_;
+
+    // 因为过载和超时被拒绝的请求没有真正执行，不参与延迟的统计
+    bool sample = (status != RpcResponseStatus::OVERLOADED &&
+                   status != RpcResponseStatus::DEADLINE_EXCEEDED);
+    int64_t latency_us = rpc_instance.elapsed_us();
+
+    if (sample) {
+        ++completed_count_;
+        completed_latency_us_ += latency_us;
+    }
+
+    // 并发限制只看执行时间，排队时间由队列容量和过载策略限制，
+    // 而且执行线程扩容之后排队时间会很快下降，不能反映下游是否饱和
+    if (limiter_) {
+        limiter_->release(sample ? rpc_instance.execute_elapsed_us() : -1);
+    }
+}
+
+bool Executor::try_execute_inline(std::shared_ptr<RpcInstance>& rpc_instance) {
+
+    // 单次执行超过预算这么多倍的时候立即降级，不再等待累计的超时次数
+    const int64_t kInlineSevereOverrun = 10;
+
+    auto iter = inline_opcodes_.find(rpc_instance->get_opcode());
+    if (iter == inline_opcodes_.end() || !iter->second->enabled_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    InlineOpcode& inline_opcode = *iter->second;
+
+    // 和执行线程中的请求一样检查截止时间和并发限制，完成的时候统计并发和延迟
+    if (rpc_instance->is_expired()) {
+        ++expired_count_;
+        rpc_instance->reject(RpcResponseStatus::DEADLINE_EXCEEDED);
+        return true;
+    }
+
+    if (limiter_ && !limiter_->try_acquire()) {
+        rpc_instance->reject(RpcResponseStatus::OVERLOADED);
+        return true;
+    }
+
+    ++inflight_;
+    rpc_instance->set_completion_hook(
+        std::bind(&Executor::on_completion, this, std::placeholders::_1, std::placeholders::_2));
+
+    ++inline_opcode.count_;
+
+    auto start = std::chrono::steady_clock::now();
+    rpc_instance->mark_execute_start();
+
+    // 异常不能传播到io线程的事件循环中
+    try {
+        service_impl_->handle_RPC(rpc_instance);
+    } catch (const std::exception& e) {
+        roo::log_err("Service %s opcode %u inline execution throw exception: %s",
+                     instance_name().c_str(), iter->first, e.what());
+        rpc_instance->reject(RpcResponseStatus::SYSTEM_ERROR);
+    } catch (...) {
+        roo::log_err("Service %s opcode %u inline execution throw unknown exception.",
+                     instance_name().c_str(), iter->first);
+        rpc_instance->reject(RpcResponseStatus::SYSTEM_ERROR);
+    }
+
+    int64_t cost_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // 在io线程上执行超时会阻塞这个线程上所有连接的收发，超时次数达到阈值
+    // 或者单次严重超时之后降级，后续的请求回到执行线程池中处理
+    if (cost_us > inline_opcode.budget_us_) {
+        uint32_t overruns = ++inline_opcode.overruns_;
+        if ((overruns >= inline_opcode.demote_overruns_ ||
+             cost_us >= inline_opcode.budget_us_ * kInlineSevereOverrun) &&
+            inline_opcode.enabled_.exchange(false)) {
+            roo::log_warning("Service %s opcode %u inline execution cost %ld us, exceed budget %ld us for %u times, "
+                             "demote it to executor threads.",
+                             instance_name().c_str(), iter->first, cost_us,
+                             inline_opcode.budget_us_, overruns);
+        }
+    }
+
+    return true;
+}
+
+bool Executor::try_answer_from_cache(std::shared_ptr<RpcInstance>& rpc_instance) {
+
+    uint16_t opcode = rpc_instance->get_opcode();
+    if (!cache_->cacheable(opcode)) {
+        return false;
+    }
+
+    const std::string& payload = rpc_instance->get_rpc_request_message().payload_;
+    std::string response;
+    uint64_t version = 0;
+    if (cache_->lookup(opcode, payload, response, version)) {
+        rpc_instance->reply_rpc_message(response);
+        return true;
+    }
+
+    // 未命中的请求正常执行，成功答复的时候写入缓存
+    ResponseCache* cache = cache_.get();
+    rpc_instance->add_response_hook(
+        [cache, opcode, payload, version](RpcResponseStatus status, const std::string& msg) {
+            if (status == RpcResponseStatus::OK) {
+                cache->insert(opcode, payload, msg, version);
+            }
+        });
+
+    return false;
+}
+
+void Executor::invalidate_response_cache(uint16_t opcode, const std::string& payload) {
+
+    if (!cache_) {
+        return;
+    }
+
+    if (payload.empty()) {
+        cache_->invalidate(opcode);
+    } else {
+        cache_->invalidate(opcode, payload);
+    }
+}
+
+void Executor::handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) {
+
+    if (cache_ && try_answer_from_cache(rpc_instance)) {
+        return;
+    }
+
+    if (!inline_opcodes_.empty() && try_execute_inline(rpc_instance)) {
+        return;
+    }
+
+    // 等待者不占用并发限制和队列，跟随执行的请求一起答复
+    if (coalescer_ && coalescer_->enabled(rpc_instance->get_opcode()) &&
+        !coalescer_->join(rpc_instance)) {
+        return;
+    }
+
+    submit_RPC(rpc_instance);
+}
+
+void Executor::submit_RPC(std::shared_ptr<RpcInstance> rpc_instance) {
+
+    // 过载的请求立即答复OVERLOADED，让客户端尽快退避，这里不逐条打日志，
+    // 否则过载的时候日志本身就会成为负担
+    // 超过自适应并发限制的请求不再排队，避免排队延迟持续增长
+    if (limiter_ && !limiter_->try_acquire()) {
+        rpc_instance->reject(RpcResponseStatus::OVERLOADED);
+        return;
+    }
+
+    // Executor的执行线程只是宿主，Executor对象和进程的生命周期相同
+    ++inflight_;
+    rpc_instance->set_completion_hook(
+        std::bind(&Executor::on_completion, this, std::placeholders::_1, std::placeholders::_2));
+
+    int priority = priority_class(rpc_instance);
+    ++priority_count_[priority];
+
+    std::shared_ptr<RpcInstance> evicted{};
+    PushResult result = rpc_queues_[priority]->PUSH(rpc_instance, evicted);
+
+    if (evicted) {
+        ++overload_dropped_;
+        evicted->reject(RpcResponseStatus::OVERLOADED);
+    }
+
+    if (result == PushResult::kRejected) {
+        ++overload_rejected_;
+        rpc_instance->reject(RpcResponseStatus::OVERLOADED);
+        return;
+    }
+
+    if (executor_pool_) {
+        try_schedule();
+        return;
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(park_lock_);
+        park_notify_.notify_one();
+    }
+}
+
+void Executor::try_schedule() {
+
+    // 每个槽位对应共享线程池中的一个调度任务，槽位用完说明已经有足够的
+    // 工作线程在处理本服务的请求了
+    if (schedule_slots_.acquire(conf_.exec_thread_number_hard_)) {
+        executor_pool_->schedule(this);
+    }
+}
+
+void Executor::run_scheduled(int64_t budget_us) {
+
+    // 没有时间片的时候每次调度最多处理若干个请求，然后让出工作线程，保证服务之间的公平
+    // 公平调度的线程池给出时间片，用完之后再让出
+    const size_t kScheduleBatch = 16;
+
+    size_t batch_size = batch_size_.load(std::memory_order_relaxed);
+    std::vector<std::shared_ptr<RpcInstance>> batch;
+    batch.reserve(batch_size);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t processed = 0;
+    while (budget_us > 0 || processed < kScheduleBatch) {
+
+        batch.clear();
+        size_t max_count = budget_us > 0 ? batch_size : std::min(batch_size, kScheduleBatch - processed);
+        size_t count = try_dequeue(batch, max_count);
+        if (count == 0) {
+            break;
+        }
+
+        processed += count;
+        execute_RPC(batch);
+
+        if (budget_us > 0 &&
+            std::chrono::steady_clock::now() - start >= std::chrono::microseconds(budget_us)) {
+            break;
+        }
+    }
+
+    // 还有请求排队，继续持有槽位重新投递
+    if (queue_size() > 0) {
+        executor_pool_->schedule(this);
+        return;
+    }
+
+    schedule_slots_.release();
+
+    // 释放槽位之后需要再次检查，因为在槽位用完期间投递的请求不会触发调度
+    if (queue_size() > 0) {
+        try_schedule();
+    }
+}
+
+
 int Executor::module_status(std::string& module, std::string& name, std::string& val) {
 
     module = "tzrpc";
@@ -131,11 +687,75 @@ int Executor::module_status(std::string& module, std::string& name, std::string&
     ss << "\t" << "exec_thread_number: " << conf_.exec_thread_number_ << std::endl;
     ss << "\t" << "exec_thread_number_hard(maxium): " << conf_.exec_thread_number_hard_ << std::endl;
     ss << "\t" << "exec_thread_step_size: " << conf_.exec_thread_step_size_ << std::endl;
+    ss << "\t" << "exec_autoscale_max_step: " << conf_.exec_autoscale_conf_.scale_up_max_step_ << std::endl;
 
     ss << "\t" << std::endl;
 
-    ss << "\t" << "current_thread_number: " << executor_threads_.get_pool_size() << std::endl;
-    ss << "\t" << "current_queue_size: " << rpc_queue_.SIZE() << std::endl;
+    if (executor_pool_) {
+        ss << "\t" << "executor_pool: " << executor_pool_->instance_name() << std::endl;
+        ss << "\t" << "current_scheduled_number: " << schedule_slots_.current() << std::endl;
+        ss << "\t" << "exec_weight: " << schedule_weight_.load() << std::endl;
+    } else {
+        ss << "\t" << "current_thread_number: " << executor_threads_.get_pool_size() << std::endl;
+    }
+    ss << "\t" << "queue_type: " << rpc_queues_[0]->queue_type() << std::endl;
+    ss << "\t" << "queue_capacity: " << conf_.exec_queue_capacity_ << std::endl;
+    if (conf_.exec_queue_type_ == "fair") {
+        ss << "\t" << "queue_fair_key: " << conf_.exec_queue_fair_key_ << std::endl;
+        ss << "\t" << "queue_source_cap: " << conf_.exec_queue_source_cap_ << std::endl;
+    }
+    ss << "\t" << "overload_policy: " << overload_policy_str(conf_.exec_queue_policy_) << std::endl;
+    ss << "\t" << "current_queue_size: " << queue_size() << std::endl;
+    ss << "\t" << "priority_schedule: " << (priority_weight_sum_ > 0 ? "weighted" : "strict") << std::endl;
+    const char* priority_names[kPriorityCount] = { "high", "normal", "low" };
+    for (int i = 0; i < kPriorityCount; ++i) {
+        ss << "\t" << "priority_" << priority_names[i] << ": "
+           << "weight " << priority_weight_[i] << ", "
+           << "queue_size " << rpc_queues_[i]->SIZE() << ", "
+           << "request_count " << priority_count_[i].load() << std::endl;
+    }
+    uint64_t executed_batch_count = executed_batch_count_.load();
+    ss << "\t" << "batch_size: " << batch_size_.load() << std::endl;
+    ss << "\t" << "average_batch_size: "
+       << (executed_batch_count > 0 ? static_cast<double>(executed_count_.load()) / executed_batch_count : 0) << std::endl;
+    ss << "\t" << "overload_rejected_count: " << overload_rejected_.load() << std::endl;
+    ss << "\t" << "overload_dropped_count: " << overload_dropped_.load() << std::endl;
+    ss << "\t" << "expired_count: " << expired_count_.load() << std::endl;
+
+    uint64_t completed_count = completed_count_.load();
+    ss << "\t" << "inflight_number: " << inflight_.load() << std::endl;
+    ss << "\t" << "completed_count: " << completed_count << std::endl;
+    ss << "\t" << "average_latency_us: "
+       << (completed_count > 0 ? completed_latency_us_.load() / completed_count : 0) << std::endl;
+
+    if (limiter_) {
+        ss << limiter_->dump();
+    }
+
+    if (coalescer_) {
+        ss << coalescer_->dump();
+    }
+
+    if (cache_) {
+        ss << cache_->dump();
+    }
+
+    for (auto iter = inline_opcodes_.begin(); iter != inline_opcodes_.end(); ++iter) {
+        ss << "\t" << "inline_opcode_" << iter->first << ": "
+           << (iter->second->enabled_.load() ? "enabled" : "demoted") << ", "
+           << "count " << iter->second->count_.load() << ", "
+           << "overruns " << iter->second->overruns_.load() << std::endl;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(autoscale_lock_);
+        if (!autoscale_log_.empty()) {
+            ss << "\t" << "autoscale_decisions: " << std::endl;
+            for (auto iter = autoscale_log_.begin(); iter != autoscale_log_.end(); ++iter) {
+                ss << "\t\t" << *iter << std::endl;
+            }
+        }
+    }
 
     std::string nullModule;
     std::string subKey;
@@ -158,6 +778,8 @@ int Executor::module_runtime(const libconfig::Config& conf) {
 
         std::lock_guard<std::mutex> lock(conf_lock_);
         conf_ = service_impl_->get_executor_conf();
+        batch_size_ = conf_.exec_batch_size_ > 0 ? conf_.exec_batch_size_ : 1;
+        schedule_weight_ = conf_.exec_weight_ > 0 ? conf_.exec_weight_ : 1;
     }
 
     return ret;
@@ -11,12 +11,21 @@
 
 #include <xtra_rhel.h>
 
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+#include <condition_variable>
 
-#include <container/EQueue.h>
 #include <concurrency/ThreadPool.h>
 #include <scaffold/Setting.h>
 
 #include <RPC/Service.h>
+#include <RPC/ExecutorPool.h>
+#include <RPC/RpcQueue.h>
+#include <RPC/RequestCoalescer.h>
+#include <RPC/ResponseCache.h>
+#include <RPC/RpcResponseMessage.h>
 
 #include <other/Log.h>
 
@@ -24,32 +33,151 @@ namespace tzrpc {
 
 
 class Executor : public Service,
+    public Schedulable,
     public std::enable_shared_from_this<Executor> {
 
 public:
 
-    explicit Executor(std::shared_ptr<Service> service_impl) :
+    // executor_pool为空的时候使用服务独立的线程池，否则在共享线程池中调度
+    explicit Executor(std::shared_ptr<Service> service_impl,
+                      std::shared_ptr<ExecutorPool> executor_pool = std::shared_ptr<ExecutorPool>()) :
         service_impl_(service_impl),
-        rpc_queue_(),
+        rpc_queues_(),
+        opcode_priority_(),
+        priority_weight_sum_(0),
+        priority_seq_(0),
+        batch_size_(1),
+        sleepers_(0),
+        park_lock_(),
+        park_notify_(),
+        executor_pool_(executor_pool),
+        schedule_slots_(),
+        schedule_weight_(1),
+        overload_rejected_(0),
+        overload_dropped_(0),
+        expired_count_(0),
+        limiter_(),
+        inflight_(0),
+        completed_count_(0),
+        completed_latency_us_(0),
+        inline_opcodes_(),
+        coalescer_(),
+        cache_(),
         conf_lock_(),
-        conf_({ }) {
+        conf_({ }),
+        busy_us_(0),
+        wait_us_(0),
+        executed_count_(0),
+        executed_batch_count_(0),
+        executing_(0),
+        autoscale_lock_(),
+        autoscale_log_(),
+        autoscale_last_busy_us_(0),
+        autoscale_last_wait_us_(0),
+        autoscale_last_executed_(0),
+        autoscale_last_tp_(std::chrono::steady_clock::now()),
+        autoscale_scale_up_tp_(),
+        autoscale_scale_down_tp_() {
     }
 
-    void handle_RPC(std::shared_ptr<RpcInstance> rpc_instance)override {
-        rpc_queue_.PUSH(rpc_instance);
+    void handle_RPC(std::shared_ptr<RpcInstance> rpc_instance)override;
+
+    // 共享线程池模式下，由工作线程调用处理排队的请求
+    void run_scheduled(int64_t budget_us)override;
+
+    int schedule_weight()override {
+        return schedule_weight_.load(std::memory_order_relaxed);
     }
 
-    std::string instance_name() {
+    std::string instance_name()override {
         return service_impl_->instance_name();
     }
 
+    void invalidate_response_cache(uint16_t opcode, const std::string& payload)override;
+
     bool init();
     int module_runtime(const libconfig::Config& conf);
     int module_status(std::string& module, std::string& name, std::string& val);
 
 private:
     std::shared_ptr<Service> service_impl_;
-    roo::EQueue<std::shared_ptr<RpcInstance>> rpc_queue_;
+
+    // 每个优先级一个请求队列，下标0为高优先级
+    // 队列的实现由exec_queue_type配置，在init的时候创建，之后不再改变
+    enum { kPriorityHigh = 0, kPriorityNormal = 1, kPriorityLow = 2, kPriorityCount = 3 };
+    std::unique_ptr<RpcQueue<std::shared_ptr<RpcInstance>>> rpc_queues_[kPriorityCount];
+    std::atomic<uint64_t> priority_count_[kPriorityCount];
+
+    // 按照opcode配置的优先级，请求头只能在此基础上降低，init之后只读
+    std::map<uint16_t, int> opcode_priority_;
+    int priority_class(std::shared_ptr<RpcInstance>& rpc_instance) const;
+
+    // 加权调度的时候按照序号轮转选择优先出队的队列，严格优先级的时候
+    // priority_weight_sum_为0，总是从高优先级开始
+    int priority_weight_[kPriorityCount];
+    int priority_weight_sum_;
+    std::atomic<uint64_t> priority_seq_;
+
+    // 所有队列都为空的时候执行线程在这里休眠，入队的时候只有存在休眠的
+    // 线程才加锁唤醒
+    // 每次最多取出max_count个请求追加到batch，返回取出的数目
+    size_t try_dequeue(std::vector<std::shared_ptr<RpcInstance>>& batch, size_t max_count);
+    size_t dequeue(std::vector<std::shared_ptr<RpcInstance>>& batch, size_t max_count, uint64_t msec);
+    size_t queue_size();
+
+    // 执行线程每次最多取出的请求数目，可以动态更新
+    std::atomic<size_t> batch_size_;
+
+    std::atomic<int> sleepers_;
+    std::mutex park_lock_;
+    std::condition_variable park_notify_;
+
+    // 共享线程池，以及本服务当前占用的调度槽位，槽位上限为exec_thread_pool_size_hard
+    std::shared_ptr<ExecutorPool> executor_pool_;
+    ScheduleSlots schedule_slots_;
+    std::atomic<int> schedule_weight_;
+    void try_schedule();
+
+    // 因为队列过载被拒绝的新请求数目，以及被挤出的旧请求数目
+    std::atomic<uint64_t> overload_rejected_;
+    std::atomic<uint64_t> overload_dropped_;
+
+    // 出队的时候检查截止时间，已经过期的请求不再执行，剩余的请求多于一个的时候
+    // 交给服务的handle_RPC_batch处理
+    void execute_RPC(std::vector<std::shared_ptr<RpcInstance>>& batch);
+    std::atomic<uint64_t> expired_count_;
+
+    // 自适应并发限制，统计的是已经进入Executor还没有处理完成的请求
+    std::unique_ptr<ConcurrencyLimiter> limiter_;
+
+    // 进入Executor之后还没有答复的请求数目，以及已经答复的请求数目和累计延迟，
+    // 在请求答复的时候统计，支持处理函数异步完成的请求
+    void on_completion(RpcInstance& rpc_instance, RpcResponseStatus status);
+    std::atomic<int64_t>  inflight_;
+    std::atomic<uint64_t> completed_count_;
+    std::atomic<uint64_t> completed_latency_us_;
+
+    // 在io线程中直接执行的opcode，init之后map本身只读，降级只修改enabled_
+    struct InlineOpcode {
+        int64_t  budget_us_;
+        uint32_t demote_overruns_;
+        std::atomic<bool>     enabled_;
+        std::atomic<uint32_t> overruns_;
+        std::atomic<uint64_t> count_;
+    };
+    std::map<uint16_t, std::unique_ptr<InlineOpcode>> inline_opcodes_;
+    bool try_execute_inline(std::shared_ptr<RpcInstance>& rpc_instance);
+
+    // 合并相同的读请求，只在配置了exec_coalesce的时候创建
+    std::unique_ptr<RequestCoalescer> coalescer_;
+
+    // 经过缓存、inline和合并之后的请求进入并发限制和队列，合并的等待者
+    // 被提升为执行的请求时也从这里重新提交
+    void submit_RPC(std::shared_ptr<RpcInstance> rpc_instance);
+
+    // 答复缓存，只在配置了exec_cache的opcode的时候创建，命中的请求直接在io线程答复
+    std::unique_ptr<ResponseCache> cache_;
+    bool try_answer_from_cache(std::shared_ptr<RpcInstance>& rpc_instance);
 
 private:
     // 这个锁保护conf_使用的，因为使用频率不是很高，所以所有访问
@@ -70,6 +198,12 @@ public:
 
     int executor_start() {
 
+        if (executor_pool_) {
+            roo::log_warning("executor for host %s runs in shared pool %s.",
+                             instance_name().c_str(), executor_pool_->instance_name().c_str());
+            return 0;
+        }
+
         roo::log_warning("about to start executor for host %s ... ", instance_name().c_str());
         executor_threads_.start_threads();
         return 0;
@@ -77,6 +211,10 @@ public:
 
     int executor_stop_graceful() {
 
+        if (executor_pool_) {
+            return 0;
+        }
+
         roo::log_warning("about to stop executor for host %s ... ", instance_name().c_str());
         executor_threads_.graceful_stop_threads();
 
@@ -85,14 +223,40 @@ public:
 
     int executor_join() {
 
+        if (executor_pool_) {
+            return 0;
+        }
+
         roo::log_warning("about to join executor for host %s ... ", instance_name().c_str());
         executor_threads_.join_threads();
         return 0;
     }
 
 private:
-    // 根据rpc_queue_自动伸缩线程负载
+    // 根据工作线程的利用率和请求的排队时间自动伸缩线程，在定时器线程中执行，
+    // 创建和回收线程的开销不会落在请求处理的路径上
     void executor_threads_adjust(const boost::system::error_code& ec);
+
+    // 执行线程累计的处理时间、请求累计的排队时间、执行的请求数目和批次数目，
+    // 以及正在执行处理函数的线程数目
+    std::atomic<uint64_t> busy_us_;
+    std::atomic<uint64_t> wait_us_;
+    std::atomic<uint64_t> executed_count_;
+    std::atomic<uint64_t> executed_batch_count_;
+    std::atomic<int> executing_;
+
+    // 最近的伸缩决策记录，在module_status中输出
+    std::mutex autoscale_lock_;
+    std::deque<std::string> autoscale_log_;
+    void autoscale_record(const std::string& decision);
+
+    // 以下只在定时器线程中访问
+    uint64_t autoscale_last_busy_us_;
+    uint64_t autoscale_last_wait_us_;
+    uint64_t autoscale_last_executed_;
+    std::chrono::steady_clock::time_point autoscale_last_tp_;
+    std::chrono::steady_clock::time_point autoscale_scale_up_tp_;
+    std::chrono::steady_clock::time_point autoscale_scale_down_tp_;
 };
 
 } // end namespace tzrpc
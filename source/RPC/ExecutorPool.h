@@ -0,0 +1,93 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_EXECUTOR_POOL_H__
+#define __RPC_EXECUTOR_POOL_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <string>
+
+namespace tzrpc {
+
+// 可以被共享线程池调度的对象，每次被调度的时候处理若干个排队的请求
+class Schedulable {
+
+public:
+    Schedulable() = default;
+    virtual ~Schedulable() = default;
+
+    // budget_us大于0的时候表示本次调度可以使用的时间片，用完之后让出工作线程；
+    // 为0的时候由调度对象自己决定每次处理的请求数目
+    virtual void run_scheduled(int64_t budget_us) = 0;
+
+    // 公平调度的时候，时间片按照权重分配
+    virtual int schedule_weight() {
+        return 1;
+    }
+
+    virtual std::string instance_name() = 0;
+};
+
+
+// 记录某个服务当前在共享线程池中被调度的数目，通过上限来保证服务之间的隔离，
+// 一个繁忙的服务最多只能占用cap个工作线程
+class ScheduleSlots {
+
+public:
+    ScheduleSlots() :
+        scheduled_(0) {
+    }
+
+    bool acquire(int cap) {
+        int scheduled = scheduled_.load(std::memory_order_relaxed);
+        while (scheduled < cap) {
+            if (scheduled_.compare_exchange_weak(scheduled, scheduled + 1))
+                return true;
+        }
+        return false;
+    }
+
+    void release() {
+        --scheduled_;
+    }
+
+    int current() const {
+        return scheduled_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int> scheduled_;
+};
+
+
+// 多个服务共享的执行线程池
+class ExecutorPool {
+
+    __noncopyable__(ExecutorPool)
+
+public:
+    ExecutorPool() = default;
+    virtual ~ExecutorPool() = default;
+
+    virtual bool init(int thread_number) = 0;
+
+    // 可以在任意线程中调用，task在被执行之前必须保持有效
+    virtual void schedule(Schedulable* task) = 0;
+
+    virtual int pool_start() = 0;
+    virtual int pool_stop_graceful() = 0;
+    virtual int pool_join() = 0;
+
+    virtual std::string instance_name() = 0;
+    virtual int module_status(std::string& module, std::string& name, std::string& val) = 0;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_EXECUTOR_POOL_H__
@@ -0,0 +1,225 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_FAIR_RPC_QUEUE_H__
+#define __RPC_FAIR_RPC_QUEUE_H__
+
+#include <xtra_rhel.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <condition_variable>
+
+#include <RPC/RpcQueue.h>
+
+namespace tzrpc {
+
+// 按照请求来源公平出队的队列
+// 每个来源(连接或者客户端IP)有自己的子队列，有排队请求的来源组成一个轮转
+// 队列，出队的时候每个来源轮流取一个，这样一个连接灌入大量的请求也只会让
+// 自己的请求排队，其他客户端的请求延迟不受影响
+//
+// source_cap限制单个来源的排队数目，capacity限制总的排队数目，为0表示不限制
+// 总数超过限制的时候，drop_oldest策略从积压最多的来源中挤出最早的请求
+// 不支持LIFO策略
+template<typename T>
+class FairRpcQueue : public RpcQueue<T> {
+
+public:
+    using RpcQueue<T>::PUSH;
+    typedef std::function<uint64_t(const T&)> source_key_t;
+
+    FairRpcQueue(const source_key_t& source_key, size_t capacity = 0, size_t source_cap = 0,
+                 OverloadPolicy policy = OverloadPolicy::kRejectNew) :
+        source_key_(source_key),
+        capacity_(capacity),
+        source_cap_(source_cap),
+        policy_(policy),
+        lock_(),
+        item_notify_(),
+        sources_(),
+        active_(),
+        size_(0) {
+    }
+
+    PushResult PUSH(const T& t, T& evicted)override {
+
+        PushResult result = PushResult::kOK;
+        uint64_t key = source_key_(t);
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+
+            std::deque<T>& items = sources_[key];
+            bool active = !items.empty();
+
+            if (source_cap_ != 0 && items.size() >= source_cap_) {
+                if (policy_ == OverloadPolicy::kRejectNew) {
+                    if (items.empty())
+                        sources_.erase(key);
+                    return PushResult::kRejected;
+                }
+
+                evicted = std::move(items.front());
+                items.pop_front();
+                --size_;
+                result = PushResult::kEvicted;
+
+            } else if (capacity_ != 0 && size_ >= capacity_) {
+                if (policy_ == OverloadPolicy::kRejectNew) {
+                    if (items.empty())
+                        sources_.erase(key);
+                    return PushResult::kRejected;
+                }
+
+                if (evict_longest(key, evicted))
+                    active = false;
+                result = PushResult::kEvicted;
+            }
+
+            if (!active) {
+                active_.push_back(key);
+            }
+
+            items.push_back(t);
+            ++size_;
+        }
+
+        item_notify_.notify_one();
+        return result;
+    }
+
+    bool POP(T& t, uint64_t msec)override {
+
+        std::unique_lock<std::mutex> lock(lock_);
+
+        if (!wait_items(lock, msec))
+            return false;
+
+        pop_one(t);
+        return true;
+    }
+
+    size_t POP_BATCH(std::vector<T>& items, size_t max_count, uint64_t msec)override {
+
+        std::unique_lock<std::mutex> lock(lock_);
+
+        if (!wait_items(lock, msec))
+            return 0;
+
+        size_t count = 0;
+        T t;
+        while (count < max_count && size_ > 0) {
+            pop_one(t);
+            items.push_back(std::move(t));
+            ++count;
+        }
+
+        return count;
+    }
+
+    size_t SIZE()override {
+        std::lock_guard<std::mutex> lock(lock_);
+        return size_;
+    }
+
+    // 当前有排队请求的来源数目
+    size_t SOURCES() {
+        std::lock_guard<std::mutex> lock(lock_);
+        return active_.size();
+    }
+
+    std::string queue_type()override {
+        return "fair";
+    }
+
+private:
+
+    // 调用者持有lock_
+    bool wait_items(std::unique_lock<std::mutex>& lock, uint64_t msec) {
+
+        if (size_ == 0 && msec != 0) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+            while (size_ == 0) {
+                if (item_notify_.wait_until(lock, deadline) == std::cv_status::timeout)
+                    break;
+            }
+        }
+
+        return size_ > 0;
+    }
+
+    // 调用者持有lock_，而且队列非空
+    // 从轮转队列头部的来源取一个请求，该来源还有剩余的请求就排到轮转队列的尾部
+    void pop_one(T& t) {
+
+        uint64_t key = active_.front();
+        active_.pop_front();
+
+        auto iter = sources_.find(key);
+        t = std::move(iter->second.front());
+        iter->second.pop_front();
+        --size_;
+
+        if (iter->second.empty()) {
+            sources_.erase(iter);
+        } else {
+            active_.push_back(key);
+        }
+    }
+
+    // 调用者持有lock_，只在超过总容量的时候调用，来源数目通常不多
+    // 被挤空的来源从轮转队列中移除，如果就是正在入队的来源则保留子队列并返回true
+    bool evict_longest(uint64_t pushing_key, T& evicted) {
+
+        auto longest = sources_.end();
+        for (auto iter = sources_.begin(); iter != sources_.end(); ++iter) {
+            if (longest == sources_.end() || iter->second.size() > longest->second.size())
+                longest = iter;
+        }
+
+        evicted = std::move(longest->second.front());
+        longest->second.pop_front();
+        --size_;
+
+        if (longest->second.empty()) {
+            uint64_t key = longest->first;
+            for (auto iter = active_.begin(); iter != active_.end(); ++iter) {
+                if (*iter == key) {
+                    active_.erase(iter);
+                    break;
+                }
+            }
+
+            if (key == pushing_key)
+                return true;
+
+            sources_.erase(longest);
+        }
+
+        return false;
+    }
+
+    const source_key_t source_key_;
+    const size_t capacity_;
+    const size_t source_cap_;
+    const OverloadPolicy policy_;
+
+    std::mutex lock_;
+    std::condition_variable item_notify_;
+
+    std::unordered_map<uint64_t, std::deque<T>> sources_;
+    std::deque<uint64_t> active_;
+    size_t size_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_FAIR_RPC_QUEUE_H__
@@ -0,0 +1,191 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <sstream>
+
+#include <other/Log.h>
+
+#include <RPC/FairSharePool.h>
+
+namespace tzrpc {
+
+bool FairSharePool::init(int thread_number) {
+
+    SAFE_ASSERT(thread_number > 0 && quantum_us_ > 0);
+    if (thread_number <= 0 || quantum_us_ <= 0) {
+        roo::log_err("invalid thread_number %d, quantum_us %ld for executor pool %s.",
+                     thread_number, quantum_us_, instance_name_.c_str());
+        return false;
+    }
+
+    if (!pool_threads_.init_threads(
+            std::bind(&FairSharePool::pool_run, this, std::placeholders::_1), thread_number)) {
+        roo::log_err("FairSharePool::pool_run init task failed!");
+        return false;
+    }
+
+    roo::log_info("executor pool %s initialized with %d workers, quantum %ld us.",
+                  instance_name_.c_str(), thread_number, quantum_us_);
+    return true;
+}
+
+void FairSharePool::schedule(Schedulable* task) {
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        auto iter = flows_.find(task);
+        if (iter == flows_.end()) {
+            FlowStat& stat = flow_stats_[task->instance_name()];
+            stat.weight_ = task->schedule_weight();
+
+            Flow flow {};
+            flow.stat_ = &stat;
+            iter = flows_.emplace(task, flow).first;
+        }
+
+        // 服务已经在轮转队列中的时候只增加等待的槽位
+        if (iter->second.pending_++ == 0) {
+            ready_.push_back(task);
+        }
+    }
+
+    ++scheduled_count_;
+    notify_.notify_one();
+}
+
+Schedulable* FairSharePool::next_task(int64_t& budget_us) {
+
+    std::unique_lock<std::mutex> lock(lock_);
+
+    if (ready_.empty()) {
+        notify_.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    // 欠额的服务在本轮中只增加额度，然后排到队尾，直到额度为正才会被执行
+    // 每一轮都会增加额度，所以这里的循环次数是有限的
+    while (!ready_.empty()) {
+
+        Schedulable* task = ready_.front();
+        Flow& flow = flows_[task];
+
+        if (flow.turn_us_ <= 0) {
+            flow.deficit_us_ += task->schedule_weight() * quantum_us_;
+            if (flow.deficit_us_ <= 0) {
+                ++flow.stat_->skip_count_;
+                ready_.pop_front();
+                ready_.push_back(task);
+                continue;
+            }
+
+            flow.turn_us_ = flow.deficit_us_;
+            ++flow.stat_->visit_count_;
+        }
+
+        // 本轮的额度在等待的槽位之间平分，分出去的额度先从deficit_us_中扣除，
+        // 执行中的槽位不会让服务在下一轮重复得到额度
+        budget_us = std::max<int64_t>(flow.turn_us_ / flow.pending_, 1);
+        flow.turn_us_ -= budget_us;
+        flow.deficit_us_ -= budget_us;
+        --flow.pending_;
+        ++flow.running_;
+
+        // 每次只分出一个槽位然后排到队尾，和其他服务交替占用空闲的工作线程，
+        // 剩下的槽位继续使用本轮没有分完的额度
+        ready_.pop_front();
+        if (flow.pending_ > 0) {
+            ready_.push_back(task);
+        } else {
+            flow.turn_us_ = 0;
+        }
+
+        return task;
+    }
+
+    return nullptr;
+}
+
+void FairSharePool::pool_run(roo::ThreadObjPtr ptr) {
+
+    roo::log_warning("executor pool %s thread %#lx about to loop ...",
+                     instance_name_.c_str(), (long)pthread_self());
+
+    while (true) {
+
+        if (unlikely(ptr->status_ == roo::ThreadStatus::kTerminating)) {
+            roo::log_err("thread %#lx is about to terminating...", (long)pthread_self());
+            break;
+        }
+
+        // 线程启动
+        if (unlikely(ptr->status_ == roo::ThreadStatus::kSuspend)) {
+            ::usleep(1 * 1000 * 1000);
+            continue;
+        }
+
+        int64_t budget_us = 0;
+        Schedulable* task = next_task(budget_us);
+        if (!task) {
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        task->run_scheduled(budget_us);
+        int64_t cost_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        // 超出的部分作为欠额保留；服务没有等待和执行中的槽位说明它的队列已经
+        // 空了，和DRR一样清除额度，避免空闲的服务积累额度之后突发占满线程池。
+        // task在run_scheduled之后可能已经被销毁，这里只使用指针的值
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = flows_.find(task);
+        if (iter != flows_.end()) {
+            Flow& flow = iter->second;
+            flow.deficit_us_ += budget_us - cost_us;
+            flow.stat_->used_us_ += cost_us;
+            if (--flow.running_ == 0 && flow.pending_ == 0) {
+                flows_.erase(iter);
+            }
+        }
+    }
+
+    ptr->status_ = roo::ThreadStatus::kDead;
+    roo::log_warning("executor pool thread %#lx is about to terminate ... ", (long)pthread_self());
+
+    return;
+}
+
+
+int FairSharePool::module_status(std::string& module, std::string& name, std::string& val) {
+
+    module = "tzrpc";
+    name = "executor_pool_" + instance_name_;
+
+    std::stringstream ss;
+
+    ss << "\t" << "instance_name: " << instance_name_ << std::endl;
+    ss << "\t" << "scheduler: fair" << std::endl;
+    ss << "\t" << "worker_number: " << pool_threads_.get_pool_size() << std::endl;
+    ss << "\t" << "quantum_us: " << quantum_us_ << std::endl;
+    ss << "\t" << "scheduled_count: " << scheduled_count_.load() << std::endl;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    ss << "\t" << "pending_tasks: " << ready_.size() << std::endl;
+    ss << "\t" << "active_flows: " << flows_.size() << std::endl;
+    for (auto iter = flow_stats_.begin(); iter != flow_stats_.end(); ++iter) {
+        ss << "\t" << "flow_" << iter->first << ": "
+           << "weight " << iter->second.weight_ << ", "
+           << "visit_count " << iter->second.visit_count_ << ", "
+           << "skip_count " << iter->second.skip_count_ << ", "
+           << "used_us " << iter->second.used_us_ << std::endl;
+    }
+
+    val = ss.str();
+    return 0;
+}
+
+} // end namespace tzrpc
@@ -0,0 +1,119 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_FAIR_SHARE_POOL_H__
+#define __RPC_FAIR_SHARE_POOL_H__
+
+#include <xtra_rhel.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <condition_variable>
+
+#include <other/Log.h>
+#include <concurrency/ThreadPool.h>
+
+#include <RPC/ExecutorPool.h>
+
+namespace tzrpc {
+
+// 按照服务权重公平调度的共享线程池，使用基于执行时间的差额轮询(DRR)
+// 所有待调度的服务排成一个FIFO队列，每个服务最多出现一次，每次轮到某个
+// 服务的时候给它增加weight * quantum_us的额度。服务有多个调度槽位等待的
+// 时候，每次轮到只分出一个槽位，这一轮的额度在这些槽位之间平分，所以占用
+// 多个工作线程的服务得到的执行时间并不会更多。槽位在时间片用完之后让出
+// 工作线程，超出额度的执行时间计为欠额，在后续的轮次中扣除，这样处理开销
+// 大的服务不会因为请求数目相同而占用更多的工作线程时间。服务的所有槽位都
+// 完成之后清除它的额度
+class FairSharePool : public ExecutorPool {
+
+public:
+    FairSharePool(const std::string& instance_name, int64_t quantum_us) :
+        instance_name_(instance_name),
+        quantum_us_(quantum_us),
+        lock_(),
+        notify_(),
+        ready_(),
+        flows_(),
+        flow_stats_(),
+        scheduled_count_(0),
+        pool_threads_() {
+    }
+
+    ~FairSharePool() = default;
+
+    bool init(int thread_number)override;
+    void schedule(Schedulable* task)override;
+
+    int pool_start()override {
+        roo::log_warning("about to start executor pool %s ... ", instance_name_.c_str());
+        pool_threads_.start_threads();
+        return 0;
+    }
+
+    int pool_stop_graceful()override {
+        roo::log_warning("about to stop executor pool %s ... ", instance_name_.c_str());
+        pool_threads_.graceful_stop_threads();
+        notify_.notify_all();
+        return 0;
+    }
+
+    int pool_join()override {
+        roo::log_warning("about to join executor pool %s ... ", instance_name_.c_str());
+        pool_threads_.join_threads();
+        return 0;
+    }
+
+    std::string instance_name()override {
+        return instance_name_;
+    }
+
+    int module_status(std::string& module, std::string& name, std::string& val)override;
+
+private:
+
+    // 调度对象的累计统计，按照名字保存，调度对象被销毁之后仍然可以输出
+    struct FlowStat {
+        int      weight_;
+        uint64_t visit_count_;
+        uint64_t skip_count_;
+        uint64_t used_us_;
+    };
+
+    // 调度对象当前的额度，同一个服务的多个调度槽位共享
+    // 等待和执行中的槽位都完成之后删除，一次性的调度对象不会残留
+    struct Flow {
+        int64_t  deficit_us_;
+        int64_t  turn_us_;          // 本轮还没有分给槽位的额度
+        int      pending_;          // 等待执行的槽位
+        int      running_;          // 正在执行的槽位
+        FlowStat* stat_;
+    };
+
+    // 取出下一个可以执行的调度对象以及本次的时间片，没有任务的时候返回nullptr
+    Schedulable* next_task(int64_t& budget_us);
+
+    void pool_run(roo::ThreadObjPtr ptr);  // main task loop
+
+    const std::string instance_name_;
+    const int64_t quantum_us_;
+
+    std::mutex lock_;
+    std::condition_variable notify_;
+    std::deque<Schedulable*> ready_;
+    std::map<Schedulable*, Flow> flows_;
+    std::map<std::string, FlowStat> flow_stats_;
+
+    std::atomic<uint64_t> scheduled_count_;
+
+    roo::ThreadPool pool_threads_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_FAIR_SHARE_POOL_H__
@@ -0,0 +1,218 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_MPMC_QUEUE_H__
+#define __RPC_MPMC_QUEUE_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <RPC/RpcQueue.h>
+
+namespace tzrpc {
+
+// 有界的无锁多生产者多消费者环形队列，参考Dmitry Vyukov的bounded MPMC queue
+// 每个槽位带有一个序号，生产者和消费者通过CAS竞争各自的位置，序号用来判断
+// 槽位是否可写或者可读，正常路径上没有锁
+//
+// 消费者没有数据的时候先自旋一段时间，然后在条件变量上休眠，生产者只有在
+// 检测到有休眠的消费者时才加锁唤醒，所以在繁忙的时候PUSH不会触碰互斥锁
+// Executor不使用这里的休眠，没有休眠的消费者的时候PUSH只多一次原子读
+//
+// 环形队列只能从头部出队，所以不支持LIFO策略
+template<typename T>
+class MPMCQueue : public RpcQueue<T> {
+
+public:
+    using RpcQueue<T>::PUSH;
+
+    // capacity会向上调整为2的幂
+    explicit MPMCQueue(size_t capacity, OverloadPolicy policy = OverloadPolicy::kRejectNew) :
+        policy_(policy),
+        mask_(round_up(capacity) - 1),
+        cells_(new Cell[mask_ + 1]),
+        enqueue_pos_(0),
+        dequeue_pos_(0),
+        sleepers_(0),
+        park_lock_(),
+        park_notify_() {
+
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    PushResult PUSH(const T& t, T& evicted)override {
+
+        PushResult result = PushResult::kOK;
+
+        if (!try_push(t)) {
+            if (policy_ == OverloadPolicy::kRejectNew)
+                return PushResult::kRejected;
+
+            // 挤出最早的一个请求腾出位置，并发的情况下可能还是失败
+            if (!try_pop(evicted))
+                return PushResult::kRejected;
+            result = PushResult::kEvicted;
+
+            // 腾出的位置可能被其他生产者抢走，这时新请求和被挤出的请求都需要答复
+            if (!try_push(t))
+                return PushResult::kRejected;
+        }
+
+        // 和POP中先增加sleepers_再检查队列的顺序配合，保证不会丢失唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(park_lock_);
+            park_notify_.notify_one();
+        }
+
+        return result;
+    }
+
+    bool POP(T& t, uint64_t msec)override {
+
+        if (try_pop(t))
+            return true;
+
+        if (msec == 0)
+            return false;
+
+        // 请求通常是成串到达的，短暂自旋可以避免大部分的休眠和唤醒
+        for (int i = 0; i < kSpinCount; ++i) {
+            if (try_pop(t))
+                return true;
+            if (i >= kSpinCount / 2)
+                std::this_thread::yield();
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+
+        std::unique_lock<std::mutex> lock(park_lock_);
+        ++sleepers_;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool success = false;
+        while (!(success = try_pop(t))) {
+            if (park_notify_.wait_until(lock, deadline) == std::cv_status::timeout) {
+                success = try_pop(t);
+                break;
+            }
+        }
+
+        --sleepers_;
+        return success;
+    }
+
+    size_t SIZE()override {
+        size_t enqueue_pos = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t dequeue_pos = dequeue_pos_.load(std::memory_order_relaxed);
+        return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+    }
+
+    std::string queue_type()override {
+        return "mpmc";
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+
+    static const int kSpinCount = 64;
+
+    static size_t round_up(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    bool try_push(const T& t) {
+
+        Cell* cell = nullptr;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // 队列已满
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data_ = t;
+        cell->sequence_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& t) {
+
+        Cell* cell = nullptr;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // 队列为空
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        // 取走数据之后重置槽位，shared_ptr这类对象不会在队列中被延长生命周期
+        t = std::move(cell->data_);
+        cell->data_ = T();
+        cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    struct Cell {
+        std::atomic<size_t> sequence_;
+        T data_;
+    };
+
+    const OverloadPolicy policy_;
+
+    // 生产者和消费者的位置放在不同的cache line，避免相互干扰
+    char padding0_[64];
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    char padding1_[64];
+    std::atomic<size_t> enqueue_pos_;
+    char padding2_[64];
+    std::atomic<size_t> dequeue_pos_;
+    char padding3_[64];
+
+    std::atomic<int> sleepers_;
+    std::mutex park_lock_;
+    std::condition_variable park_notify_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_MPMC_QUEUE_H__
@@ -0,0 +1,177 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <sstream>
+
+#include <RPC/RpcInstance.h>
+#include <RPC/RequestCoalescer.h>
+
+namespace tzrpc {
+
+RequestCoalescer::RequestCoalescer(const std::vector<uint16_t>& opcodes, const resubmit_t& resubmit) :
+    opcodes_(opcodes.begin(), opcodes.end()),
+    resubmit_(resubmit),
+    lock_(),
+    inflight_(),
+    leader_count_(0),
+    waiter_count_(0),
+    requeue_count_(0),
+    expired_count_(0) {
+}
+
+bool RequestCoalescer::join(const std::shared_ptr<RpcInstance>& rpc_instance) {
+
+    // 每个Executor对应一个服务，所以只需要opcode和payload作为key
+    uint16_t opcode = rpc_instance->get_opcode();
+    std::string key(reinterpret_cast<const char*>(&opcode), sizeof(opcode));
+    key += rpc_instance->get_rpc_request_message().payload_;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        auto iter = inflight_.find(key);
+        if (iter != inflight_.end()) {
+            iter->second.push_back(rpc_instance);
+            ++waiter_count_;
+            return false;
+        }
+
+        inflight_[key];
+    }
+
+    // 请求还没有入队执行，在这里设置不会和答复竞争
+    ++leader_count_;
+    rpc_instance->add_response_hook(
+        std::bind(&RequestCoalescer::on_response, this, key, std::placeholders::_1, std::placeholders::_2));
+    return true;
+}
+
+void RequestCoalescer::on_response(const std::string& key, RpcResponseStatus status, const std::string& msg) {
+
+    std::vector<std::shared_ptr<RpcInstance>> waiters;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        auto iter = inflight_.find(key);
+        if (iter == inflight_.end()) {
+            return;
+        }
+
+        waiters.swap(iter->second);
+        inflight_.erase(iter);
+    }
+
+    if (waiters.empty()) {
+        return;
+    }
+
+    // 过载和超时是执行的请求自身的结果，等待者可能还有足够的时间
+    if (status == RpcResponseStatus::OVERLOADED || status == RpcResponseStatus::DEADLINE_EXCEEDED) {
+        requeue_waiters(key, waiters);
+        return;
+    }
+
+    // 正常的答复和服务返回的错误对所有相同的请求都一样，但是等待期间已经
+    // 过期的等待者和单独执行一样答复DEADLINE_EXCEEDED，调用者已经不再等待
+    for (auto iter = waiters.begin(); iter != waiters.end(); ++iter) {
+        if ((*iter)->is_expired()) {
+            ++expired_count_;
+            (*iter)->reject(RpcResponseStatus::DEADLINE_EXCEEDED);
+        } else if (status == RpcResponseStatus::OK) {
+            (*iter)->reply_rpc_message(msg);
+        } else {
+            (*iter)->reject(status);
+        }
+    }
+}
+
+void RequestCoalescer::requeue_waiters(const std::string& key, std::vector<std::shared_ptr<RpcInstance>>& waiters) {
+
+    typedef std::pair<std::string, std::vector<std::shared_ptr<RpcInstance>>> requeue_item_t;
+    static thread_local std::vector<requeue_item_t> pending;
+    static thread_local bool requeuing = false;
+
+    pending.emplace_back(key, std::move(waiters));
+    if (requeuing) {
+        return;
+    }
+
+    requeuing = true;
+    while (!pending.empty()) {
+        requeue_item_t item = std::move(pending.back());
+        pending.pop_back();
+        promote_waiters(item.first, item.second);
+    }
+    requeuing = false;
+}
+
+void RequestCoalescer::promote_waiters(const std::string& key, std::vector<std::shared_ptr<RpcInstance>>& waiters) {
+
+    std::vector<std::shared_ptr<RpcInstance>> alive;
+    for (auto iter = waiters.begin(); iter != waiters.end(); ++iter) {
+        if ((*iter)->is_expired()) {
+            ++expired_count_;
+            (*iter)->reject(RpcResponseStatus::DEADLINE_EXCEEDED);
+        } else {
+            alive.push_back(*iter);
+        }
+    }
+
+    if (alive.empty()) {
+        return;
+    }
+
+    std::shared_ptr<RpcInstance> leader;
+
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+
+        // 期间已经有新的相同请求开始执行，跟随它等待即可
+        auto iter = inflight_.find(key);
+        if (iter != inflight_.end()) {
+            iter->second.insert(iter->second.end(), alive.begin(), alive.end());
+            return;
+        }
+
+        leader = alive.front();
+        inflight_[key].assign(alive.begin() + 1, alive.end());
+    }
+
+    // 等待者还没有入队执行，在这里设置不会和答复竞争
+    ++requeue_count_;
+    leader->add_response_hook(
+        std::bind(&RequestCoalescer::on_response, this, key, std::placeholders::_1, std::placeholders::_2));
+    resubmit_(leader);
+}
+
+std::string RequestCoalescer::dump() {
+
+    std::stringstream ss;
+
+    uint64_t leader_count = leader_count_.load();
+    uint64_t waiter_count = waiter_count_.load();
+
+    ss << "\t" << "coalesce_opcodes: ";
+    for (auto iter = opcodes_.begin(); iter != opcodes_.end(); ++iter) {
+        ss << *iter << " ";
+    }
+    ss << std::endl;
+    ss << "\t" << "coalesce_executed_count: " << leader_count << std::endl;
+    ss << "\t" << "coalesce_waiter_count: " << waiter_count << std::endl;
+    ss << "\t" << "coalesce_requeue_count: " << requeue_count_.load() << std::endl;
+    ss << "\t" << "coalesce_expired_count: " << expired_count_.load() << std::endl;
+    ss << "\t" << "coalesce_collapse_ratio: "
+       << (leader_count > 0 ? static_cast<double>(leader_count + waiter_count) / leader_count : 0) << std::endl;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    ss << "\t" << "coalesce_inflight_keys: " << inflight_.size() << std::endl;
+
+    return ss.str();
+}
+
+} // end namespace tzrpc
@@ -0,0 +1,81 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_REQUEST_COALESCER_H__
+#define __RPC_REQUEST_COALESCER_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <RPC/RpcResponseMessage.h>
+
+namespace tzrpc {
+
+class RpcInstance;
+
+// 合并正在执行的相同请求(single-flight)
+// 同一个opcode、相同payload的请求已经在执行的时候，新的请求不再排队执行，
+// 而是挂在正在执行的请求上等待，执行的请求答复的时候把同样的答复内容转发给
+// 所有的等待者。只适用于没有副作用的读请求，所以需要按照opcode开启
+// 等待者的截止时间在执行的请求完成的时候检查，已经过期的等待者答复
+// DEADLINE_EXCEEDED，不转发执行的结果
+// 执行的请求因为自身的原因被拒绝(OVERLOADED、DEADLINE_EXCEEDED)的时候，
+// 这个结果不适用于等待者：已经过期的等待者答复DEADLINE_EXCEEDED，剩下的
+// 第一个等待者通过resubmit重新提交执行，其余的挂到它上面继续等待
+class RequestCoalescer {
+
+    __noncopyable__(RequestCoalescer)
+
+public:
+    typedef std::function<void(std::shared_ptr<RpcInstance>)> resubmit_t;
+
+    RequestCoalescer(const std::vector<uint16_t>& opcodes, const resubmit_t& resubmit);
+    ~RequestCoalescer() = default;
+
+    bool enabled(uint16_t opcode) const {
+        return opcodes_.find(opcode) != opcodes_.end();
+    }
+
+    // 返回true表示这个请求需要执行，返回false表示已经作为等待者挂到了
+    // 正在执行的相同请求上，调用者不需要再处理
+    bool join(const std::shared_ptr<RpcInstance>& rpc_instance);
+
+    std::string dump();
+
+private:
+    void on_response(const std::string& key, RpcResponseStatus status, const std::string& msg);
+
+    // 提升一个等待者重新执行，重新提交的请求可能被同步拒绝并再次进入
+    // on_response，这种情况下只追加到线程内的列表，由最外层循环处理，
+    // 避免等待者很多的时候递归过深
+    void requeue_waiters(const std::string& key, std::vector<std::shared_ptr<RpcInstance>>& waiters);
+    void promote_waiters(const std::string& key, std::vector<std::shared_ptr<RpcInstance>>& waiters);
+
+    // init之后只读
+    const std::set<uint16_t> opcodes_;
+    const resubmit_t resubmit_;
+
+    std::mutex lock_;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<RpcInstance>>> inflight_;
+
+    std::atomic<uint64_t> leader_count_;
+    std::atomic<uint64_t> waiter_count_;
+    std::atomic<uint64_t> requeue_count_;
+    std::atomic<uint64_t> expired_count_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_REQUEST_COALESCER_H__
@@ -0,0 +1,203 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <cstring>
+#include <sstream>
+#include <iterator>
+#include <functional>
+
+#include <RPC/ResponseCache.h>
+
+namespace tzrpc {
+
+// 除了key和答复内容之外，每个条目链表节点和索引的大致开销
+static const size_t kEntryOverhead = sizeof(std::string) * 2 + 128;
+
+ResponseCache::ResponseCache(const ResponseCacheConf& conf) :
+    conf_(conf),
+    shard_memory_limit_(0),
+    shards_(),
+    hit_count_(0),
+    miss_count_(0),
+    insert_count_(0),
+    evict_count_(0),
+    expire_count_(0),
+    invalidate_count_(0) {
+
+    int shard_count = conf_.shard_count_ > 0 ? conf_.shard_count_ : 1;
+    for (int i = 0; i < shard_count; ++i) {
+        std::unique_ptr<Shard> shard(new Shard());
+        shard->memory_ = 0;
+        shard->version_ = 0;
+        shards_.emplace_back(std::move(shard));
+    }
+
+    shard_memory_limit_ = static_cast<size_t>(conf_.memory_limit_ / shard_count);
+}
+
+std::string ResponseCache::make_key(uint16_t opcode, const std::string& payload) {
+    std::string key(reinterpret_cast<const char*>(&opcode), sizeof(opcode));
+    key += payload;
+    return key;
+}
+
+ResponseCache::Shard& ResponseCache::shard_of(const std::string& key) {
+    return *shards_[std::hash<std::string>()(key) % shards_.size()];
+}
+
+void ResponseCache::erase(Shard& shard, EntryList::iterator iter) {
+    shard.memory_ -= iter->memory_;
+    shard.index_.erase(iter->key_);
+    shard.lru_.erase(iter);
+}
+
+bool ResponseCache::lookup(uint16_t opcode, const std::string& payload, std::string& response, uint64_t& version) {
+
+    std::string key = make_key(opcode, payload);
+    Shard& shard = shard_of(key);
+
+    std::lock_guard<std::mutex> lock(shard.lock_);
+    version = shard.version_;
+
+    auto index = shard.index_.find(key);
+    if (index == shard.index_.end()) {
+        ++miss_count_;
+        return false;
+    }
+
+    EntryList::iterator iter = index->second;
+    if (std::chrono::steady_clock::now() >= iter->expire_) {
+        erase(shard, iter);
+        ++expire_count_;
+        ++miss_count_;
+        return false;
+    }
+
+    shard.lru_.splice(shard.lru_.begin(), shard.lru_, iter);
+    response = iter->response_;
+    ++hit_count_;
+    return true;
+}
+
+void ResponseCache::insert(uint16_t opcode, const std::string& payload, const std::string& response, uint64_t version) {
+
+    auto ttl = conf_.opcode_ttl_ms_.find(opcode);
+    if (ttl == conf_.opcode_ttl_ms_.end()) {
+        return;
+    }
+
+    std::string key = make_key(opcode, payload);
+    size_t memory = key.size() + response.size() + kEntryOverhead;
+    if (memory > shard_memory_limit_) {
+        return;
+    }
+
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.lock_);
+
+    // 请求执行期间发生过失效，答复可能是旧的数据
+    if (shard.version_ != version) {
+        return;
+    }
+
+    auto index = shard.index_.find(key);
+    if (index != shard.index_.end()) {
+        erase(shard, index->second);
+    }
+
+    while (!shard.lru_.empty() && shard.memory_ + memory > shard_memory_limit_) {
+        erase(shard, std::prev(shard.lru_.end()));
+        ++evict_count_;
+    }
+
+    Entry entry;
+    entry.key_ = key;
+    entry.response_ = response;
+    entry.memory_ = memory;
+    entry.expire_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(ttl->second);
+
+    shard.lru_.push_front(std::move(entry));
+    shard.index_[key] = shard.lru_.begin();
+    shard.memory_ += memory;
+    ++insert_count_;
+}
+
+void ResponseCache::invalidate(uint16_t opcode, const std::string& payload) {
+
+    std::string key = make_key(opcode, payload);
+    Shard& shard = shard_of(key);
+
+    std::lock_guard<std::mutex> lock(shard.lock_);
+    ++shard.version_;
+
+    auto index = shard.index_.find(key);
+    if (index != shard.index_.end()) {
+        erase(shard, index->second);
+        ++invalidate_count_;
+    }
+}
+
+void ResponseCache::invalidate(uint16_t opcode) {
+
+    for (size_t i = 0; i < shards_.size(); ++i) {
+
+        Shard& shard = *shards_[i];
+        std::lock_guard<std::mutex> lock(shard.lock_);
+        ++shard.version_;
+
+        for (auto iter = shard.lru_.begin(); iter != shard.lru_.end(); ) {
+            uint16_t entry_opcode = 0;
+            ::memcpy(&entry_opcode, iter->key_.data(), sizeof(entry_opcode));
+            if (entry_opcode != opcode) {
+                ++iter;
+                continue;
+            }
+
+            auto next = std::next(iter);
+            erase(shard, iter);
+            iter = next;
+            ++invalidate_count_;
+        }
+    }
+}
+
+std::string ResponseCache::dump() {
+
+    std::stringstream ss;
+
+    size_t memory = 0;
+    size_t entries = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        std::lock_guard<std::mutex> lock(shards_[i]->lock_);
+        memory += shards_[i]->memory_;
+        entries += shards_[i]->lru_.size();
+    }
+
+    uint64_t hit_count = hit_count_.load();
+    uint64_t miss_count = miss_count_.load();
+
+    ss << "\t" << "cache_opcodes: ";
+    for (auto iter = conf_.opcode_ttl_ms_.begin(); iter != conf_.opcode_ttl_ms_.end(); ++iter) {
+        ss << iter->first << "(" << iter->second << "ms) ";
+    }
+    ss << std::endl;
+    ss << "\t" << "cache_shards: " << shards_.size() << std::endl;
+    ss << "\t" << "cache_entries: " << entries << std::endl;
+    ss << "\t" << "cache_memory: " << memory << " / " << conf_.memory_limit_ << std::endl;
+    ss << "\t" << "cache_hit_count: " << hit_count << std::endl;
+    ss << "\t" << "cache_miss_count: " << miss_count << std::endl;
+    ss << "\t" << "cache_hit_rate: "
+       << (hit_count + miss_count > 0 ? static_cast<double>(hit_count) / (hit_count + miss_count) : 0) << std::endl;
+    ss << "\t" << "cache_insert_count: " << insert_count_.load() << std::endl;
+    ss << "\t" << "cache_evict_count: " << evict_count_.load() << std::endl;
+    ss << "\t" << "cache_expire_count: " << expire_count_.load() << std::endl;
+    ss << "\t" << "cache_invalidate_count: " << invalidate_count_.load() << std::endl;
+
+    return ss.str();
+}
+
+} // end namespace tzrpc
@@ -0,0 +1,102 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_RESPONSE_CACHE_H__
+#define __RPC_RESPONSE_CACHE_H__
+
+#include <xtra_rhel.h>
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tzrpc {
+
+struct ResponseCacheConf {
+    int     shard_count_;
+    int64_t memory_limit_;                    // 所有分片总的内存预算(字节)
+    std::map<uint16_t, int> opcode_ttl_ms_;   // 可以缓存的opcode以及答复的有效期
+};
+
+// 幂等读请求的答复缓存
+// 以opcode和请求内容作为key，每个Executor对应一个服务，所以不需要service_id。
+// 按照key的散列值分片，每个分片有自己的锁和LRU链表，内存超过分片预算之后
+// 淘汰最久没有访问的条目，过期的条目在访问的时候删除
+//
+// 请求未命中的时候记录分片的版本号，失效操作会增加版本号，这样失效之前已经
+// 开始执行的请求答复的时候不会把旧数据重新写回缓存
+class ResponseCache {
+
+    __noncopyable__(ResponseCache)
+
+public:
+    explicit ResponseCache(const ResponseCacheConf& conf);
+    ~ResponseCache() = default;
+
+    bool cacheable(uint16_t opcode) const {
+        return conf_.opcode_ttl_ms_.find(opcode) != conf_.opcode_ttl_ms_.end();
+    }
+
+    // 命中返回true并设置response，未命中的时候通过version返回分片的版本号，
+    // 插入的时候需要带上
+    bool lookup(uint16_t opcode, const std::string& payload, std::string& response, uint64_t& version);
+    void insert(uint16_t opcode, const std::string& payload, const std::string& response, uint64_t version);
+
+    // 服务在数据变更之后显式失效，不带payload的版本失效该opcode所有的条目
+    void invalidate(uint16_t opcode, const std::string& payload);
+    void invalidate(uint16_t opcode);
+
+    std::string dump();
+
+private:
+
+    struct Entry {
+        std::string key_;
+        std::string response_;
+        size_t      memory_;
+        std::chrono::steady_clock::time_point expire_;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    // 每个分片单独分配，并且在尾部填充，避免相邻分片的锁伪共享
+    struct Shard {
+        std::mutex lock_;
+        EntryList  lru_;      // 头部是最近访问的条目
+        std::unordered_map<std::string, EntryList::iterator> index_;
+        size_t     memory_;
+        uint64_t   version_;
+        char padding_[64];
+    };
+
+    static std::string make_key(uint16_t opcode, const std::string& payload);
+    Shard& shard_of(const std::string& key);
+
+    // 调用者持有shard的锁
+    void erase(Shard& shard, EntryList::iterator iter);
+
+    const ResponseCacheConf conf_;
+    size_t shard_memory_limit_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<uint64_t> hit_count_;
+    std::atomic<uint64_t> miss_count_;
+    std::atomic<uint64_t> insert_count_;
+    std::atomic<uint64_t> evict_count_;
+    std::atomic<uint64_t> expire_count_;
+    std::atomic<uint64_t> invalidate_count_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_RESPONSE_CACHE_H__
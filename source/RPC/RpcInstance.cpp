@@ -11,6 +11,16 @@
 
 namespace tzrpc {
 
+RpcInstance::~RpcInstance() {
+
+    // 没有答复就释放了，同样认为请求已经结束
+    complete(RpcResponseStatus::SYSTEM_ERROR, "");
+
+    if (memory_stat_) {
+        MemoryAccountant::instance().release(*memory_stat_, MemoryType::kQueued, msg_size_);
+    }
+}
+
 bool RpcInstance::validate_request() {
 
     if (request_.get_length() < sizeof(RpcRequestHeader)) {
@@ -31,6 +41,11 @@ bool RpcInstance::validate_request() {
 
     service_id_ = header.service_id;
     opcode_ = header.opcode;
+    priority_ = header.priority;
+
+    if (header.timeout_ms > 0) {
+        deadline_ = start_ + std::chrono::milliseconds(header.timeout_ms);
+    }
 
     std::string msg_str;
     request_.consume(msg_str, msg_size_ - sizeof(RpcRequestHeader));
@@ -46,10 +61,28 @@ bool RpcInstance::validate_request() {
 }
 
 
+void RpcInstance::complete(RpcResponseStatus status, const std::string& msg) {
+
+    if (completed_.exchange(true)) {
+        return;
+    }
+
+    if (completion_hook_) {
+        completion_hook_(*this, status);
+    }
+
+    for (auto iter = response_hooks_.begin(); iter != response_hooks_.end(); ++iter) {
+        (*iter)(status, msg);
+    }
+}
+
 void RpcInstance::reply_rpc_message(const std::string& msg) {
 
+    complete(RpcResponseStatus::OK, msg);
+
     RpcResponseMessage rpc_response_message(service_id_, opcode_, msg);
     Message net_msg(rpc_response_message.net_str());
+    net_msg.header_.call_id = call_id_;
 
     auto sock = full_socket_.lock();
     if (!sock) {
@@ -63,8 +96,11 @@ void RpcInstance::reply_rpc_message(const std::string& msg) {
 
 void RpcInstance::reject(RpcResponseStatus status) {
 
+    complete(status, "");
+
     RpcResponseMessage rpc_response_message(status);
     Message net_msg(rpc_response_message.net_str());
+    net_msg.header_.call_id = call_id_;
 
     auto sock = full_socket_.lock();
     if (!sock) {
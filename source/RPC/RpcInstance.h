@@ -8,7 +8,12 @@
 #ifndef __RPC_INSTANCE_H__
 #define __RPC_INSTANCE_H__
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <vector>
 
 #include <Core/Buffer.h>
 #include <Network/TcpConnAsync.h>
@@ -18,20 +23,43 @@
 
 namespace tzrpc {
 
+class RpcInstance;
+
+// 请求完成(答复或者放弃答复)时候的回调，每个请求只会调用一次
+// status为答复的状态，没有答复就释放的请求为SYSTEM_ERROR
+typedef std::function<void(RpcInstance&, RpcResponseStatus)> completion_hook_t;
+
+// 请求完成时候的答复内容，status为OK的时候msg为答复的业务数据
+typedef std::function<void(RpcResponseStatus, const std::string& msg)> response_hook_t;
+
 class RpcInstance {
 public:
-    RpcInstance(const std::string& str_request, std::shared_ptr<TcpConnAsync> socket, int msg_size) :
-        start_(::time(NULL)),
+    RpcInstance(const std::string& str_request, std::shared_ptr<TcpConnAsync> socket, int msg_size,
+                uint32_t call_id = 0) :
+        start_(std::chrono::steady_clock::now()),
+        execute_start_(),
+        deadline_(std::chrono::steady_clock::time_point::max()),
         full_socket_(socket),
         request_(str_request),
         rpc_request_message_(),
         response_(),
         rpc_response_message_(),
         msg_size_(msg_size),
+        memory_stat_(socket ? socket->memory_stat() : std::shared_ptr<ConnMemoryStat>()),
+        conn_key_(reinterpret_cast<uintptr_t>(socket.get())),
+        ip_key_(socket ? socket->remote_ip_key() : 0),
+        call_id_(call_id),
         service_id_(-1),
-        opcode_(-1) {
+        opcode_(-1),
+        priority_(kRpcPriorityDefault),
+        deferred_(false),
+        completed_(false),
+        completion_hook_(),
+        response_hooks_() {
     }
 
+    ~RpcInstance();
+
     bool validate_request();
 
     void reply_rpc_message(const std::string& msg);
@@ -40,6 +68,34 @@ public:
     // 返回业务相关的错误
     void return_biz_error();
 
+    // 异步完成:
+    // 处理函数调用defer()之后可以不答复直接返回，只要保留rpc_instance的
+    // shared_ptr，之后在任意线程调用reply_rpc_message或者reject完成请求，
+    // 执行线程不需要等待，可以继续处理其他的请求
+    void defer() {
+        deferred_ = true;
+    }
+
+    bool is_deferred() const {
+        return deferred_.load();
+    }
+
+    bool is_completed() const {
+        return completed_.load();
+    }
+
+    // 由Executor设置，用于在请求真正完成的时候统计延迟和并发，
+    // 如果RpcInstance释放的时候还没有答复，也会在析构的时候调用
+    void set_completion_hook(const completion_hook_t& hook) {
+        completion_hook_ = hook;
+    }
+
+    // 需要拿到答复内容的观察者，比如合并相同请求的时候把答复转发给等待者，
+    // 以及缓存答复内容，需要在请求入队执行之前添加
+    void add_response_hook(const response_hook_t& hook) {
+        response_hooks_.push_back(hook);
+    }
+
 
     uint16_t get_service_id() {
         return service_id_;
@@ -49,12 +105,72 @@ public:
         return opcode_;
     }
 
+    uint16_t get_priority() {
+        return priority_;
+    }
+
+    // 请求来源的标识，Executor按照来源公平调度的时候使用
+    uint64_t get_conn_key() const {
+        return conn_key_;
+    }
+
+    uint64_t get_ip_key() const {
+        return ip_key_;
+    }
+
     RpcRequestMessage& get_rpc_request_message() {
         return rpc_request_message_;
     }
 
+    // 客户端在请求头中携带了超时时间，从服务端收到请求的时刻开始计算截止时间，
+    // 这样不依赖客户端和服务端的时钟同步
+    bool has_deadline() const {
+        return deadline_ != std::chrono::steady_clock::time_point::max();
+    }
+
+    bool is_expired() const {
+        return has_deadline() && std::chrono::steady_clock::now() >= deadline_;
+    }
+
+    // 处理函数可以根据剩余时间决定是否继续耗时的操作，没有截止时间返回int64_t最大值
+    int64_t remaining_ms() const {
+        if (!has_deadline())
+            return std::numeric_limits<int64_t>::max();
+
+        auto remain = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline_ - std::chrono::steady_clock::now()).count();
+        return remain > 0 ? remain : 0;
+    }
+
+    // 请求到达之后经过的时间
+    int64_t elapsed_ms() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    }
+
+    int64_t elapsed_us() const {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    }
+
+    // 由Executor在调用处理函数之前设置，区分排队时间和执行时间
+    void mark_execute_start() {
+        execute_start_ = std::chrono::steady_clock::now();
+    }
+
+    // 处理函数开始执行之后经过的时间，还没有开始执行的请求返回-1
+    int64_t execute_elapsed_us() const {
+        if (execute_start_ == std::chrono::steady_clock::time_point())
+            return -1;
+
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - execute_start_).count();
+    }
+
 private:
-    time_t start_;  // 请求创建的时间
+    std::chrono::steady_clock::time_point start_;     // 请求创建的时间
+    std::chrono::steady_clock::time_point execute_start_;  // 开始执行的时间
+    std::chrono::steady_clock::time_point deadline_;  // 请求的截止时间
     std::weak_ptr<TcpConnAsync> full_socket_; // 可能socket提前在网络层已经释放了
 
     Buffer request_;
@@ -65,10 +181,28 @@ private:
 
     const int msg_size_;
 
+    // 排队请求所占用的内存，在RpcInstance释放的时候归还
+    std::shared_ptr<ConnMemoryStat> memory_stat_;
+
+    const uint64_t conn_key_;
+    const uint64_t ip_key_;
+
+    // 客户端在网络报文头中携带的关联ID，答复的时候原样带回，
+    // 这样多路复用的客户端可以乱序匹配答复
+    const uint32_t call_id_;
+
 private:
     // these detail info were extract from request
     uint16_t service_id_;
     uint16_t opcode_;
+    uint16_t priority_;
+
+    void complete(RpcResponseStatus status, const std::string& msg);
+
+    std::atomic<bool> deferred_;
+    std::atomic<bool> completed_;
+    completion_hook_t completion_hook_;
+    std::vector<response_hook_t> response_hooks_;
 };
 
 } // end namespace tzrpc
@@ -0,0 +1,226 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_RPC_QUEUE_H__
+#define __RPC_RPC_QUEUE_H__
+
+#include <xtra_rhel.h>
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <condition_variable>
+
+namespace tzrpc {
+
+// 队列满了之后的处理策略
+enum class OverloadPolicy : uint8_t {
+    kRejectNew  = 0,   // 拒绝新的请求
+    kDropOldest = 1,   // 丢弃最早排队的请求，接收新的请求
+    kLIFO       = 2,   // 队列积压超过阈值之后后进先出，满了之后丢弃最早的请求
+};
+
+static inline bool parse_overload_policy(const std::string& str, OverloadPolicy& policy) {
+    if (str == "reject_new") {
+        policy = OverloadPolicy::kRejectNew;
+    } else if (str == "drop_oldest") {
+        policy = OverloadPolicy::kDropOldest;
+    } else if (str == "lifo") {
+        policy = OverloadPolicy::kLIFO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static inline std::string overload_policy_str(OverloadPolicy policy) {
+    switch (policy) {
+        case OverloadPolicy::kRejectNew:
+            return "reject_new";
+        case OverloadPolicy::kDropOldest:
+            return "drop_oldest";
+        case OverloadPolicy::kLIFO:
+            return "lifo";
+    }
+    return "unknown";
+}
+
+enum class PushResult : uint8_t {
+    kOK       = 0,
+    kRejected = 1,   // 新的元素没有入队
+    kEvicted  = 2,   // 新的元素已经入队，但是挤出了一个旧的元素
+};
+
+
+// Executor请求队列的接口，io线程PUSH，执行线程POP
+// 接口的命名和roo::EQueue保持一致，方便替换
+template<typename T>
+class RpcQueue {
+
+    __noncopyable__(RpcQueue)
+
+public:
+    RpcQueue() = default;
+    virtual ~RpcQueue() = default;
+
+    // 被挤出的元素通过evicted返回，由调用者负责答复
+    // 注意返回kRejected的时候evicted也可能被设置，调用者需要检查evicted
+    virtual PushResult PUSH(const T& t, T& evicted) = 0;
+
+    bool PUSH(const T& t) {
+        T evicted;
+        return PUSH(t, evicted) != PushResult::kRejected;
+    }
+
+    // 最多等待msec毫秒，0表示不等待
+    // Executor有多个优先级队列，总是以msec为0调用，队列都为空的时候在自己的
+    // 条件变量上休眠；队列内部的等待只给单独使用队列的场合(测试、benchmark)
+    virtual bool POP(T& t, uint64_t msec) = 0;
+
+    // 批量出队，最多取出max_count个追加到items，只有第一个元素会等待msec毫秒，
+    // 返回实际取出的数目。默认逐个调用POP，具体的队列可以实现得更高效
+    virtual size_t POP_BATCH(std::vector<T>& items, size_t max_count, uint64_t msec) {
+
+        size_t count = 0;
+        T t;
+        while (count < max_count && POP(t, count == 0 ? msec : 0)) {
+            items.push_back(std::move(t));
+            ++count;
+        }
+        return count;
+    }
+
+    // 只是一个近似值，用于统计和线程伸缩的判断
+    virtual size_t SIZE() = 0;
+
+    virtual std::string queue_type() = 0;
+};
+
+
+// 互斥锁加条件变量的队列，capacity为0表示不限制长度
+// 支持所有的过载策略，LIFO模式下排队超过lifo_depth之后从尾部取请求，
+// 这样过载的时候优先服务新到达的请求，而不是让所有请求都等到超时
+template<typename T>
+class MutexRpcQueue : public RpcQueue<T> {
+
+public:
+    using RpcQueue<T>::PUSH;
+
+    MutexRpcQueue(size_t capacity = 0,
+                  OverloadPolicy policy = OverloadPolicy::kRejectNew, size_t lifo_depth = 0) :
+        capacity_(capacity),
+        policy_(policy),
+        lifo_depth_(lifo_depth),
+        lock_(),
+        item_notify_(),
+        items_() {
+    }
+
+    PushResult PUSH(const T& t, T& evicted)override {
+
+        PushResult result = PushResult::kOK;
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+
+            if (capacity_ != 0 && items_.size() >= capacity_) {
+                if (policy_ == OverloadPolicy::kRejectNew)
+                    return PushResult::kRejected;
+
+                evicted = std::move(items_.front());
+                items_.pop_front();
+                result = PushResult::kEvicted;
+            }
+
+            items_.push_back(t);
+        }
+
+        item_notify_.notify_one();
+        return result;
+    }
+
+    bool POP(T& t, uint64_t msec)override {
+
+        std::unique_lock<std::mutex> lock(lock_);
+
+        if (items_.empty()) {
+            if (msec == 0)
+                return false;
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+            while (items_.empty()) {
+                if (item_notify_.wait_until(lock, deadline) == std::cv_status::timeout)
+                    break;
+            }
+
+            if (items_.empty())
+                return false;
+        }
+
+        pop_one(t);
+        return true;
+    }
+
+    // 一次加锁取出多个请求，减少执行线程和io线程之间的锁竞争
+    size_t POP_BATCH(std::vector<T>& items, size_t max_count, uint64_t msec)override {
+
+        std::unique_lock<std::mutex> lock(lock_);
+
+        if (items_.empty() && msec != 0) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msec);
+            while (items_.empty()) {
+                if (item_notify_.wait_until(lock, deadline) == std::cv_status::timeout)
+                    break;
+            }
+        }
+
+        size_t count = 0;
+        T t;
+        while (count < max_count && !items_.empty()) {
+            pop_one(t);
+            items.push_back(std::move(t));
+            ++count;
+        }
+
+        return count;
+    }
+
+    size_t SIZE()override {
+        std::lock_guard<std::mutex> lock(lock_);
+        return items_.size();
+    }
+
+    std::string queue_type()override {
+        return "mutex";
+    }
+
+private:
+    // 调用者持有lock_，而且队列非空
+    void pop_one(T& t) {
+        if (policy_ == OverloadPolicy::kLIFO && items_.size() > lifo_depth_) {
+            t = std::move(items_.back());
+            items_.pop_back();
+        } else {
+            t = std::move(items_.front());
+            items_.pop_front();
+        }
+    }
+
+    const size_t capacity_;
+    const OverloadPolicy policy_;
+    const size_t lifo_depth_;
+
+    std::mutex lock_;
+    std::condition_variable item_notify_;
+    std::deque<T> items_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_RPC_QUEUE_H__
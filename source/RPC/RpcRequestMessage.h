@@ -20,6 +20,12 @@ namespace tzrpc {
 const uint16_t kRpcHeaderMagic      = 0x7472;
 const uint16_t kRpcHeaderVersion    = 0x01;
 
+// 请求头中的优先级，0表示客户端没有指定，由服务端按照opcode的配置决定
+const uint16_t kRpcPriorityDefault  = 0;
+const uint16_t kRpcPriorityHigh     = 1;
+const uint16_t kRpcPriorityNormal   = 2;
+const uint16_t kRpcPriorityLow      = 3;
+
 
 // Message已经能保证RPC的消息被完整的接收了，所以这边不需要保存msg的长度了
 struct RpcRequestHeader {
@@ -29,13 +35,14 @@ struct RpcRequestHeader {
     uint16_t service_id;
     uint16_t opcode;
 
-    uint32_t rev1;          // 当前保留空间，后续升级使用
-    uint32_t rev2;
+    uint32_t timeout_ms;    // 客户端剩余的超时时间，0表示没有超时限制
+    uint16_t priority;      // 请求的优先级
+    uint16_t rev2;          // 当前保留空间，后续升级使用
 
     std::string dump() const {
-        char msg[64]{};
-        snprintf(msg, sizeof(msg), "rpc_request_header mgc:%0x, ver:%0x, sid:%0x, opd:%0x ",
-                 magic, version, service_id, opcode);
+        char msg[96]{};
+        snprintf(msg, sizeof(msg), "rpc_request_header mgc:%0x, ver:%0x, sid:%0x, opd:%0x, tmo:%u, pri:%u ",
+                 magic, version, service_id, opcode, timeout_ms, priority);
         return msg;
     }
 
@@ -45,6 +52,8 @@ struct RpcRequestHeader {
         version = be16toh(version);
         service_id = be16toh(service_id);
         opcode  = be16toh(opcode);
+        timeout_ms = be32toh(timeout_ms);
+        priority = be16toh(priority);
     }
 
     void to_net_endian() {
@@ -52,6 +61,8 @@ struct RpcRequestHeader {
         version = htobe16(version);
         service_id = htobe16(service_id);
         opcode  = htobe16(opcode);
+        timeout_ms = htobe32(timeout_ms);
+        priority = htobe16(priority);
     }
 
 } __attribute__((__packed__));
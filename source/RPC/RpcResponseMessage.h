@@ -38,6 +38,12 @@ enum class RpcResponseStatus : uint8_t {
     INVALID_REQUEST = 4,
 
     SYSTEM_ERROR    = 5,
+
+    // 服务端请求队列过载，请求没有被处理，客户端应当退避之后再重试
+    OVERLOADED      = 6,
+
+    // 请求在队列中等待超过了客户端的超时时间，没有被处理
+    DEADLINE_EXCEEDED = 7,
 };
 
 // Message已经能保证RPC的消息被完整的接收了，所以这边不需要保存msg的长度了
@@ -9,11 +9,17 @@
 #define __RPC_SERVICE_H__
 
 
+#include <map>
 #include <memory>
+#include <vector>
 #include <string>
 
 #include <scaffold/Setting.h>
 
+#include <RPC/RpcQueue.h>
+#include <RPC/ConcurrencyLimiter.h>
+#include <RPC/ResponseCache.h>
+
 // real rpc should implement this interface class
 
 namespace tzrpc {
@@ -24,10 +30,51 @@ class RpcInstance;
 // 简短的结构体，用来从DetailExecutor传递配置信息到Executor
 // 因为主机相关的信息是在DetailExecutor中解析的
 
+// 线程自动伸缩的参数，利用率是工作线程执行请求的时间占比
+struct ExecutorAutoscaleConf {
+    double scale_up_utilization_;
+    double scale_down_utilization_;
+    int    scale_up_queue_wait_ms_;     // 平均排队时间超过这个值也会扩容
+    int    scale_up_max_step_;          // 每次扩容最多增加的线程数目
+    int    scale_up_cooldown_sec_;
+    int    scale_down_cooldown_sec_;
+};
+
 struct ExecutorConf {
     int exec_thread_number_;
     int exec_thread_number_hard_;  // 允许最大的线程数目
-    int exec_thread_step_size_;
+    int exec_thread_step_size_;    // 每排队这么多请求至少增加一个线程，0表示不自动伸缩
+    ExecutorAutoscaleConf exec_autoscale_conf_;
+
+    std::string exec_queue_type_;  // mutex、mpmc或者fair
+    int exec_queue_capacity_;      // 每个优先级队列的容量，mutex和fair队列可以为0表示不限制
+    OverloadPolicy exec_queue_policy_;
+    int exec_queue_lifo_depth_;    // LIFO策略下，排队超过这个深度之后后进先出
+    std::string exec_queue_fair_key_;  // fair队列区分来源的方式: connection或者ip
+    int exec_queue_source_cap_;        // fair队列中单个来源最多排队的请求数目，0表示不限制
+    int exec_batch_size_;          // 执行线程每次最多取出的请求数目
+    int exec_weight_;              // 在公平调度的共享线程池中的权重
+
+    // 请求没有指定优先级的时候，按照opcode配置的优先级入队
+    std::map<uint16_t, uint16_t> exec_opcode_priority_;
+    bool exec_priority_strict_;        // 严格优先级，否则按照权重调度
+    int  exec_priority_weights_[3];    // 高、普通、低三个优先级的权重
+
+    // 在io线程中直接执行的opcode，单次执行超过budget的次数达到demote_overruns
+    // 之后降级回到执行线程池中执行
+    std::vector<uint16_t> exec_inline_opcodes_;
+    int exec_inline_budget_us_;
+    int exec_inline_demote_overruns_;
+
+    // 合并正在执行的相同请求的opcode，只能配置没有副作用的读请求
+    std::vector<uint16_t> exec_coalesce_opcodes_;
+
+    // 幂等读请求的答复缓存，没有配置opcode的时候不开启
+    ResponseCacheConf exec_cache_conf_;
+
+    // 自适应并发限制，开启之后超过限制的请求在分发的时候答复OVERLOADED
+    bool exec_limiter_enable_;
+    ConcurrencyLimiterConf exec_limiter_conf_;
 };
 
 
@@ -40,8 +87,21 @@ public:
 
     // 根据opCode分发rpc请求的处理
     virtual void handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) = 0;
+
+    // 执行线程一次取出多个请求的时候调用，服务可以重载来合并加锁和存储访问，
+    // 每个请求仍然需要单独答复。默认逐个调用handle_RPC
+    virtual void handle_RPC_batch(std::vector<std::shared_ptr<RpcInstance>>& rpc_instances) {
+        for (auto iter = rpc_instances.begin(); iter != rpc_instances.end(); ++iter) {
+            handle_RPC(*iter);
+        }
+    }
+
     virtual std::string instance_name() = 0;
 
+    // 数据变更之后失效对应的答复缓存，payload为空表示失效该opcode所有的条目
+    virtual void invalidate_response_cache(uint16_t opcode, const std::string& payload) {
+    }
+
     virtual bool init() = 0;
 
     virtual ExecutorConf get_executor_conf() = 0;
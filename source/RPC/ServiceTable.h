@@ -0,0 +1,76 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_SERVICE_TABLE_H__
+#define __RPC_SERVICE_TABLE_H__
+
+#include <stdlib.h>
+
+#include <cinttypes>
+#include <cstring>
+#include <map>
+#include <memory>
+
+namespace tzrpc {
+
+class Service;
+
+// 按照service_id直接索引的路由表，在请求路径上只做一次数组访问，不需要
+// 查找map和拷贝shared_ptr。表中保存的是裸指针，Service对象的生命周期
+// 由Dispatcher::services_保证，表本身构建之后不再修改
+// 数组按照cache line对齐分配，常用的少量服务会落在同一个cache line中
+class ServiceTable {
+
+public:
+    explicit ServiceTable(const std::map<uint16_t, std::shared_ptr<Service>>& services) :
+        size_(0),
+        slots_(nullptr) {
+
+        if (services.empty())
+            return;
+
+        // std::map是有序的，最后一个元素就是最大的service_id
+        uint32_t size = static_cast<uint32_t>(services.rbegin()->first) + 1;
+        void* ptr = nullptr;
+        if (::posix_memalign(&ptr, kCacheLineSize, size * sizeof(Service*)) != 0)
+            return;
+
+        slots_ = static_cast<Service**>(ptr);
+        ::memset(slots_, 0, size * sizeof(Service*));
+        for (auto iter = services.begin(); iter != services.end(); ++iter) {
+            slots_[iter->first] = iter->second.get();
+        }
+        size_ = size;
+    }
+
+    ~ServiceTable() {
+        ::free(slots_);
+    }
+
+    ServiceTable(const ServiceTable&) = delete;
+    ServiceTable& operator=(const ServiceTable&) = delete;
+
+    Service* find(uint16_t service_id) const {
+        if (service_id >= size_)
+            return nullptr;
+        return slots_[service_id];
+    }
+
+    uint32_t size() const {
+        return size_;
+    }
+
+private:
+    static const size_t kCacheLineSize = 64;
+
+    uint32_t size_;
+    Service** slots_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_SERVICE_TABLE_H__
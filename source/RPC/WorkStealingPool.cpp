@@ -0,0 +1,176 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#include <sstream>
+
+#include <other/Log.h>
+
+#include <RPC/WorkStealingPool.h>
+
+namespace tzrpc {
+
+// 工作线程所属的线程池和自己的队列索引，非工作线程的local_pool为空
+static thread_local const WorkStealingPool* local_pool = nullptr;
+static thread_local size_t local_index = 0;
+
+// 外部线程投递任务时选择队列使用的简单随机数
+static inline size_t fast_random() {
+    static thread_local uint64_t seed = reinterpret_cast<uint64_t>(&seed) ^ static_cast<uint64_t>(::time(NULL));
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return static_cast<size_t>(seed);
+}
+
+bool WorkStealingPool::init(int thread_number) {
+
+    SAFE_ASSERT(thread_number > 0);
+    if (thread_number <= 0) {
+        roo::log_err("invalid thread_number %d for executor pool %s.", thread_number, instance_name_.c_str());
+        return false;
+    }
+
+    for (int i = 0; i < thread_number; ++i) {
+        workers_.emplace_back(new Worker());
+    }
+
+    if (!pool_threads_.init_threads(
+            std::bind(&WorkStealingPool::pool_run, this, std::placeholders::_1), thread_number)) {
+        roo::log_err("WorkStealingPool::pool_run init task failed!");
+        return false;
+    }
+
+    roo::log_info("executor pool %s initialized with %d workers.", instance_name_.c_str(), thread_number);
+    return true;
+}
+
+void WorkStealingPool::schedule(Schedulable* task) {
+
+    size_t index = (local_pool == this) ? local_index : fast_random() % workers_.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->lock_);
+        workers_[index]->tasks_.push_back(task);
+    }
+
+    ++pending_;
+    ++scheduled_count_;
+
+    if (idle_.load() > 0) {
+        std::lock_guard<std::mutex> lock(park_lock_);
+        park_notify_.notify_one();
+    }
+}
+
+// 本地队列按照LIFO的方式取，刚产生的任务数据更可能还在cache中
+Schedulable* WorkStealingPool::pop_local(size_t index) {
+
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.lock_);
+    if (worker.tasks_.empty())
+        return nullptr;
+
+    Schedulable* task = worker.tasks_.back();
+    worker.tasks_.pop_back();
+    return task;
+}
+
+// 从其他队列的头部窃取，从随机的位置开始遍历，避免都去窃取同一个队列
+Schedulable* WorkStealingPool::steal(size_t index) {
+
+    size_t count = workers_.size();
+    size_t start = fast_random() % count;
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (victim == index)
+            continue;
+
+        Worker& worker = *workers_[victim];
+        std::lock_guard<std::mutex> lock(worker.lock_);
+        if (worker.tasks_.empty())
+            continue;
+
+        Schedulable* task = worker.tasks_.front();
+        worker.tasks_.pop_front();
+        ++stolen_count_;
+        return task;
+    }
+
+    return nullptr;
+}
+
+void WorkStealingPool::pool_run(roo::ThreadObjPtr ptr) {
+
+    local_pool = this;
+    local_index = next_index_++ % workers_.size();
+
+    roo::log_warning("executor pool %s worker %lu thread %#lx about to loop ...",
+                     instance_name_.c_str(), local_index, (long)pthread_self());
+
+    while (true) {
+
+        if (unlikely(ptr->status_ == roo::ThreadStatus::kTerminating)) {
+            roo::log_err("thread %#lx is about to terminating...", (long)pthread_self());
+            break;
+        }
+
+        // 线程启动
+        if (unlikely(ptr->status_ == roo::ThreadStatus::kSuspend)) {
+            ::usleep(1 * 1000 * 1000);
+            continue;
+        }
+
+        Schedulable* task = pop_local(local_index);
+        if (!task) {
+            task = steal(local_index);
+        }
+
+        if (task) {
+            --pending_;
+            task->run_scheduled(0);
+            continue;
+        }
+
+        // 没有任务可以执行，进入休眠
+        // 先增加idle_再检查pending_，和schedule中先增加pending_再检查idle_配合，
+        // 保证不会丢失唤醒
+        std::unique_lock<std::mutex> lock(park_lock_);
+        ++idle_;
+        if (pending_.load() <= 0) {
+            park_notify_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        --idle_;
+    }
+
+    ptr->status_ = roo::ThreadStatus::kDead;
+    roo::log_warning("executor pool thread %#lx is about to terminate ... ", (long)pthread_self());
+
+    return;
+}
+
+
+int WorkStealingPool::module_status(std::string& module, std::string& name, std::string& val) {
+
+    module = "tzrpc";
+    name = "executor_pool_" + instance_name_;
+
+    std::stringstream ss;
+
+    ss << "\t" << "instance_name: " << instance_name_ << std::endl;
+    ss << "\t" << "scheduler: work_stealing" << std::endl;
+    ss << "\t" << "worker_number: " << workers_.size() << std::endl;
+    ss << "\t" << "idle_worker_number: " << idle_.load() << std::endl;
+    ss << "\t" << "pending_tasks: " << pending_.load() << std::endl;
+    ss << "\t" << "scheduled_count: " << scheduled_count_.load() << std::endl;
+    ss << "\t" << "stolen_count: " << stolen_count_.load() << std::endl;
+
+    val = ss.str();
+    return 0;
+}
+
+} // end namespace tzrpc
@@ -0,0 +1,108 @@
+/*-
+ * Copyright (c) 2019 TAO Zhijiang<taozhijiang@gmail.com>
+ *
+ * Licensed under the BSD-3-Clause license, see LICENSE for full information.
+ *
+ */
+
+#ifndef __RPC_WORK_STEALING_POOL_H__
+#define __RPC_WORK_STEALING_POOL_H__
+
+#include <xtra_rhel.h>
+
+#include <deque>
+#include <vector>
+#include <condition_variable>
+
+#include <other/Log.h>
+#include <concurrency/ThreadPool.h>
+
+#include <RPC/ExecutorPool.h>
+
+namespace tzrpc {
+
+// 工作窃取的共享线程池
+// 每个工作线程有自己的任务队列，工作线程自己产生的任务放回本地队列，
+// io线程等外部线程随机选择一个工作线程投递，空闲的工作线程从其他
+// 工作线程的队列头部窃取任务
+class WorkStealingPool : public ExecutorPool {
+
+public:
+    explicit WorkStealingPool(const std::string& instance_name) :
+        instance_name_(instance_name),
+        workers_(),
+        next_index_(0),
+        pending_(0),
+        idle_(0),
+        park_lock_(),
+        park_notify_(),
+        scheduled_count_(0),
+        stolen_count_(0),
+        pool_threads_() {
+    }
+
+    ~WorkStealingPool() = default;
+
+    bool init(int thread_number)override;
+    void schedule(Schedulable* task)override;
+
+    int pool_start()override {
+        roo::log_warning("about to start executor pool %s ... ", instance_name_.c_str());
+        pool_threads_.start_threads();
+        return 0;
+    }
+
+    int pool_stop_graceful()override {
+        roo::log_warning("about to stop executor pool %s ... ", instance_name_.c_str());
+        pool_threads_.graceful_stop_threads();
+        park_notify_.notify_all();
+        return 0;
+    }
+
+    int pool_join()override {
+        roo::log_warning("about to join executor pool %s ... ", instance_name_.c_str());
+        pool_threads_.join_threads();
+        return 0;
+    }
+
+    std::string instance_name()override {
+        return instance_name_;
+    }
+
+    int module_status(std::string& module, std::string& name, std::string& val)override;
+
+private:
+
+    // 各个工作线程的队列单独分配，并且在尾部填充，避免相邻队列的锁伪共享
+    struct Worker {
+        std::mutex lock_;
+        std::deque<Schedulable*> tasks_;
+        char padding_[64];
+    };
+
+    Schedulable* pop_local(size_t index);
+    Schedulable* steal(size_t index);
+
+    void pool_run(roo::ThreadObjPtr ptr);  // main task loop
+
+    const std::string instance_name_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_index_;
+
+    // 所有工作队列中的任务总数，以及休眠中的工作线程数目
+    // 投递任务的时候只有检测到有线程休眠才需要加锁唤醒
+    std::atomic<int64_t> pending_;
+    std::atomic<int> idle_;
+    std::mutex park_lock_;
+    std::condition_variable park_notify_;
+
+    std::atomic<uint64_t> scheduled_count_;
+    std::atomic<uint64_t> stolen_count_;
+
+    roo::ThreadPool pool_threads_;
+};
+
+} // end namespace tzrpc
+
+#endif // __RPC_WORK_STEALING_POOL_H__
@@ -0,0 +1,122 @@
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <Client/include/RpcClient.h>
+
+#include "FakeServer.h"
+
+using namespace tzrpc_client;
+
+TEST(BatchCallTest, BatchTest) {
+
+    FakeServer server;
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = server.port();
+    RpcClient client(setting);
+
+    std::vector<RpcBatchRequest> requests;
+    for (int i = 0; i < 1000; ++i) {
+        requests.emplace_back(1, 2, "nicol-" + std::to_string(i));
+    }
+
+    // 结果和请求的顺序一一对应
+    std::vector<RpcCallResult> results;
+    ASSERT_THAT(client.call_RPC_batch(requests, results, std::chrono::seconds(3)), Eq(RpcClientStatus::OK));
+    ASSERT_THAT(results.size(), Eq(requests.size()));
+    for (size_t i = 0; i < results.size(); ++i) {
+        ASSERT_THAT(results[i].status_, Eq(RpcClientStatus::OK));
+        ASSERT_THAT(results[i].respload_, Eq(requests[i].payload_));
+    }
+    ASSERT_THAT(server.request_count_.load(), Eq(1000));
+
+    ASSERT_THAT(client.call_RPC_batch(std::vector<RpcBatchRequest>(), results), Eq(RpcClientStatus::OK));
+    ASSERT_TRUE(results.empty());
+}
+
+TEST(BatchCallTest, AutoBatchTest) {
+
+    FakeServer server;
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = server.port();
+    setting.batch_window_us_ = 2000;
+    setting.batch_max_calls_ = 16;
+    RpcClient client(setting);
+
+    // 100个请求按照16个一组发送，剩下的4个在窗口结束的时候发送
+    std::vector<std::future<RpcCallResult>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(client.call_RPC_future(1, 2, "nicol-" + std::to_string(i), std::chrono::seconds(3)));
+    }
+
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_THAT(futures[i].wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+        RpcCallResult result = futures[i].get();
+        ASSERT_THAT(result.status_, Eq(RpcClientStatus::OK));
+        ASSERT_THAT(result.respload_, Eq("nicol-" + std::to_string(i)));
+    }
+}
+
+TEST(BatchCallTest, FreshClientAutoBatchTest) {
+
+    FakeServer server;
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = server.port();
+    setting.connect_timeout_ms_ = 0;
+    setting.batch_window_us_ = 2000;
+    setting.batch_max_calls_ = 16;
+    RpcClient client(setting);
+
+    // 新的客户端还没有连接，窗口结束的时候在io_service线程中发送，
+    // 请求在连接建立期间排队，不能阻塞io_service线程等待连接
+    std::vector<std::future<RpcCallResult>> futures;
+    for (int i = 0; i < 4; ++i) {
+        futures.push_back(client.call_RPC_future(1, 2, "nicol-" + std::to_string(i), std::chrono::seconds(3)));
+    }
+
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_THAT(futures[i].wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+        RpcCallResult result = futures[i].get();
+        ASSERT_THAT(result.status_, Eq(RpcClientStatus::OK));
+        ASSERT_THAT(result.respload_, Eq("nicol-" + std::to_string(i)));
+    }
+    ASSERT_THAT(server.request_count_.load(), Eq(4));
+}
+
+TEST(BatchCallTest, FreshClientConnectFailTest) {
+
+    uint16_t port = 0;
+    {
+        FakeServer server;
+        port = server.port();
+    }
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = port;
+    setting.connect_timeout_ms_ = 0;
+    setting.batch_window_us_ = 2000;
+    setting.batch_max_calls_ = 16;
+    RpcClient client(setting);
+
+    // 连接失败的时候排队的请求通过callback得到失败，不会一直等待
+    std::vector<std::future<RpcCallResult>> futures;
+    for (int i = 0; i < 4; ++i) {
+        futures.push_back(client.call_RPC_future(1, 2, "nicol-" + std::to_string(i)));
+    }
+
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_THAT(futures[i].wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+        ASSERT_THAT(futures[i].get().status_, Eq(RpcClientStatus::NETWORK_CONNECT_ERROR));
+    }
+}
@@ -0,0 +1,70 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <Client/CallTimer.h>
+
+using namespace tzrpc_client;
+
+class CallTimerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        work_.reset(new boost::asio::io_service::work(io_service_));
+        thread_ = std::thread([this]() { io_service_.run(); });
+        timer_ = std::make_shared<CallTimer>(io_service_);
+    }
+
+    void TearDown() override {
+        timer_->shutdown();
+        work_.reset();
+        io_service_.stop();
+        thread_.join();
+    }
+
+    boost::asio::io_service io_service_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    std::thread thread_;
+    std::shared_ptr<CallTimer> timer_;
+};
+
+TEST_F(CallTimerTest, ExpireInOrderTest) {
+
+    std::mutex lock;
+    std::vector<int> fired;
+
+    // 后添加的超时更早到期，需要重新设置底层的定时器
+    timer_->add(std::chrono::milliseconds(30), [&]() { std::lock_guard<std::mutex> l(lock); fired.push_back(30); });
+    timer_->add(std::chrono::milliseconds(20), [&]() { std::lock_guard<std::mutex> l(lock); fired.push_back(20); });
+    timer_->add(std::chrono::microseconds(5000), [&]() { std::lock_guard<std::mutex> l(lock); fired.push_back(5); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> l(lock);
+    ASSERT_THAT(fired, ElementsAre(5, 20, 30));
+    ASSERT_THAT(timer_->size(), Eq(0));
+}
+
+TEST_F(CallTimerTest, CancelTest) {
+
+    std::atomic<int> fired(0);
+
+    CallTimer::handle_t first = timer_->add(std::chrono::milliseconds(10), [&]() { ++fired; });
+    CallTimer::handle_t second = timer_->add(std::chrono::milliseconds(10), [&]() { ++fired; });
+    timer_->add(std::chrono::milliseconds(10), [&]() { ++fired; });
+
+    ASSERT_TRUE(timer_->cancel(first));
+    ASSERT_FALSE(timer_->cancel(first));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_THAT(fired.load(), Eq(2));
+
+    // 已经到期的超时不能再取消
+    ASSERT_FALSE(timer_->cancel(second));
+}
@@ -0,0 +1,149 @@
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <boost/asio.hpp>
+
+#include <Network/NetServer.h>
+#include <Network/TcpConnAsync.h>
+#include <RPC/Coroutine.h>
+#include <RPC/FairSharePool.h>
+
+using namespace tzrpc;
+
+// 只在 cmake -DBUILD_COROUTINE=ON 的时候编译这个测试
+
+struct StepTrace {
+    std::thread::id io_thread_;
+    std::thread::id pool_thread_;
+    int64_t slept_ms_;
+    std::string value_;
+};
+
+static RpcTask run_steps(boost::asio::io_service& io_service, ExecutorPool& pool,
+                         std::shared_ptr<AsyncValue<std::string>> input,
+                         std::shared_ptr<std::promise<StepTrace>> done) {
+
+    StepTrace trace;
+
+    co_await resume_on(io_service);
+    trace.io_thread_ = std::this_thread::get_id();
+
+    auto start = std::chrono::steady_clock::now();
+    co_await sleep_for(io_service, std::chrono::milliseconds(20));
+    trace.slept_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    co_await resume_on(pool);
+    trace.pool_thread_ = std::this_thread::get_id();
+
+    trace.value_ = co_await *input;
+    done->set_value(trace);
+}
+
+class CoroutineTest : public ::testing::Test {
+protected:
+    CoroutineTest() :
+        io_service_(),
+        work_(new boost::asio::io_service::work(io_service_)),
+        io_thread_(),
+        pool_("coroutine_test", 2000),
+        server_("coroutine_test") {
+    }
+
+    void SetUp()override {
+        io_thread_ = std::thread([this]() { io_service_.run(); });
+        ASSERT_TRUE(pool_.init(2));
+        pool_.pool_start();
+    }
+
+    void TearDown()override {
+        pool_.pool_stop_graceful();
+        pool_.pool_join();
+        work_.reset();
+        io_service_.stop();
+        io_thread_.join();
+    }
+
+    // 没有启动的连接，连接释放之后答复不会真正发送
+    std::shared_ptr<RpcInstance> make_instance() {
+
+        auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_service_);
+        auto conn = std::make_shared<TcpConnAsync>(socket, server_);
+
+        std::string str_request = RpcRequestMessage(0, 1, "nicol").net_str();
+        auto rpc_instance = std::make_shared<RpcInstance>(str_request, conn, str_request.size());
+        EXPECT_TRUE(rpc_instance->validate_request());
+        return rpc_instance;
+    }
+
+    boost::asio::io_service io_service_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    std::thread io_thread_;
+    FairSharePool pool_;
+    NetServer server_;
+};
+
+TEST_F(CoroutineTest, ResumeAndAwaitTest) {
+
+    auto input = std::make_shared<AsyncValue<std::string>>();
+    auto done = std::make_shared<std::promise<StepTrace>>();
+    std::future<StepTrace> future = done->get_future();
+
+    run_steps(io_service_, pool_, input, done);
+
+    // 协程在等待值的时候挂起，值在其他线程中设置之后继续执行
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_THAT(future.wait_for(std::chrono::milliseconds(0)), Eq(std::future_status::timeout));
+    input->set_value("nicol");
+
+    ASSERT_THAT(future.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    StepTrace trace = future.get();
+    ASSERT_THAT(trace.io_thread_, Eq(io_thread_.get_id()));
+    ASSERT_THAT(trace.pool_thread_, Ne(io_thread_.get_id()));
+    ASSERT_THAT(trace.pool_thread_, Ne(std::this_thread::get_id()));
+    ASSERT_THAT(trace.slept_ms_, Ge(20));
+    ASSERT_THAT(trace.value_, Eq("nicol"));
+
+    // 已经设置了值的时候不挂起，重复设置被忽略
+    auto ready = std::make_shared<AsyncValue<std::string>>();
+    ready->set_value("first");
+    ready->set_value("second");
+    auto done_ready = std::make_shared<std::promise<StepTrace>>();
+    std::future<StepTrace> future_ready = done_ready->get_future();
+    run_steps(io_service_, pool_, ready, done_ready);
+    ASSERT_THAT(future_ready.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    ASSERT_THAT(future_ready.get().value_, Eq("first"));
+}
+
+TEST_F(CoroutineTest, HandlerTest) {
+
+    auto status = std::make_shared<std::promise<RpcResponseStatus>>();
+    std::future<RpcResponseStatus> future = status->get_future();
+
+    std::shared_ptr<RpcInstance> rpc_instance = make_instance();
+    rpc_instance->add_response_hook([status](RpcResponseStatus code, const std::string& msg) {
+        status->set_value(code);
+    });
+
+    // 协程挂起之后处理函数就返回，未捕获的异常以SYSTEM_ERROR拒绝请求
+    boost::asio::io_service& io_service = io_service_;
+    auto handler = make_coroutine_handler([&io_service](std::shared_ptr<RpcInstance> rpc_instance) -> RpcTask {
+        co_await sleep_for(io_service, std::chrono::milliseconds(10));
+        throw std::runtime_error("handler failed");
+    });
+
+    handler(rpc_instance);
+    ASSERT_TRUE(rpc_instance->is_deferred());
+    ASSERT_FALSE(rpc_instance->is_completed());
+
+    ASSERT_THAT(future.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    ASSERT_THAT(future.get(), Eq(RpcResponseStatus::SYSTEM_ERROR));
+    ASSERT_TRUE(rpc_instance->is_completed());
+}
@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <RPC/FairSharePool.h>
+
+using namespace tzrpc;
+
+// 一直有请求积压的服务，每次调度把时间片用完，和Executor一样在有积压的
+// 时候继续持有槽位重新投递
+struct BusyService : public Schedulable {
+
+    BusyService(FairSharePool& pool, const std::string& name, int cap) :
+        pool_(pool), name_(name), cap_(cap), stop_(false), used_us_(0) {
+    }
+
+    void start() {
+        while (slots_.acquire(cap_)) {
+            pool_.schedule(this);
+        }
+    }
+
+    void run_scheduled(int64_t budget_us)override {
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(budget_us))
+            ;
+        used_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (!stop_) {
+            pool_.schedule(this);
+            return;
+        }
+        slots_.release();
+    }
+
+    std::string instance_name()override {
+        return name_;
+    }
+
+    FairSharePool& pool_;
+    const std::string name_;
+    const int cap_;
+    ScheduleSlots slots_;
+    std::atomic<bool> stop_;
+    std::atomic<int64_t> used_us_;
+};
+
+// 只调度一次，执行之后就被销毁
+struct OneShotTask : public Schedulable {
+
+    explicit OneShotTask(std::atomic<int>& done) :
+        done_(done) {
+    }
+
+    void run_scheduled(int64_t budget_us)override {
+        ++done_;
+        delete this;
+    }
+
+    std::string instance_name()override {
+        return "oneshot";
+    }
+
+    std::atomic<int>& done_;
+};
+
+TEST(FairSharePoolTest, UnequalCapTest) {
+
+    FairSharePool pool("fair_test", 2000);
+    ASSERT_TRUE(pool.init(2));
+    pool.pool_start();
+
+    // 权重相同，可以占用的槽位数目不同，执行时间仍然各占一半
+    BusyService wide(pool, "wide", 8);
+    BusyService narrow(pool, "narrow", 1);
+    wide.start();
+    narrow.start();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    wide.stop_ = true;
+    narrow.stop_ = true;
+    while (wide.slots_.current() > 0 || narrow.slots_.current() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    pool.pool_stop_graceful();
+    pool.pool_join();
+
+    double total = wide.used_us_ + narrow.used_us_;
+    std::cout << "wide " << wide.used_us_ << " us, narrow " << narrow.used_us_ << " us" << std::endl;
+    ASSERT_THAT(narrow.used_us_ / total, Gt(0.4));
+    ASSERT_THAT(wide.used_us_ / total, Gt(0.4));
+}
+
+TEST(FairSharePoolTest, OneShotTaskTest) {
+
+    FairSharePool pool("fair_test", 2000);
+    ASSERT_TRUE(pool.init(2));
+    pool.pool_start();
+
+    std::atomic<int> done(0);
+    for (int i = 0; i < 100; ++i) {
+        pool.schedule(new OneShotTask(done));
+    }
+
+    while (done < 100) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // 调度对象执行之后被销毁，不再保留它的额度，统计按照名字输出
+    std::string module, name, val;
+    for (int i = 0; i < 100; ++i) {
+        pool.module_status(module, name, val);
+        if (val.find("active_flows: 0") != std::string::npos)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_THAT(val, HasSubstr("active_flows: 0"));
+    ASSERT_THAT(val, HasSubstr("flow_oneshot"));
+
+    pool.pool_stop_graceful();
+    pool.pool_join();
+}
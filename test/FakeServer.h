@@ -0,0 +1,167 @@
+#ifndef __TEST_FAKE_SERVER_H__
+#define __TEST_FAKE_SERVER_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <Core/Message.h>
+#include <RPC/RpcRequestMessage.h>
+#include <RPC/RpcResponseMessage.h>
+
+// 本地的假服务端，原样返回请求内容并统计收到的请求数，delay_ms_可以模拟慢的实例
+// 负载为"delay:N"的请求在N毫秒之后单独答复，后面的请求不用等待，可以模拟乱序答复；
+// 负载为"close"的请求让服务端直接关闭这个连接
+class FakeServer {
+public:
+    // port为0的时候由系统分配，指定端口可以模拟服务端重启
+    explicit FakeServer(uint16_t port = 0) :
+        request_count_(0),
+        delay_ms_(0),
+        io_service_(),
+        acceptor_(io_service_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port)),
+        stop_(false) {
+        accept_thread_ = std::thread(std::bind(&FakeServer::accept_loop, this));
+    }
+
+    // 关闭服务端的连接，阻塞在读取上的服务线程退出
+    ~FakeServer() {
+        stop_ = true;
+
+        // 建立一个连接唤醒阻塞的accept
+        boost::system::error_code ignore_ec;
+        boost::asio::ip::tcp::socket socket(io_service_);
+        socket.connect(acceptor_.local_endpoint(), ignore_ec);
+        accept_thread_.join();
+        socket.close(ignore_ec);
+
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            for (auto iter = sockets_.begin(); iter != sockets_.end(); ++iter) {
+                (*iter)->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignore_ec);
+            }
+            for (auto iter = serve_threads_.begin(); iter != serve_threads_.end(); ++iter) {
+                iter->join();
+            }
+        }
+
+        // 服务线程都已经退出，不会再创建新的答复线程
+        for (auto iter = reply_threads_.begin(); iter != reply_threads_.end(); ++iter) {
+            iter->join();
+        }
+    }
+
+    uint16_t port() const {
+        return acceptor_.local_endpoint().port();
+    }
+
+    std::atomic<int> request_count_;
+    std::atomic<int> delay_ms_;
+
+private:
+    void accept_loop() {
+        while (!stop_) {
+            auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_service_);
+            boost::system::error_code ec;
+            acceptor_.accept(*socket, ec);
+            if (ec || stop_)
+                return;
+
+            // 和真实的服务端一样关闭Nagle，否则批量请求的答复会等待延迟确认
+            socket->set_option(boost::asio::ip::tcp::no_delay(true), ec);
+
+            std::lock_guard<std::mutex> lock(lock_);
+            sockets_.push_back(socket);
+            serve_threads_.emplace_back(std::bind(&FakeServer::serve, this, socket));
+        }
+    }
+
+    void serve(std::shared_ptr<boost::asio::ip::tcp::socket> socket) {
+
+        // 同一个连接上的答复可能来自不同的线程
+        auto write_lock = std::make_shared<std::mutex>();
+
+        while (true) {
+            tzrpc::Header header {};
+            boost::system::error_code ec;
+            boost::asio::read(*socket, boost::asio::buffer(&header, sizeof(tzrpc::Header)), ec);
+            if (ec)
+                return;
+            header.from_net_endian();
+
+            std::string payload(header.length, '\0');
+            boost::asio::read(*socket, boost::asio::buffer(&payload[0], payload.size()), ec);
+            if (ec)
+                return;
+
+            tzrpc::RpcRequestMessage request;
+            if (!tzrpc::RpcRequestMessageParse(payload, request))
+                return;
+
+            ++request_count_;
+
+            if (request.payload_ == "close") {
+                socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+                return;
+            }
+
+            if (delay_ms_ > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_.load()));
+            }
+
+            tzrpc::RpcResponseMessage response(request.header_.service_id, request.header_.opcode, request.payload_);
+            tzrpc::Message net_msg(response.net_str());
+            net_msg.header_.call_id = header.call_id;
+            std::string net_str = net_msg.net_str();
+
+            if (request.payload_.compare(0, 6, "delay:") == 0) {
+                int delay_ms = ::atoi(request.payload_.c_str() + 6);
+                std::lock_guard<std::mutex> lock(reply_lock_);
+                reply_threads_.emplace_back(std::bind(&FakeServer::delay_reply, this,
+                                                      socket, write_lock, net_str, delay_ms));
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(*write_lock);
+            boost::asio::write(*socket, boost::asio::buffer(net_str), ec);
+            if (ec)
+                return;
+        }
+    }
+
+    void delay_reply(std::shared_ptr<boost::asio::ip::tcp::socket> socket,
+                     std::shared_ptr<std::mutex> write_lock,
+                     const std::string& net_str, int delay_ms) {
+
+        // 分段等待，服务端析构的时候尽快退出
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms);
+        while (!stop_ && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        boost::system::error_code ignore_ec;
+        std::lock_guard<std::mutex> lock(*write_lock);
+        boost::asio::write(*socket, boost::asio::buffer(net_str), ignore_ec);
+    }
+
+    boost::asio::io_service io_service_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::atomic<bool> stop_;
+
+    std::thread accept_thread_;
+    std::mutex lock_;
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> sockets_;
+    std::vector<std::thread> serve_threads_;
+
+    std::mutex reply_lock_;
+    std::vector<std::thread> reply_threads_;
+};
+
+#endif // __TEST_FAKE_SERVER_H__
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <Client/HedgePolicy.h>
+#include <Client/include/RpcClient.h>
+
+#include "FakeServer.h"
+
+using namespace tzrpc_client;
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(HedgeTest, HedgePolicyTest) {
+
+    HedgePolicy policy(95, 5, 1000, { { 1, 2 } });
+    ASSERT_TRUE(policy.is_hedged(1, 2));
+    ASSERT_FALSE(policy.is_hedged(1, 3));
+
+    // 样本不足的时候不对冲
+    for (int i = 1; i < 32; ++i) {
+        policy.record_latency(1, 2, std::chrono::microseconds(i * 1000));
+    }
+    ASSERT_THAT(policy.hedge_delay(1, 2).count(), Eq(0));
+
+    for (int i = 32; i <= 64; ++i) {
+        policy.record_latency(1, 2, std::chrono::microseconds(i * 1000));
+    }
+    ASSERT_THAT(policy.hedge_delay(1, 2).count(), Ge(60 * 1000));
+    ASSERT_THAT(policy.hedge_delay(1, 2).count(), Le(64 * 1000));
+
+    // 每个请求积累5%个副本
+    int hedged = 0;
+    for (int i = 0; i < 1000; ++i) {
+        policy.record_request();
+        if (policy.try_acquire_budget()) {
+            ++hedged;
+        }
+    }
+    ASSERT_THAT(hedged, Eq(50));
+    ASSERT_THAT(policy.budget_denied_count(), Eq(950u));
+}
+
+class HedgeClientTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        setting_.endpoints_.push_back("127.0.0.1:" + std::to_string(fast_.port()));
+        setting_.endpoints_.push_back("127.0.0.1:" + std::to_string(slow_.port()));
+        setting_.serv_addr_ = "127.0.0.1";
+        setting_.serv_port_ = fast_.port();
+        setting_.hedge_percentile_ = 90;
+        setting_.hedge_min_delay_us_ = 5000;
+        setting_.hedge_opcodes_.emplace_back(1, 2);
+    }
+
+    // 两个实例都正常的时候积累延迟样本
+    void warm_up(RpcClient& client) {
+        for (int i = 0; i < 64; ++i) {
+            std::string respload;
+            ASSERT_THAT(client.call_RPC(1, 2, "nicol", respload, std::chrono::seconds(1)), Eq(RpcClientStatus::OK));
+        }
+    }
+
+    FakeServer fast_;
+    FakeServer slow_;
+    RpcClientSetting setting_;
+};
+
+TEST_F(HedgeClientTest, SlowReplicaTest) {
+
+    setting_.hedge_budget_percent_ = 100;
+    RpcClient client(setting_);
+    warm_up(client);
+
+    // 发往慢实例的请求在对冲延迟之后由另一个实例答复
+    slow_.delay_ms_ = 300;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20; ++i) {
+        auto call_start = std::chrono::steady_clock::now();
+        std::string respload;
+        ASSERT_THAT(client.call_RPC(1, 2, "nicol-" + std::to_string(i), respload, std::chrono::seconds(1)),
+                    Eq(RpcClientStatus::OK));
+        ASSERT_THAT(respload, Eq("nicol-" + std::to_string(i)));
+        ASSERT_THAT(elapsed_ms(call_start), Lt(150));
+    }
+    ASSERT_THAT(elapsed_ms(start), Lt(1000));
+
+    // 没有登记的opcode不对冲
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 2; ++i) {
+        std::string respload;
+        ASSERT_THAT(client.call_RPC(1, 3, "nicol", respload, std::chrono::seconds(1)), Eq(RpcClientStatus::OK));
+    }
+    ASSERT_THAT(elapsed_ms(start), Ge(300));
+}
+
+TEST_F(HedgeClientTest, BudgetTest) {
+
+    setting_.hedge_budget_percent_ = 0;
+    RpcClient client(setting_);
+    warm_up(client);
+
+    // 预算为0的时候不发送副本，只能等慢实例答复
+    slow_.delay_ms_ = 300;
+    int fast_count = fast_.request_count_;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 2; ++i) {
+        std::string respload;
+        ASSERT_THAT(client.call_RPC(1, 2, "nicol", respload, std::chrono::seconds(1)), Eq(RpcClientStatus::OK));
+    }
+    ASSERT_THAT(elapsed_ms(start), Ge(300));
+    ASSERT_THAT(fast_.request_count_.load(), Eq(fast_count + 1));
+}
+
+TEST_F(HedgeClientTest, DestroyWithInflightHedgeTest) {
+
+    setting_.hedge_budget_percent_ = 100;
+    std::unique_ptr<RpcClient> client(new RpcClient(setting_));
+    warm_up(*client);
+
+    // 没有超时的请求，快实例上的主请求先得到答复，发往慢实例的副本还在等待
+    slow_.delay_ms_ = 2000;
+    for (int i = 0; i < 4; ++i) {
+        std::string respload;
+        ASSERT_THAT(client->call_RPC(1, 2, "delay:50", respload, std::chrono::microseconds(0)),
+                    Eq(RpcClientStatus::OK));
+    }
+
+    // 析构的时候关闭进行中的副本的连接，不等待慢实例的答复
+    auto start = std::chrono::steady_clock::now();
+    client.reset();
+    ASSERT_THAT(elapsed_ms(start), Lt(1000));
+}
@@ -0,0 +1,151 @@
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <Client/LoadBalancer.h>
+#include <Client/include/RpcClient.h>
+
+#include "FakeServer.h"
+
+using namespace tzrpc;
+using namespace tzrpc_client;
+
+static EndpointList make_endpoints(size_t count) {
+    EndpointList endpoints;
+    for (size_t i = 0; i < count; ++i) {
+        endpoints.push_back(std::make_shared<Endpoint>("127.0.0.1", 9000 + i));
+    }
+    return endpoints;
+}
+
+TEST(LoadBalancerTest, EndpointParseTest) {
+
+    std::string addr;
+    uint16_t port = 0;
+
+    ASSERT_TRUE(Endpoint::parse("127.0.0.1:8434", addr, port));
+    ASSERT_THAT(addr, Eq("127.0.0.1"));
+    ASSERT_THAT(port, Eq(8434));
+
+    ASSERT_FALSE(Endpoint::parse("127.0.0.1", addr, port));
+    ASSERT_FALSE(Endpoint::parse("127.0.0.1:", addr, port));
+    ASSERT_FALSE(Endpoint::parse("127.0.0.1:70000", addr, port));
+    ASSERT_FALSE(Endpoint::parse("127.0.0.1:84x", addr, port));
+}
+
+TEST(LoadBalancerTest, RoundRobinTest) {
+
+    std::unique_ptr<LoadBalancer> balancer = LoadBalancer::create("round_robin");
+    ASSERT_TRUE(!!balancer);
+    ASSERT_FALSE(LoadBalancer::create("random"));
+
+    EndpointList endpoints = make_endpoints(3);
+    for (int i = 0; i < 300; ++i) {
+        balancer->pick(endpoints)->call_start();
+    }
+
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+        ASSERT_THAT(endpoints[i]->pick_count_.load(), Eq(100));
+    }
+}
+
+TEST(LoadBalancerTest, LeastOutstandingTest) {
+
+    std::unique_ptr<LoadBalancer> balancer = LoadBalancer::create("least_outstanding");
+    EndpointList endpoints = make_endpoints(3);
+
+    endpoints[0]->inflight_ = 5;
+    endpoints[1]->inflight_ = 2;
+    endpoints[2]->inflight_ = 7;
+
+    ASSERT_THAT(balancer->pick(endpoints), Eq(endpoints[1]));
+
+    // 并发相同的时候轮流选择
+    endpoints[1]->inflight_ = 5;
+    endpoints[2]->inflight_ = 5;
+    std::set<std::shared_ptr<Endpoint>> picked;
+    for (int i = 0; i < 3; ++i) {
+        picked.insert(balancer->pick(endpoints));
+    }
+    ASSERT_THAT(picked.size(), Eq(3));
+}
+
+TEST(LoadBalancerTest, P2CTest) {
+
+    std::unique_ptr<LoadBalancer> balancer = LoadBalancer::create("p2c");
+    EndpointList endpoints = make_endpoints(4);
+
+    // 一个实例明显变慢之后，几乎不会再被选中
+    for (int i = 0; i < 20; ++i) {
+        endpoints[0]->call_start();
+        endpoints[0]->call_finish(50 * 1000, true);
+        for (size_t j = 1; j < endpoints.size(); ++j) {
+            endpoints[j]->call_start();
+            endpoints[j]->call_finish(1000, true);
+        }
+    }
+
+    std::map<std::shared_ptr<Endpoint>, int> counts;
+    for (int i = 0; i < 3000; ++i) {
+        ++counts[balancer->pick(endpoints)];
+    }
+
+    ASSERT_THAT(counts[endpoints[0]], Eq(0));
+    for (size_t j = 1; j < endpoints.size(); ++j) {
+        ASSERT_THAT(counts[endpoints[j]], Gt(700));
+    }
+}
+
+
+TEST(LoadBalancerTest, MultiServerDistributionTest) {
+
+    std::vector<std::unique_ptr<FakeServer>> servers;
+    RpcClientSetting setting;
+    for (int i = 0; i < 3; ++i) {
+        servers.emplace_back(new FakeServer());
+        setting.endpoints_.push_back("127.0.0.1:" + std::to_string(servers.back()->port()));
+    }
+
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = servers[0]->port();
+    setting.pool_max_conns_ = 4;
+    setting.balance_policy_ = "least_outstanding";
+
+    RpcClient client(setting);
+
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 4; ++i) {
+        callers.emplace_back([&client]() {
+            for (int j = 0; j < 150; ++j) {
+                std::string respload;
+                ASSERT_THAT(client.call_RPC(1, 2, "nicol", respload), Eq(RpcClientStatus::OK));
+                ASSERT_THAT(respload, Eq("nicol"));
+            }
+        });
+    }
+    for (auto iter = callers.begin(); iter != callers.end(); ++iter) {
+        iter->join();
+    }
+
+    for (size_t i = 0; i < servers.size(); ++i) {
+        std::cout << "server " << i << " handled " << servers[i]->request_count_.load() << std::endl;
+        ASSERT_THAT(servers[i]->request_count_.load(), Gt(100));
+    }
+
+    // 移除一个实例之后，新的请求不会再发往这个实例
+    int removed_count = servers[2]->request_count_.load();
+    ASSERT_TRUE(client.update_endpoints({ setting.endpoints_[0], setting.endpoints_[1] }));
+    for (int j = 0; j < 100; ++j) {
+        std::string respload;
+        ASSERT_THAT(client.call_RPC(1, 2, "nicol", respload), Eq(RpcClientStatus::OK));
+    }
+    ASSERT_THAT(servers[2]->request_count_.load(), Eq(removed_count));
+}
@@ -50,3 +50,20 @@ TEST(MessageBufferTest, BufferTest) {
     ASSERT_THAT(store1, Eq(str2));
     ASSERT_THAT(buff.get_length(), 0);
 }
+
+TEST(MessageBufferTest, CallIdRoundTripTest) {
+
+    tzrpc::Message msg("nicol");
+    msg.header_.call_id = 0x01020304;
+
+    std::string net_str = msg.net_str();
+    ASSERT_THAT(net_str.size(), Eq(sizeof(Header) + 5));
+
+    struct Header head {};
+    ::memcpy(reinterpret_cast<char*>(&head), net_str.c_str(), sizeof(Header));
+    head.from_net_endian();
+
+    ASSERT_TRUE(head.magic == kHeaderMagic);
+    ASSERT_TRUE(head.length == 5);
+    ASSERT_TRUE(head.call_id == 0x01020304);
+}
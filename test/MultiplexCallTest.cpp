@@ -0,0 +1,132 @@
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <Client/include/RpcClient.h>
+
+#include "FakeServer.h"
+
+using namespace tzrpc_client;
+
+// 按照完成的顺序记录答复
+struct CallRecorder {
+    std::mutex lock_;
+    std::vector<std::string> order_;
+    std::vector<std::promise<RpcCallResult>> promises_;
+
+    explicit CallRecorder(size_t count) :
+        lock_(),
+        order_(),
+        promises_(count) {
+    }
+
+    rpc_callback_t callback(size_t index, const std::string& name) {
+        return [this, index, name](const RpcClientStatus status, const std::string& rsp) {
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                order_.push_back(name);
+            }
+            promises_[index].set_value(RpcCallResult(status, rsp));
+        };
+    }
+};
+
+TEST(MultiplexCallTest, OutOfOrderTest) {
+
+    FakeServer server;
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = server.port();
+    RpcClient client(setting);
+
+    CallRecorder recorder(3);
+    std::vector<std::future<RpcCallResult>> futures;
+    for (size_t i = 0; i < 3; ++i) {
+        futures.push_back(recorder.promises_[i].get_future());
+    }
+
+    // 三个请求在同一个连接上发出，答复按照服务端处理完成的顺序到达
+    ASSERT_THAT(client.call_RPC(1, 2, "delay:600", recorder.callback(0, "slow"), 3), Eq(RpcClientStatus::OK));
+    ASSERT_THAT(client.call_RPC(1, 2, "delay:200", recorder.callback(1, "medium"), 3), Eq(RpcClientStatus::OK));
+    ASSERT_THAT(client.call_RPC(1, 2, "fast", recorder.callback(2, "fast"), 3), Eq(RpcClientStatus::OK));
+
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_THAT(futures[i].wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    }
+
+    // 每个答复根据call_id交给发起它的请求
+    ASSERT_THAT(futures[0].get().respload_, Eq("delay:600"));
+    ASSERT_THAT(futures[1].get().respload_, Eq("delay:200"));
+    ASSERT_THAT(futures[2].get().respload_, Eq("fast"));
+    ASSERT_THAT(recorder.order_, ElementsAre("fast", "medium", "slow"));
+    ASSERT_THAT(server.request_count_.load(), Eq(3));
+}
+
+TEST(MultiplexCallTest, PerCallTimeoutTest) {
+
+    FakeServer server;
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = server.port();
+    RpcClient client(setting);
+
+    // 这个请求的答复超过了它自己的超时时间
+    std::future<RpcCallResult> timeout_future = client.call_RPC_future(1, 2, "delay:2500", 1);
+
+    // 超时等待期间同一个连接上的其他请求正常完成
+    std::vector<std::future<RpcCallResult>> futures;
+    for (int i = 0; i < 10; ++i) {
+        futures.push_back(client.call_RPC_future(1, 2, "nicol-" + std::to_string(i), 3));
+    }
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_THAT(futures[i].wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+        RpcCallResult result = futures[i].get();
+        ASSERT_THAT(result.status_, Eq(RpcClientStatus::OK));
+        ASSERT_THAT(result.respload_, Eq("nicol-" + std::to_string(i)));
+    }
+    ASSERT_THAT(timeout_future.wait_for(std::chrono::milliseconds(0)), Eq(std::future_status::timeout));
+
+    ASSERT_THAT(timeout_future.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    ASSERT_THAT(timeout_future.get().status_, Eq(RpcClientStatus::RPC_CALL_TIMEOUT));
+
+    // 超时之后连接仍然可用，迟到的答复被丢弃
+    std::future<RpcCallResult> after = client.call_RPC_future(1, 2, "after timeout", 3);
+    ASSERT_THAT(after.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    RpcCallResult result = after.get();
+    ASSERT_THAT(result.status_, Eq(RpcClientStatus::OK));
+    ASSERT_THAT(result.respload_, Eq("after timeout"));
+    ASSERT_THAT(server.request_count_.load(), Eq(12));
+}
+
+TEST(MultiplexCallTest, ServerCloseTest) {
+
+    FakeServer server;
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = server.port();
+    RpcClient client(setting);
+
+    // 没有设置超时的请求在服务端关闭连接的时候失败，不会一直等待
+    std::future<RpcCallResult> pending = client.call_RPC_future(1, 2, "delay:5000");
+    std::future<RpcCallResult> closing = client.call_RPC_future(1, 2, "close");
+
+    ASSERT_THAT(pending.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    ASSERT_THAT(pending.get().status_, Eq(RpcClientStatus::NETWORK_RECV_ERROR));
+    ASSERT_THAT(closing.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    ASSERT_THAT(closing.get().status_, Eq(RpcClientStatus::NETWORK_RECV_ERROR));
+
+    // 之后的调用重新建立连接
+    std::future<RpcCallResult> after = client.call_RPC_future(1, 2, "reconnect", 3);
+    ASSERT_THAT(after.wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+    RpcCallResult result = after.get();
+    ASSERT_THAT(result.status_, Eq(RpcClientStatus::OK));
+    ASSERT_THAT(result.respload_, Eq("reconnect"));
+}
@@ -0,0 +1,225 @@
+#include <sys/socket.h>
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <Client/ConnectBackoff.h>
+#include <Client/include/RpcClient.h>
+
+#include "FakeServer.h"
+
+using namespace tzrpc_client;
+
+// 取得一个当前没有监听的本地端口
+static uint16_t unused_port() {
+    FakeServer server;
+    return server.port();
+}
+
+static int64_t elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(ReconnectTest, ConnectBackoffTest) {
+
+    ConnectBackoff backoff(100, 1000);
+    ASSERT_FALSE(backoff.is_down());
+
+    // 间隔翻倍直到上限，实际等待在[间隔/2, 间隔]之间
+    int64_t intervals[] = { 100, 200, 400, 800, 1000, 1000 };
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i) {
+        int64_t delay = backoff.failed().count();
+        ASSERT_THAT(delay, Ge(intervals[i] / 2));
+        ASSERT_THAT(delay, Le(intervals[i]));
+    }
+
+    ASSERT_TRUE(backoff.is_down());
+    ASSERT_THAT(backoff.retry_after().count(), Gt(0));
+
+    backoff.succeeded();
+    ASSERT_FALSE(backoff.is_down());
+    ASSERT_THAT(backoff.retry_after().count(), Eq(0));
+}
+
+TEST(ReconnectTest, FastFailTest) {
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = unused_port();
+    setting.reconnect_initial_ms_ = 2000;
+    setting.reconnect_max_ms_ = 2000;
+    RpcClient client(setting);
+
+    // 第一次调用等待连接失败
+    std::future<RpcCallResult> first = client.call_RPC_future(1, 2, "nicol");
+    ASSERT_THAT(first.get().status_, Eq(RpcClientStatus::NETWORK_CONNECT_ERROR));
+
+    // 退避期间的调用不再尝试建立连接
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; ++i) {
+        std::future<RpcCallResult> future = client.call_RPC_future(1, 2, "nicol");
+        ASSERT_THAT(future.get().status_, Eq(RpcClientStatus::NETWORK_CONNECT_ERROR));
+
+        std::string respload;
+        ASSERT_THAT(client.call_RPC(1, 2, "nicol", respload), Eq(RpcClientStatus::NETWORK_CONNECT_ERROR));
+    }
+    ASSERT_THAT(elapsed_ms(start), Lt(100));
+}
+
+TEST(ReconnectTest, ReconnectQueueTest) {
+
+    uint16_t port = unused_port();
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = port;
+    setting.reconnect_initial_ms_ = 50;
+    setting.reconnect_max_ms_ = 100;
+    setting.reconnect_queue_size_ = 8;
+    RpcClient client(setting);
+
+    // 重连期间的请求排队，超过上限的直接失败
+    std::vector<std::future<RpcCallResult>> futures;
+    for (int i = 0; i < 8; ++i) {
+        futures.push_back(client.call_RPC_future(1, 2, "nicol-" + std::to_string(i), std::chrono::seconds(5)));
+    }
+
+    std::future<RpcCallResult> rejected = client.call_RPC_future(1, 2, "nicol", std::chrono::seconds(5));
+    ASSERT_THAT(rejected.get().status_, Eq(RpcClientStatus::NETWORK_CONNECT_ERROR));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ASSERT_THAT(futures[0].wait_for(std::chrono::milliseconds(0)), Eq(std::future_status::timeout));
+
+    // 服务端恢复之后，后台重连成功并发送排队的请求
+    FakeServer server(port);
+    for (size_t i = 0; i < futures.size(); ++i) {
+        ASSERT_THAT(futures[i].wait_for(std::chrono::seconds(3)), Eq(std::future_status::ready));
+        RpcCallResult result = futures[i].get();
+        ASSERT_THAT(result.status_, Eq(RpcClientStatus::OK));
+        ASSERT_THAT(result.respload_, Eq("nicol-" + std::to_string(i)));
+    }
+    ASSERT_THAT(server.request_count_.load(), Eq(8));
+}
+
+TEST(ReconnectTest, ServerRestartTest) {
+
+    std::unique_ptr<FakeServer> server(new FakeServer());
+    uint16_t port = server->port();
+
+    RpcClientSetting setting;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = port;
+    setting.reconnect_initial_ms_ = 50;
+    setting.reconnect_max_ms_ = 100;
+    RpcClient client(setting);
+
+    ASSERT_THAT(client.call_RPC_future(1, 2, "nicol").get().status_, Eq(RpcClientStatus::OK));
+
+    // 服务端关闭连接之后调用失败，不会一直等待
+    server.reset();
+    auto start = std::chrono::steady_clock::now();
+    std::future<RpcCallResult> future = client.call_RPC_future(1, 2, "nicol");
+    ASSERT_THAT(future.wait_for(std::chrono::seconds(2)), Eq(std::future_status::ready));
+    ASSERT_THAT(future.get().status_, Ne(RpcClientStatus::OK));
+    ASSERT_THAT(elapsed_ms(start), Lt(1000));
+
+    // 服务端重启之后自动恢复
+    server.reset(new FakeServer(port));
+    RpcClientStatus status = RpcClientStatus::NETWORK_CONNECT_ERROR;
+    for (int i = 0; i < 50 && status != RpcClientStatus::OK; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        status = client.call_RPC_future(1, 2, "nicol").get().status_;
+    }
+    ASSERT_THAT(status, Eq(RpcClientStatus::OK));
+}
+
+// 监听但是从不accept的服务端，积压队列填满之后新的SYN被丢弃，
+// 连接会一直停留在建立的过程中
+class BlackholeServer {
+public:
+    BlackholeServer() :
+        io_service_(),
+        acceptor_(io_service_),
+        port_(0),
+        fillers_() {
+
+        boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), 0);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.bind(endpoint);
+        acceptor_.listen(0);
+        port_ = acceptor_.local_endpoint().port();
+
+        for (int i = 0; i < 4; ++i) {
+            auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_service_);
+            socket->open(boost::asio::ip::tcp::v4());
+            socket->non_blocking(true);
+
+            // boost::asio同步的connect会一直等待，这里只发起连接
+            boost::asio::ip::tcp::endpoint local(endpoint.address(), port_);
+            ::connect(socket->native_handle(), local.data(), static_cast<socklen_t>(local.size()));
+            fillers_.push_back(socket);
+        }
+    }
+
+    uint16_t port() const {
+        return port_;
+    }
+
+    // 关闭之后正在建立的连接在重传SYN的时候被拒绝
+    void close() {
+        boost::system::error_code ignore_ec;
+        acceptor_.close(ignore_ec);
+        for (auto iter = fillers_.begin(); iter != fillers_.end(); ++iter) {
+            (*iter)->close(ignore_ec);
+        }
+    }
+
+private:
+    boost::asio::io_service io_service_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    uint16_t port_;
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> fillers_;
+};
+
+TEST(ReconnectTest, BlackholeWarmUpTest) {
+
+    BlackholeServer blackhole;
+
+    // 只有一个线程的io_service，被阻塞之后所有的超时都不会触发
+    auto io_service = std::make_shared<boost::asio::io_service>();
+    auto work = std::make_shared<boost::asio::io_service::work>(*io_service);
+    std::thread io_thread([io_service]() { io_service->run(); });
+
+    RpcClientSetting setting;
+    setting.io_service_ = io_service;
+    setting.serv_addr_ = "127.0.0.1";
+    setting.serv_port_ = blackhole.port();
+    setting.connect_timeout_ms_ = 0;
+    setting.pool_min_conns_ = 2;
+    setting.pool_max_conns_ = 2;
+    setting.reconnect_queue_size_ = 16;
+    RpcClient client(setting);
+
+    // 连接池在后台补齐连接，没有连接超时的时候连接一直建立不成功，
+    // io_service的线程不能被它占住，排队的异步调用仍然按时超时
+    auto start = std::chrono::steady_clock::now();
+    std::future<RpcCallResult> future = client.call_RPC_future(1, 2, "nicol", std::chrono::milliseconds(200));
+    bool ready = future.wait_for(std::chrono::seconds(2)) == std::future_status::ready;
+    EXPECT_TRUE(ready);
+    EXPECT_THAT(elapsed_ms(start), Lt(1000));
+    if (ready) {
+        EXPECT_THAT(future.get().status_, Eq(RpcClientStatus::RPC_CALL_TIMEOUT));
+    }
+
+    blackhole.close();
+    work.reset();
+    io_service->stop();
+    io_thread.join();
+}
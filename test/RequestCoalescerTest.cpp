@@ -0,0 +1,210 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <boost/asio.hpp>
+
+#include <Network/NetServer.h>
+#include <Network/TcpConnAsync.h>
+#include <RPC/RpcInstance.h>
+#include <RPC/RequestCoalescer.h>
+
+using namespace tzrpc;
+
+static const uint16_t kCoalesceOpcode = 1;
+
+// 记录请求最终得到的答复
+struct Outcome {
+    Outcome() :
+        count_(0),
+        status_(RpcResponseStatus::OK),
+        msg_() {
+    }
+
+    int count_;
+    RpcResponseStatus status_;
+    std::string msg_;
+};
+
+// 没有启动的连接，请求只需要它的内存统计和来源信息，连接释放之后
+// 答复不会真正发送
+class RequestCoalescerTest : public ::testing::Test {
+protected:
+    RequestCoalescerTest() :
+        io_service_(),
+        server_("coalescer_test"),
+        coalescer_(std::vector<uint16_t>{ kCoalesceOpcode },
+                   [this](std::shared_ptr<RpcInstance> rpc_instance) { resubmitted_.push_back(rpc_instance); }),
+        resubmitted_() {
+    }
+
+    std::shared_ptr<RpcInstance> make_instance(const std::string& payload, uint32_t timeout_ms,
+                                               std::shared_ptr<Outcome> outcome) {
+
+        auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_service_);
+        auto conn = std::make_shared<TcpConnAsync>(socket, server_);
+
+        RpcRequestMessage request(0, kCoalesceOpcode, payload);
+        request.header_.timeout_ms = timeout_ms;
+        std::string str_request = request.net_str();
+
+        auto rpc_instance = std::make_shared<RpcInstance>(str_request, conn, str_request.size());
+        EXPECT_TRUE(rpc_instance->validate_request());
+
+        rpc_instance->add_response_hook([outcome](RpcResponseStatus status, const std::string& msg) {
+            ++outcome->count_;
+            outcome->status_ = status;
+            outcome->msg_ = msg;
+        });
+        return rpc_instance;
+    }
+
+    boost::asio::io_service io_service_;
+    NetServer server_;
+    RequestCoalescer coalescer_;
+    // 在coalescer_之前释放，重新提交的请求析构的时候还会回调coalescer_
+    std::vector<std::shared_ptr<RpcInstance>> resubmitted_;
+};
+
+TEST_F(RequestCoalescerTest, FanOutTest) {
+
+    auto leader_out = std::make_shared<Outcome>();
+    auto waiter1_out = std::make_shared<Outcome>();
+    auto waiter2_out = std::make_shared<Outcome>();
+    auto other_out = std::make_shared<Outcome>();
+
+    auto leader = make_instance("same", 0, leader_out);
+    auto waiter1 = make_instance("same", 0, waiter1_out);
+    auto waiter2 = make_instance("same", 0, waiter2_out);
+    auto other = make_instance("other", 0, other_out);
+
+    ASSERT_TRUE(coalescer_.join(leader));
+    ASSERT_FALSE(coalescer_.join(waiter1));
+    ASSERT_FALSE(coalescer_.join(waiter2));
+    ASSERT_TRUE(coalescer_.join(other));
+
+    leader->reply_rpc_message("response");
+    ASSERT_THAT(waiter1_out->count_, Eq(1));
+    ASSERT_THAT(waiter1_out->status_, Eq(RpcResponseStatus::OK));
+    ASSERT_THAT(waiter1_out->msg_, Eq("response"));
+    ASSERT_THAT(waiter2_out->count_, Eq(1));
+    ASSERT_THAT(waiter2_out->msg_, Eq("response"));
+    ASSERT_THAT(other_out->count_, Eq(0));
+
+    // 服务返回的错误对相同的请求同样有效
+    auto next_waiter_out = std::make_shared<Outcome>();
+    auto next_waiter = make_instance("other", 0, next_waiter_out);
+    ASSERT_FALSE(coalescer_.join(next_waiter));
+    other->reject(RpcResponseStatus::SERVICE_SPECIFIC_ERROR);
+    ASSERT_THAT(next_waiter_out->count_, Eq(1));
+    ASSERT_THAT(next_waiter_out->status_, Eq(RpcResponseStatus::SERVICE_SPECIFIC_ERROR));
+
+    ASSERT_TRUE(resubmitted_.empty());
+
+    // 答复之后新的请求重新执行
+    auto again = make_instance("same", 0, std::make_shared<Outcome>());
+    ASSERT_TRUE(coalescer_.join(again));
+}
+
+TEST_F(RequestCoalescerTest, LeaderRejectTest) {
+
+    auto expired_out = std::make_shared<Outcome>();
+    auto waiter1_out = std::make_shared<Outcome>();
+    auto waiter2_out = std::make_shared<Outcome>();
+
+    auto leader = make_instance("same", 0, std::make_shared<Outcome>());
+    auto expired = make_instance("same", 1, expired_out);
+    auto waiter1 = make_instance("same", 0, waiter1_out);
+    auto waiter2 = make_instance("same", 60 * 1000, waiter2_out);
+
+    ASSERT_TRUE(coalescer_.join(leader));
+    ASSERT_FALSE(coalescer_.join(expired));
+    ASSERT_FALSE(coalescer_.join(waiter1));
+    ASSERT_FALSE(coalescer_.join(waiter2));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // 执行的请求过载被拒绝，过期的等待者超时，第一个还有时间的等待者重新提交执行
+    leader->reject(RpcResponseStatus::OVERLOADED);
+    ASSERT_THAT(expired_out->count_, Eq(1));
+    ASSERT_THAT(expired_out->status_, Eq(RpcResponseStatus::DEADLINE_EXCEEDED));
+    ASSERT_THAT(waiter1_out->count_, Eq(0));
+    ASSERT_THAT(waiter2_out->count_, Eq(0));
+    ASSERT_THAT(resubmitted_.size(), Eq(1));
+    ASSERT_THAT(resubmitted_[0], Eq(waiter1));
+
+    // 重新执行期间到达的相同请求继续合并
+    auto late_out = std::make_shared<Outcome>();
+    auto late = make_instance("same", 0, late_out);
+    ASSERT_FALSE(coalescer_.join(late));
+
+    // 重新执行的请求再次超时，剩下的等待者继续重新提交
+    waiter1->reject(RpcResponseStatus::DEADLINE_EXCEEDED);
+    ASSERT_THAT(waiter1_out->status_, Eq(RpcResponseStatus::DEADLINE_EXCEEDED));
+    ASSERT_THAT(resubmitted_.size(), Eq(2));
+    ASSERT_THAT(resubmitted_[1], Eq(waiter2));
+
+    waiter2->reply_rpc_message("response");
+    ASSERT_THAT(waiter2_out->status_, Eq(RpcResponseStatus::OK));
+    ASSERT_THAT(late_out->count_, Eq(1));
+    ASSERT_THAT(late_out->status_, Eq(RpcResponseStatus::OK));
+    ASSERT_THAT(late_out->msg_, Eq("response"));
+
+    ASSERT_THAT(coalescer_.dump(), HasSubstr("coalesce_requeue_count: 2"));
+}
+
+TEST_F(RequestCoalescerTest, ReleaseWithoutReplyTest) {
+
+    auto leader_out = std::make_shared<Outcome>();
+    auto waiter_out = std::make_shared<Outcome>();
+
+    auto leader = make_instance("same", 0, leader_out);
+    auto waiter = make_instance("same", 0, waiter_out);
+
+    ASSERT_TRUE(coalescer_.join(leader));
+    ASSERT_FALSE(coalescer_.join(waiter));
+
+    // 执行的请求没有答复就释放了，析构的时候以SYSTEM_ERROR完成
+    leader.reset();
+    ASSERT_THAT(leader_out->count_, Eq(1));
+    ASSERT_THAT(leader_out->status_, Eq(RpcResponseStatus::SYSTEM_ERROR));
+    ASSERT_THAT(waiter_out->count_, Eq(1));
+    ASSERT_THAT(waiter_out->status_, Eq(RpcResponseStatus::SYSTEM_ERROR));
+    ASSERT_TRUE(resubmitted_.empty());
+
+    auto again = make_instance("same", 0, std::make_shared<Outcome>());
+    ASSERT_TRUE(coalescer_.join(again));
+}
+
+TEST_F(RequestCoalescerTest, WaiterExpiredTest) {
+
+    auto expired_out = std::make_shared<Outcome>();
+    auto waiter_out = std::make_shared<Outcome>();
+
+    auto leader = make_instance("same", 60 * 1000, std::make_shared<Outcome>());
+    auto expired = make_instance("same", 1, expired_out);
+    auto waiter = make_instance("same", 60 * 1000, waiter_out);
+
+    ASSERT_TRUE(coalescer_.join(leader));
+    ASSERT_FALSE(coalescer_.join(expired));
+    ASSERT_FALSE(coalescer_.join(waiter));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // 执行的请求成功答复，等待期间已经过期的等待者不转发答复
+    leader->reply_rpc_message("response");
+    ASSERT_THAT(expired_out->count_, Eq(1));
+    ASSERT_THAT(expired_out->status_, Eq(RpcResponseStatus::DEADLINE_EXCEEDED));
+    ASSERT_THAT(waiter_out->count_, Eq(1));
+    ASSERT_THAT(waiter_out->status_, Eq(RpcResponseStatus::OK));
+    ASSERT_THAT(waiter_out->msg_, Eq("response"));
+
+    ASSERT_TRUE(resubmitted_.empty());
+    ASSERT_THAT(coalescer_.dump(), HasSubstr("coalesce_expired_count: 1"));
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <RPC/ResponseCache.h>
+
+using namespace tzrpc;
+
+static ResponseCacheConf cache_conf(int64_t memory_limit) {
+    ResponseCacheConf conf{};
+    conf.shard_count_ = 1;
+    conf.memory_limit_ = memory_limit;
+    conf.opcode_ttl_ms_[1] = 100;
+    conf.opcode_ttl_ms_[2] = 10 * 1000;
+    return conf;
+}
+
+TEST(ResponseCacheTest, HitAndExpireTest) {
+
+    ResponseCache cache(cache_conf(1024 * 1024));
+    std::string response;
+    uint64_t version = 0;
+
+    ASSERT_TRUE(cache.cacheable(1));
+    ASSERT_FALSE(cache.cacheable(3));
+
+    ASSERT_FALSE(cache.lookup(1, "key", response, version));
+    cache.insert(1, "key", "value", version);
+    ASSERT_TRUE(cache.lookup(1, "key", response, version));
+    ASSERT_THAT(response, Eq("value"));
+
+    // 不同opcode的相同请求内容互不影响
+    ASSERT_FALSE(cache.lookup(2, "key", response, version));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    ASSERT_FALSE(cache.lookup(1, "key", response, version));
+}
+
+TEST(ResponseCacheTest, InvalidateTest) {
+
+    ResponseCache cache(cache_conf(1024 * 1024));
+    std::string response;
+    uint64_t version = 0;
+
+    ASSERT_FALSE(cache.lookup(2, "key1", response, version));
+    cache.insert(2, "key1", "value1", version);
+    ASSERT_FALSE(cache.lookup(2, "key2", response, version));
+    cache.insert(2, "key2", "value2", version);
+
+    cache.invalidate(2, "key1");
+    ASSERT_FALSE(cache.lookup(2, "key1", response, version));
+    ASSERT_TRUE(cache.lookup(2, "key2", response, version));
+
+    // 失效之前开始执行的请求不能把旧的答复写回缓存
+    uint64_t stale_version = 0;
+    ASSERT_FALSE(cache.lookup(2, "key3", response, stale_version));
+    cache.invalidate(2);
+    cache.insert(2, "key3", "stale", stale_version);
+    ASSERT_FALSE(cache.lookup(2, "key3", response, version));
+    ASSERT_FALSE(cache.lookup(2, "key2", response, version));
+}
+
+TEST(ResponseCacheTest, EvictTest) {
+
+    // 只能容纳两个条目
+    ResponseCache cache(cache_conf(2 * 256 + 128));
+    std::string response;
+    uint64_t version = 0;
+    std::string value(64, 'v');
+
+    cache.lookup(2, "key1", response, version);
+    cache.insert(2, "key1", value, version);
+    cache.lookup(2, "key2", response, version);
+    cache.insert(2, "key2", value, version);
+
+    // 访问key1之后，key2是最久没有访问的
+    ASSERT_TRUE(cache.lookup(2, "key1", response, version));
+    cache.lookup(2, "key3", response, version);
+    cache.insert(2, "key3", value, version);
+
+    ASSERT_TRUE(cache.lookup(2, "key1", response, version));
+    ASSERT_FALSE(cache.lookup(2, "key2", response, version));
+    ASSERT_TRUE(cache.lookup(2, "key3", response, version));
+}
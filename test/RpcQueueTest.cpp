@@ -0,0 +1,178 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <RPC/RpcQueue.h>
+#include <RPC/MPMCQueue.h>
+#include <RPC/FairRpcQueue.h>
+
+using namespace tzrpc;
+
+TEST(RpcQueueTest, MPMCBoundedTest) {
+
+    MPMCQueue<int> queue(5);
+    ASSERT_THAT(queue.capacity(), Eq(8));
+
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(queue.PUSH(i));
+    }
+    ASSERT_FALSE(queue.PUSH(8));
+    ASSERT_THAT(queue.SIZE(), Eq(8));
+
+    int val = -1;
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(queue.POP(val, 0));
+        ASSERT_THAT(val, Eq(i));
+    }
+    ASSERT_FALSE(queue.POP(val, 0));
+    ASSERT_FALSE(queue.POP(val, 10));
+    ASSERT_THAT(queue.SIZE(), Eq(0));
+}
+
+
+TEST(RpcQueueTest, MPMCConcurrentTest) {
+
+    const int kThreads = 4;
+    const int kCount = 100000;
+
+    MPMCQueue<int> queue(64);
+    std::atomic<int64_t> sum(0);
+    std::atomic<int> consumed(0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&]() {
+            int val = 0;
+            while (consumed.load() < kThreads * kCount) {
+                if (queue.POP(val, 10)) {
+                    sum += val;
+                    ++consumed;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 1; j <= kCount; ++j) {
+                while (!queue.PUSH(j))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    ASSERT_THAT(consumed.load(), Eq(kThreads * kCount));
+    ASSERT_THAT(sum.load(), Eq(static_cast<int64_t>(kThreads) * kCount * (kCount + 1) / 2));
+}
+
+
+TEST(RpcQueueTest, OverloadPolicyTest) {
+
+    int evicted = -1;
+    int val = -1;
+
+    MutexRpcQueue<int> reject_queue(2, OverloadPolicy::kRejectNew);
+    ASSERT_TRUE(reject_queue.PUSH(1, evicted) == PushResult::kOK);
+    ASSERT_TRUE(reject_queue.PUSH(2, evicted) == PushResult::kOK);
+    ASSERT_TRUE(reject_queue.PUSH(3, evicted) == PushResult::kRejected);
+    ASSERT_TRUE(reject_queue.POP(val, 0));
+    ASSERT_THAT(val, Eq(1));
+
+    MutexRpcQueue<int> drop_queue(2, OverloadPolicy::kDropOldest);
+    ASSERT_TRUE(drop_queue.PUSH(1, evicted) == PushResult::kOK);
+    ASSERT_TRUE(drop_queue.PUSH(2, evicted) == PushResult::kOK);
+    ASSERT_TRUE(drop_queue.PUSH(3, evicted) == PushResult::kEvicted);
+    ASSERT_THAT(evicted, Eq(1));
+    ASSERT_TRUE(drop_queue.POP(val, 0));
+    ASSERT_THAT(val, Eq(2));
+
+    // 深度超过1之后后进先出
+    MutexRpcQueue<int> lifo_queue(4, OverloadPolicy::kLIFO, 1);
+    for (int i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(lifo_queue.PUSH(i, evicted) == PushResult::kOK);
+    }
+    ASSERT_TRUE(lifo_queue.POP(val, 0));
+    ASSERT_THAT(val, Eq(3));
+    ASSERT_TRUE(lifo_queue.POP(val, 0));
+    ASSERT_THAT(val, Eq(2));
+    ASSERT_TRUE(lifo_queue.POP(val, 0));
+    ASSERT_THAT(val, Eq(1));
+
+    MPMCQueue<int> mpmc_queue(2, OverloadPolicy::kDropOldest);
+    ASSERT_TRUE(mpmc_queue.PUSH(1, evicted) == PushResult::kOK);
+    ASSERT_TRUE(mpmc_queue.PUSH(2, evicted) == PushResult::kOK);
+    ASSERT_TRUE(mpmc_queue.PUSH(3, evicted) == PushResult::kEvicted);
+    ASSERT_THAT(evicted, Eq(1));
+}
+
+
+TEST(RpcQueueTest, PopBatchTest) {
+
+    std::vector<int> items;
+
+    MutexRpcQueue<int> mutex_queue;
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(mutex_queue.PUSH(i));
+    }
+    ASSERT_THAT(mutex_queue.POP_BATCH(items, 3, 0), Eq(3));
+    ASSERT_THAT(items, ElementsAre(0, 1, 2));
+    ASSERT_THAT(mutex_queue.POP_BATCH(items, 3, 0), Eq(2));
+    ASSERT_THAT(items, ElementsAre(0, 1, 2, 3, 4));
+    ASSERT_THAT(mutex_queue.POP_BATCH(items, 3, 10), Eq(0));
+
+    items.clear();
+    MPMCQueue<int> mpmc_queue(8);
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(mpmc_queue.PUSH(i));
+    }
+    ASSERT_THAT(mpmc_queue.POP_BATCH(items, 8, 0), Eq(5));
+    ASSERT_THAT(items, ElementsAre(0, 1, 2, 3, 4));
+    ASSERT_THAT(mpmc_queue.POP_BATCH(items, 8, 10), Eq(0));
+}
+
+
+TEST(RpcQueueTest, FairQueueTest) {
+
+    // 十位数作为来源
+    auto source_key = [](const int& val) { return static_cast<uint64_t>(val / 10); };
+
+    int evicted = -1;
+    int val = -1;
+    std::vector<int> items;
+
+    // 重负载的来源1先灌入请求，来源2和3的请求不需要排在后面
+    FairRpcQueue<int> queue(source_key, 0, 3);
+    for (int i = 10; i < 14; ++i) {
+        queue.PUSH(i, evicted);
+    }
+    ASSERT_THAT(queue.SIZE(), Eq(3));
+    ASSERT_TRUE(queue.PUSH(20, evicted) == PushResult::kOK);
+    ASSERT_TRUE(queue.PUSH(30, evicted) == PushResult::kOK);
+    ASSERT_THAT(queue.SOURCES(), Eq(3));
+
+    ASSERT_THAT(queue.POP_BATCH(items, 4, 0), Eq(4));
+    ASSERT_THAT(items, ElementsAre(10, 20, 30, 11));
+    ASSERT_TRUE(queue.POP(val, 0));
+    ASSERT_THAT(val, Eq(12));
+    ASSERT_FALSE(queue.POP(val, 0));
+    ASSERT_THAT(queue.SOURCES(), Eq(0));
+
+    // 超过总容量的时候从积压最多的来源挤出
+    FairRpcQueue<int> drop_queue(source_key, 3, 0, OverloadPolicy::kDropOldest);
+    ASSERT_TRUE(drop_queue.PUSH(10, evicted) == PushResult::kOK);
+    ASSERT_TRUE(drop_queue.PUSH(11, evicted) == PushResult::kOK);
+    ASSERT_TRUE(drop_queue.PUSH(20, evicted) == PushResult::kOK);
+    ASSERT_TRUE(drop_queue.PUSH(30, evicted) == PushResult::kEvicted);
+    ASSERT_THAT(evicted, Eq(10));
+
+    items.clear();
+    ASSERT_THAT(drop_queue.POP_BATCH(items, 8, 0), Eq(3));
+    ASSERT_THAT(items, ElementsAre(11, 20, 30));
+}
@@ -0,0 +1,193 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+using namespace ::testing;
+
+#include <boost/asio.hpp>
+
+#include <Network/NetServer.h>
+#include <Network/TcpConnAsync.h>
+#include <RPC/RpcInstance.h>
+#include <Protocol/ServiceImpl/RpcServiceBase.h>
+
+using namespace tzrpc;
+
+static const uint16_t kEchoOpcode = 1;
+static const uint16_t kFailOpcode = 2;
+static const uint16_t kUnknownOpcode = 3;
+
+// 记录请求最终得到的答复
+struct Outcome {
+    Outcome() :
+        count_(0),
+        status_(RpcResponseStatus::OK),
+        msg_() {
+    }
+
+    int count_;
+    RpcResponseStatus status_;
+    std::string msg_;
+};
+
+// 通过RpcServiceBase的分发表处理请求，override_batch_为true的时候重载
+// handle_RPC_batch，整批请求只做一次公共的准备工作
+class BatchTestService : public Service,
+    public RpcServiceBase {
+
+public:
+    explicit BatchTestService(bool override_batch) :
+        RpcServiceBase("batch_test_service"),
+        override_batch_(override_batch),
+        batch_count_(0),
+        handled_count_(0),
+        prefix_() {
+    }
+
+    bool init() override {
+        return register_handler(kEchoOpcode, [this](std::shared_ptr<RpcInstance>& rpc_instance) {
+                   ++handled_count_;
+                   rpc_instance->reply_rpc_message(prefix_ + rpc_instance->get_rpc_request_message().payload_);
+               }) &&
+               register_handler(kFailOpcode, [this](std::shared_ptr<RpcInstance>& rpc_instance) {
+                   ++handled_count_;
+                   rpc_instance->reject(RpcResponseStatus::SERVICE_SPECIFIC_ERROR);
+               });
+    }
+
+    void handle_RPC(std::shared_ptr<RpcInstance> rpc_instance) override {
+        if (!dispatch_RPC(rpc_instance)) {
+            rpc_instance->reject(RpcResponseStatus::INVALID_REQUEST);
+        }
+    }
+
+    void handle_RPC_batch(std::vector<std::shared_ptr<RpcInstance>>& rpc_instances) override {
+
+        if (!override_batch_) {
+            Service::handle_RPC_batch(rpc_instances);
+            return;
+        }
+
+        ++batch_count_;
+        prefix_ = "batch:";
+        for (auto iter = rpc_instances.begin(); iter != rpc_instances.end(); ++iter) {
+            handle_RPC(*iter);
+        }
+        prefix_.clear();
+    }
+
+    std::string instance_name() override {
+        return RpcServiceBase::instance_name();
+    }
+
+    ExecutorConf get_executor_conf() override {
+        return ExecutorConf();
+    }
+
+    int module_runtime(const libconfig::Config& conf) override {
+        return 0;
+    }
+
+    int module_status(std::string& module, std::string& name, std::string& val) override {
+        return 0;
+    }
+
+    const bool override_batch_;
+    int batch_count_;
+    int handled_count_;
+    std::string prefix_;
+};
+
+// 没有启动的连接，请求只需要它的内存统计和来源信息，答复不会真正发送
+class ServiceBatchTest : public ::testing::Test {
+protected:
+    ServiceBatchTest() :
+        io_service_(),
+        server_("service_batch_test") {
+    }
+
+    std::shared_ptr<RpcInstance> make_instance(uint16_t opcode, const std::string& payload,
+                                               std::shared_ptr<Outcome> outcome) {
+
+        auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_service_);
+        auto conn = std::make_shared<TcpConnAsync>(socket, server_);
+
+        RpcRequestMessage request(0, opcode, payload);
+        std::string str_request = request.net_str();
+
+        auto rpc_instance = std::make_shared<RpcInstance>(str_request, conn, str_request.size());
+        EXPECT_TRUE(rpc_instance->validate_request());
+
+        rpc_instance->add_response_hook([outcome](RpcResponseStatus status, const std::string& msg) {
+            ++outcome->count_;
+            outcome->status_ = status;
+            outcome->msg_ = msg;
+        });
+        return rpc_instance;
+    }
+
+    boost::asio::io_service io_service_;
+    NetServer server_;
+};
+
+TEST_F(ServiceBatchTest, DefaultBatchTest) {
+
+    BatchTestService service(false);
+    ASSERT_TRUE(service.init());
+
+    std::vector<std::shared_ptr<Outcome>> outcomes;
+    std::vector<std::shared_ptr<RpcInstance>> batch;
+    const uint16_t opcodes[] = { kEchoOpcode, kFailOpcode, kEchoOpcode, kUnknownOpcode };
+    for (size_t i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); ++i) {
+        outcomes.push_back(std::make_shared<Outcome>());
+        batch.push_back(make_instance(opcodes[i], "req-" + std::to_string(i), outcomes.back()));
+    }
+
+    // 默认实现逐个分发，同一批中的请求各自答复，互不影响
+    service.handle_RPC_batch(batch);
+    ASSERT_THAT(service.handled_count_, Eq(3));
+
+    ASSERT_THAT(outcomes[0]->count_, Eq(1));
+    ASSERT_THAT(outcomes[0]->status_, Eq(RpcResponseStatus::OK));
+    ASSERT_THAT(outcomes[0]->msg_, Eq("req-0"));
+    ASSERT_THAT(outcomes[1]->count_, Eq(1));
+    ASSERT_THAT(outcomes[1]->status_, Eq(RpcResponseStatus::SERVICE_SPECIFIC_ERROR));
+    ASSERT_THAT(outcomes[2]->count_, Eq(1));
+    ASSERT_THAT(outcomes[2]->msg_, Eq("req-2"));
+    ASSERT_THAT(outcomes[3]->count_, Eq(1));
+    ASSERT_THAT(outcomes[3]->status_, Eq(RpcResponseStatus::INVALID_REQUEST));
+
+    for (auto iter = batch.begin(); iter != batch.end(); ++iter) {
+        ASSERT_TRUE((*iter)->is_completed());
+    }
+}
+
+TEST_F(ServiceBatchTest, OverrideBatchTest) {
+
+    BatchTestService service(true);
+    ASSERT_TRUE(service.init());
+
+    std::vector<std::shared_ptr<Outcome>> outcomes;
+    std::vector<std::shared_ptr<RpcInstance>> batch;
+    for (int i = 0; i < 3; ++i) {
+        outcomes.push_back(std::make_shared<Outcome>());
+        batch.push_back(make_instance(kEchoOpcode, "req-" + std::to_string(i), outcomes.back()));
+    }
+
+    // 重载的实现整批只准备一次，每个请求仍然通过分发表单独答复
+    service.handle_RPC_batch(batch);
+    ASSERT_THAT(service.batch_count_, Eq(1));
+    ASSERT_THAT(service.handled_count_, Eq(3));
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_THAT(outcomes[i]->count_, Eq(1));
+        ASSERT_THAT(outcomes[i]->status_, Eq(RpcResponseStatus::OK));
+        ASSERT_THAT(outcomes[i]->msg_, Eq("batch:req-" + std::to_string(i)));
+    }
+
+    // 单个请求不经过批量接口
+    auto single_out = std::make_shared<Outcome>();
+    service.handle_RPC(make_instance(kEchoOpcode, "single", single_out));
+    ASSERT_THAT(service.batch_count_, Eq(1));
+    ASSERT_THAT(single_out->msg_, Eq("single"));
+}